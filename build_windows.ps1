@@ -17,7 +17,24 @@ $SRCS = @(
     "src/ui.c",
     "src/puzzle_loader.c",
     "src/generator.c",
-    "src/config.c"
+    "src/config.c",
+    "src/history.c",
+    "src/layout.c",
+    "src/profiler.c",
+    "src/puzzle_cache.c",
+    "src/puzzle_scan.c",
+    "src/puzzle_collection.c",
+    "src/puzzle_record.c",
+    "src/puzzle_watch.c",
+    "src/mapped_file.c",
+    "src/puzzle_import.c",
+    "src/puzzle_check.c",
+    "src/config_watch.c",
+    "src/config_snapshot.c",
+    "src/mod.c",
+    "src/rules.c",
+    "src/autosave.c",
+    "src/replay.c"
 )
 $LIBS = "-lraylib -lm -lpthread -ldl -lwinmm -lgdi32 -lopengl32"
 $TARGET = "sudoku.exe"
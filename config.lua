@@ -54,7 +54,10 @@ config = {
 		size_topbar = 20,
 		size_normal = 18,
 		size_small = 16,
-		size_note = 14
+		size_note = 14,
+		-- a .ttf to draw the board's digits with, sharp at any tile_pix.
+		-- empty uses raylib's built-in bitmap font, scaled up
+		path = ""
 	},
 
 	-- cell layout
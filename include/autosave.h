@@ -0,0 +1,105 @@
+/* include/autosave.h
+ * crash-safe autosave of the game in progress
+ *
+ * two files in the working directory, like config.lua.snap:
+ * - AUTOSAVE_SNAPSHOT: a header and the board as a puzzle record
+ *   (puzzle_record.h), written to a .tmp, synced and renamed over the old one
+ * - AUTOSAVE_JOURNAL: every cell change since that snapshot, appended as
+ *   4-byte records
+ *
+ * the render thread only diffs the board against the last saved state and
+ * queues records under a short lock. a worker thread writes the queue out
+ * and fsyncs it every AUTOSAVE_SYNC_INTERVAL seconds, and writes snapshots,
+ * so no file I/O ever happens on a frame. every AUTOSAVE_SNAPSHOT_MOVES
+ * records (or when the queue fills up because the disk is slow) a new
+ * snapshot takes the journal's place and the journal starts over.
+ *
+ * a record is a little-endian uint32:
+ *   bits 0-6    BOARD_CELL, or AUTOSAVE_CLOCK for a clock record
+ *   bits 7-10   value           \
+ *   bits 11-14  color            | elapsed seconds (17 bits) in a clock record
+ *   bits 15-23  notes mask >> 1 /
+ *   bits 24-31  check byte of the payload and the record's index
+ * the journal header carries the generation of the snapshot it continues,
+ * and reading stops at the first record whose check byte is off, so a torn
+ * tail or a journal left over from an older snapshot is ignored
+ */
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "puzzle_loader.h"
+#include "puzzle_record.h"
+
+#define AUTOSAVE_SNAPSHOT "autosave.snap"
+#define AUTOSAVE_JOURNAL "autosave.journal"
+#define AUTOSAVE_SYNC_INTERVAL 0.5
+#define AUTOSAVE_SNAPSHOT_MOVES 512
+#define AUTOSAVE_QUEUE 1024 /* records */
+#define AUTOSAVE_CLOCK 127
+#define AUTOSAVE_CLOCK_STEP 5 /* seconds between clock records while idle */
+
+typedef struct AutosaveGame {
+	Puzzle puzzle; /* givens, progress and title */
+	int elapsedSeconds;
+	bool autoNotes;
+} AutosaveGame;
+
+typedef struct Autosave {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake; /* signalled to stop the worker early */
+	bool running;
+
+	/* render thread only */
+	bool active; /* a game is being saved */
+	AutosaveGame game; /* the state the files add up to */
+	uint32_t generation;
+	uint32_t records; /* in the journal since the snapshot */
+
+	/* guarded by lock */
+	uint8_t queue[AUTOSAVE_QUEUE * 4];
+	int queued;
+	uint8_t snapshot[PUZZLE_RECORD_MAX + 64];
+	size_t snapshotSize; /* 0 = none waiting */
+	bool discard; /* remove both files */
+	bool stop;
+} Autosave;
+
+/* read back the last save, the snapshot with the journal on top. false if
+ * there is none or the snapshot is damaged
+ */
+bool Autosave_Load(AutosaveGame *out);
+
+bool Autosave_Start(Autosave *a);
+/* write out whatever is queued, then stop the worker */
+void Autosave_Stop(Autosave *a);
+
+/* save game from scratch, with a snapshot */
+void Autosave_Begin(Autosave *a, const AutosaveGame *game);
+
+/* queue the cells of b that differ from the saved state, and the clock when
+ * it moved on. cheap enough to call every frame
+ */
+void Autosave_Record(Autosave *a, const Board *b, int elapsedSeconds, bool autoNotes);
+
+/* queue a snapshot of what was recorded last with the clock at
+ * elapsedSeconds, so the journal starts over
+ */
+void Autosave_Checkpoint(Autosave *a, int elapsedSeconds);
+
+/* the game was replaced, nothing is saved until the next Autosave_Begin */
+static inline void Autosave_End(Autosave *a) {
+	a->active = false;
+}
+
+/* the game is over, remove the files */
+void Autosave_Discard(Autosave *a);
+
+#endif // AUTOSAVE_H
@@ -1,5 +1,11 @@
 /* include/board.h
  * board and cell functions
+ *
+ * the board is stored as separate planes rather than an array of cell structs:
+ * - value/color planes, one byte per cell
+ * - bitboards (one bit per cell) for givens and for each digit's placements/notes
+ * - per-unit occupancy masks, kept up to date by Board_Set
+ * so validity checks, note clearing and completeness are all bit operations
  */
 
 #ifndef BOARD_H
@@ -10,24 +16,137 @@
 
 #include "config.h"
 
-typedef struct Cell {
-	uint8_t value; /* 0 for empty, 1-9 for digit */
-	bool given; /* true if part of puzzle */
-	uint16_t notes; /* bitmask 1<<n for note n (1..9) */
-	uint8_t color; /* CellColor enum value for cell highlighting */
-} Cell;
+#define BOARD_CELLS_MAX (BOARD_SIZE_MAX * BOARD_SIZE_MAX)
+
+/* flat cell index, rows are always BOARD_SIZE_MAX apart */
+#define BOARD_CELL(r, c) ((r) * BOARD_SIZE_MAX + (c))
+
+/* set of cells, bit i = cell i (81 bits over two words) */
+typedef struct BoardSet {
+	uint64_t lo, hi;
+} BoardSet;
 
 typedef struct Board {
-	Cell cells[BOARD_SIZE_MAX][BOARD_SIZE_MAX];
+	uint8_t value[BOARD_CELLS_MAX]; /* 0 for empty, 1-9 for digit */
+	uint8_t color[BOARD_CELLS_MAX]; /* CellColor enum value for cell highlighting */
+	BoardSet given; /* cells that are part of the puzzle */
+	BoardSet digits[BOARD_SIZE_MAX]; /* digits[v - 1]: cells holding v */
+	BoardSet notes[BOARD_SIZE_MAX]; /* notes[v - 1]: cells with note v */
+	uint16_t rowMask[BOARD_SIZE_MAX]; /* bit 1<<v set if v is placed in unit */
+	uint16_t colMask[BOARD_SIZE_MAX];
+	uint16_t boxMask[BOARD_SIZE_MAX];
+	int filled; /* number of non-empty cells */
+	uint64_t hash; /* zobrist hash of the values, kept by Board_Set */
 } Board;
 
+/* bitboard helpers */
+static inline BoardSet BoardSet_Bit(int i) {
+	BoardSet s = { 0, 0 };
+	if (i < 64)
+		s.lo = 1ull << i;
+	else
+		s.hi = 1ull << (i - 64);
+	return s;
+}
+
+static inline bool BoardSet_Test(BoardSet s, int i) {
+	return i < 64 ? (s.lo >> i) & 1 : (s.hi >> (i - 64)) & 1;
+}
+
+static inline BoardSet BoardSet_And(BoardSet a, BoardSet b) {
+	return (BoardSet) { a.lo & b.lo, a.hi & b.hi };
+}
+
+static inline BoardSet BoardSet_Or(BoardSet a, BoardSet b) {
+	return (BoardSet) { a.lo | b.lo, a.hi | b.hi };
+}
+
+static inline BoardSet BoardSet_AndNot(BoardSet a, BoardSet b) {
+	return (BoardSet) { a.lo & ~b.lo, a.hi & ~b.hi };
+}
+
+static inline bool BoardSet_Any(BoardSet s) {
+	return (s.lo | s.hi) != 0;
+}
+
+static inline int BoardSet_Count(BoardSet s) {
+	return __builtin_popcountll(s.lo) + __builtin_popcountll(s.hi);
+}
+
+/* remove and return the lowest cell in the set, -1 if empty */
+static inline int BoardSet_Pop(BoardSet *s) {
+	if (s->lo) {
+		int i = __builtin_ctzll(s->lo);
+		s->lo &= s->lo - 1;
+		return i;
+	}
+	if (s->hi) {
+		int i = __builtin_ctzll(s->hi);
+		s->hi &= s->hi - 1;
+		return 64 + i;
+	}
+	return -1;
+}
+
+/* zobrist key for digit v (1..) in a cell, deterministic across runs */
+static inline uint64_t Board_ZobristKey(int cell, int v) {
+	/* splitmix64 finalizer */
+	uint64_t z = ((uint64_t) cell << 5 | (uint64_t) v) * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+/* unit and peer sets for the current BOARD_SIZE/SUBGRID */
+BoardSet Board_RowSet(int r);
+BoardSet Board_ColSet(int c);
+BoardSet Board_BoxSet(int r, int c);
+BoardSet Board_PeerSet(int r, int c); /* row | col | box, excluding (r, c) */
+
+/* cell accessors */
+static inline int Board_Value(const Board *b, int r, int c) {
+	return b->value[BOARD_CELL(r, c)];
+}
+
+static inline bool Board_IsGiven(const Board *b, int r, int c) {
+	return BoardSet_Test(b->given, BOARD_CELL(r, c));
+}
+
+static inline int Board_Color(const Board *b, int r, int c) {
+	return b->color[BOARD_CELL(r, c)];
+}
+
+static inline void Board_SetColor(Board *b, int r, int c, int color) {
+	b->color[BOARD_CELL(r, c)] = (uint8_t) color;
+}
+
+/* notes are exchanged as a mask with bit 1<<n for note n (1..9) */
+uint16_t Board_GetNotes(const Board *b, int r, int c);
+void Board_SetNotes(Board *b, int r, int c, uint16_t notes);
+void Board_ToggleNote(Board *b, int r, int c, int v);
+
 void Board_Clear(Board *b);
 void Board_FromString(Board *b, const char *digits81);
 bool Board_IsValidMove(const Board *b, int r, int c, int v);
 void Board_Set(Board *b, int r, int c, int v, bool markGiven);
 bool Board_IsComplete(const Board *b);
+/* after v was placed at (r, c), drop v from its peers' notes and whatever the
+ * active variant rules now rule out in the cells they tie to it
+ */
 void Board_ClearNotesAffectedBy(Board *b, int r, int c, int v);
 
+/* auto notes: set every empty cell's notes to its legal candidates */
+void Board_FillCandidates(Board *b);
+/* after v was removed from (r, c), give the cell its candidates back and
+ * re-add v to the empty peers that can now hold it. with variant rules the
+ * cells they tie to (r, c) get every candidate the rules allow back
+ */
+void Board_RestoreCandidates(Board *b, int r, int c, int v);
+
+/* filled cells that clash with a peer, and per-digit notes a peer rules out */
+void Board_FindConflicts(
+	const Board *b, BoardSet *conflicts, BoardSet noteConflicts[BOARD_SIZE_MAX]);
+
 void Board_GenerateRandom(Board *b, Difficulty difficulty);
 
 #endif // BOARD_H
@@ -108,6 +108,7 @@ typedef struct Config {
 	int font_size_normal;
 	int font_size_small;
 	int font_size_note;
+	char font_path[256]; /* ttf for the board's digits, "" = built-in font */
 
 	/* cell layout */
 	int note_padding_x;
@@ -120,9 +121,27 @@ typedef struct Config {
 
 extern Config g_config;
 
+/* what differs between two configs, grouped by the caches each one affects */
+typedef enum ConfigChange {
+	CONFIG_CHANGED_TITLE = 1 << 0, /* window title */
+	CONFIG_CHANGED_GRID = 1 << 1, /* board size, only read at startup */
+	CONFIG_CHANGED_WINDOW = 1 << 2, /* window size */
+	CONFIG_CHANGED_LAYOUT = 1 << 3, /* tile, padding and ui spacing */
+	CONFIG_CHANGED_FONTS = 1 << 4, /* font sizes, and with them text widths */
+	CONFIG_CHANGED_THEME = 1 << 5, /* colors */
+	CONFIG_CHANGED_INPUT = 1 << 6 /* key repeat, read live, nothing to redo */
+} ConfigChange;
+
 /* config api */
 void Config_Init(void);
+void Config_SetDefaults(Config *cfg);
 bool Config_Load(Config *cfg, const char *path);
+
+/* defaults plus the script at path, from its snapshot (config_snapshot.h)
+ * while the script is unchanged so Lua only runs after an edit
+ */
+bool Config_LoadCached(Config *cfg, const char *path);
+unsigned Config_Diff(const Config *a, const Config *b);
 bool Config_UpdateValues(
 	const char *path, const char *section, const char **keys, const int *values, int count);
 
@@ -161,6 +180,7 @@ bool Config_UpdateValues(
 #define FONT_SIZE_NORMAL (g_config.font_size_normal)
 #define FONT_SIZE_SMALL (g_config.font_size_small)
 #define FONT_SIZE_NOTE (g_config.font_size_note)
+#define FONT_PATH (g_config.font_path)
 #define NOTE_PADDING_X (g_config.note_padding_x)
 #define NOTE_PADDING_Y (g_config.note_padding_y)
 #define NOTE_GRID_SIZE (g_config.note_grid_size)
@@ -0,0 +1,44 @@
+/* include/config_snapshot.h
+ * cached result of running config.lua
+ *
+ * the resolved Config is written next to the script as <script>.snap and
+ * mapped back on the next start instead of running Lua. the snapshot holds
+ * the script's size, mtime and a hash of its contents; it is used while the
+ * contents hash the same (a touched but unchanged script only gets its
+ * snapshot restamped). it also records the Config layout version and a hash
+ * of the built in defaults, so a build that changes either ignores it
+ */
+
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#define CONFIG_SNAPSHOT_EXT ".snap"
+
+/* bump whenever Config changes shape in a way its size does not show */
+#define CONFIG_SNAPSHOT_VERSION 1
+
+/* the script as it was when a snapshot was looked up */
+typedef struct ConfigSnapshotKey {
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash; /* of the contents */
+	bool valid; /* false if the script could not be read */
+} ConfigSnapshotKey;
+
+/* cfg from a snapshot still valid for the script at path. key gets the
+ * script's current stamp either way
+ */
+bool ConfigSnapshot_Load(Config *cfg, const char *path, ConfigSnapshotKey *key);
+
+/* record cfg as what the script resolved to when key was taken, so an edit
+ * made while Lua ran leaves a snapshot that no longer matches
+ */
+bool ConfigSnapshot_Save(
+	const Config *cfg, const char *path, const ConfigSnapshotKey *key);
+
+#endif // CONFIG_SNAPSHOT_H
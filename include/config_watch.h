@@ -0,0 +1,46 @@
+/* include/config_watch.h
+ * reload config.lua when it changes
+ *
+ * a worker thread stats the file every CONFIG_WATCH_INTERVAL seconds. once a
+ * change has held still for one interval (editors often write in steps) it
+ * runs the file through Config_LoadCached into a fresh config on top of
+ * the defaults, off the render thread, and hands the result over, calling
+ * notify (if any) so a loop blocked waiting for input wakes up to take it. a
+ * file that fails to load is reported and skipped, the running config stays
+ */
+
+#ifndef CONFIG_WATCH_H
+#define CONFIG_WATCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "config.h"
+
+#define CONFIG_WATCH_INTERVAL 0.25
+
+typedef struct ConfigWatch {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake; /* signalled to stop the worker early */
+	char path[256];
+	void (*notify)(void); /* from the worker, once a reload is pending */
+
+	Config pending; /* guarded by lock */
+	bool hasPending; /* guarded by lock */
+	bool stop; /* guarded by lock */
+	bool running;
+} ConfigWatch;
+
+bool ConfigWatch_Start(ConfigWatch *w, const char *path, void (*notify)(void));
+void ConfigWatch_Stop(ConfigWatch *w);
+
+/* true if the file was reloaded since the last poll, out gets the new config.
+ * the caller applies it, see Game_ApplyConfig
+ */
+bool ConfigWatch_Poll(ConfigWatch *w, Config *out);
+
+/* true if a reload is waiting for the next poll */
+bool ConfigWatch_Pending(ConfigWatch *w);
+
+#endif // CONFIG_WATCH_H
@@ -7,11 +7,21 @@
 
 #include <stdbool.h>
 
+#include "autosave.h"
 #include "config.h"
+#include "config_watch.h"
 #include "board.h"
 #include "puzzle_loader.h"
+#include "puzzle_check.h"
+#include "puzzle_collection.h"
+#include "puzzle_scan.h"
+#include "puzzle_watch.h"
+#include "history.h"
+#include "mod.h"
+#include "replay.h"
 
 #define MAX_PUZZLE_TITLE_GAME 128
+#define REPLAY_LIST_MAX 256 /* newest replays the replays screen lists */
 
 typedef enum AppScreen {
 	SCREEN_MENU,
@@ -19,6 +29,7 @@ typedef enum AppScreen {
 	SCREEN_LOAD_PUZZLE,
 	SCREEN_PLAY,
 	SCREEN_SETTINGS,
+	SCREEN_REPLAYS,
 	SCREEN_QUIT
 } AppScreen;
 
@@ -30,6 +41,14 @@ typedef struct Game {
 	Theme theme;
 	InputMode inputMode;
 	bool highlightConflicts;
+	bool autoNotes; /* keep every empty cell's notes at its candidates */
+
+	/* derived from board, refreshed by Game_OnBoardChanged */
+	BoardSet conflicts; /* filled cells clashing with a peer */
+	BoardSet noteConflicts[BOARD_SIZE_MAX]; /* notes ruled out by a peer */
+	unsigned int boardVersion; /* bumped on change, invalidates the board cache */
+
+	History history;
 	char puzzleTitle[MAX_PUZZLE_TITLE_GAME];
 	int selectedColorIndex; /* 0 = none, 1-9 = color palette */
 
@@ -42,19 +61,105 @@ typedef struct Game {
 
 	int menuSelection;
 	int difficultySelection;
-	int loadPuzzleSelection;
+	int loadPuzzleSelection; /* row in the filtered list */
+	int loadPuzzleScroll; /* first visible row */
+	char puzzleFilter[MAX_PUZZLE_TITLE];
 	bool puzzleListInitialized;
 	PuzzleFileList puzzleList;
+	PuzzleScan puzzleScan; /* fills puzzleList, cancelled when leaving the screen */
+	PuzzleWatch puzzleWatch; /* keeps puzzleList current once scanned */
+
+	/* bulk collection browsed in place of the file list while count > 0 */
+	PuzzleCollection collection;
+	PuzzleCheck collectionCheck; /* fills collection.checks after opening */
+	int collectionSelection;
+	int collectionScroll;
+	char collectionJump[12]; /* typed puzzle number */
 
 	/* settings state */
 	int settingsSelection;
 	Config tempConfig; /* temporary config while editing */
 	bool settingsNeedApply; /* track if window resize is needed */
+
+	ConfigWatch configWatch; /* reloads config.lua when it is saved */
+	ModRuntime mods;
+	Autosave autosave; /* the game in play, resumed on the next start */
+	ReplayRecorder replay; /* kept in replays/ when the game ends */
+
+	/* replays screen: the files in REPLAY_DIRECTORY, newest first, and the
+	 * one being watched while replayOpen
+	 */
+	char replayNames[REPLAY_LIST_MAX][REPLAY_NAME_MAX];
+	int replayCount;
+	bool replayListInitialized;
+	int replaySelection;
+	int replayScroll;
+	int replayFailed; /* row + 1 of a file that did not load, 0 if none */
+	bool replayOpen;
+	Replay replayShown;
+	ReplayPlayer replayPlayer;
+	uint32_t replayDuration; /* ms */
+	bool replayPlaying;
+	int replayViewNext; /* replayPlayer.next the view below is for */
+	unsigned int replayVersion; /* bumped with replayViewNext */
+	BoardSet replayConflicts;
+	BoardSet replayNoteConflicts[BOARD_SIZE_MAX];
 } Game;
 
 void Game_Init(Game *g);
+void Game_Shutdown(Game *g);
 void Game_Update(Game *g);
 void Game_Draw(const Game *g);
 bool Game_LoadPuzzleFile(Game *g, const char *filepath);
+void Game_LoadPuzzle(Game *g, const Puzzle *puzzle);
+
+/* open filepath as a collection if it holds more than one one-line puzzle,
+ * its puzzles are checked in the background unless the index has the results
+ */
+bool Game_OpenCollection(Game *g, const char *filepath);
+
+/* back to the file list, false if no collection was open */
+bool Game_CloseCollection(Game *g);
+
+/* watch replayNames[i], paused at its start. false if it does not load */
+bool Game_OpenReplay(Game *g, int i);
+
+/* keep the replay's conflicts and version in step with its player */
+void Game_SyncReplay(Game *g);
+
+/* back to the replay list, false if no replay was open */
+bool Game_CloseReplay(Game *g);
+
+/* true while the on-screen clock is counting or a replay plays, the loop must
+ * keep ticking
+ */
+bool Game_ClockRunning(const Game *g);
+
+/* true while background work shows progress on screen */
+bool Game_Busy(const Game *g);
+
+/* true while the browser is open on a watched directory, or a config.lua
+ * reload is waiting to be applied. the loop must keep ticking for them to show
+ * up; an idle loop is woken for a reload, so it can otherwise wait for input
+ */
+bool Game_Watching(Game *g);
+
+/* make next the running config, redoing only what changed from g_config */
+void Game_ApplyConfig(Game *g, const Config *next);
+
+/* must be called after every change to g->board */
+void Game_OnBoardChanged(Game *g);
+
+/* reset per-puzzle state after g->board was replaced */
+void Game_OnNewPuzzle(Game *g);
+
+/* player moves on the selected cell, recorded for undo */
+void Game_SetDigit(Game *g, int v);
+void Game_ToggleNote(Game *g, int v);
+void Game_ClearCell(Game *g);
+void Game_SetColor(Game *g, int color);
+void Game_ToggleAutoNotes(Game *g);
+void Game_Undo(Game *g);
+void Game_Redo(Game *g);
 
 #endif // GAME_H
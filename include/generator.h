@@ -4,14 +4,19 @@
  * - knuth's algorithm x with dancing links for complete grid generation
  * - backtracking solver with solution counting for uniqueness verification
  * - clue removal with difficulty control
+ * all of them honour the variant rules compiled from mods (rules.h)
  */
 
 #ifndef GENERATOR_H
 #define GENERATOR_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "board.h"
 
+/* largest side the solver and generator are compiled for */
+#define GENERATOR_SIZE_MAX 25
+
 /* generator configuration flags */
 typedef enum GeneratorFlags {
 	GEN_FLAG_UNIQUE = 1 << 0, // ensure puzzle has unique solution
@@ -26,7 +31,9 @@ typedef struct GeneratorResult {
 	int attempts;
 } GeneratorResult;
 
-/* generate a complete valid Sudoku grid using dlx */
+/* generate a complete valid Sudoku grid using dlx, or a randomized search
+ * when variant rules (rules.h) are in play
+ */
 bool Generator_FillGrid(Board *b);
 
 /* generate a puzzle with specified difficulty and flags */
@@ -39,6 +46,18 @@ int Generator_CountSolutions(const Board *b, int max_solutions);
 /* verify if a puzzle has a unique solution */
 bool Generator_HasUniqueSolution(const Board *b);
 
+/* size-generic versions working on a flat row-major grid of size * size
+ * values (0 = empty). supported sizes are 4, 9, 16 and 25, each backed by
+ * its own compiled specialisation. each uniqueness check of a puzzle being
+ * dug out has a search budget and keeps the clue when it runs out, so a
+ * 16x16 or 25x25 puzzle is made in seconds but keeps more clues than asked
+ */
+bool Generator_SupportsSize(int size);
+bool Generator_FillGridN(uint8_t *grid, int size);
+int Generator_CountSolutionsN(const uint8_t *grid, int size, int max_solutions);
+GeneratorResult Generator_CreatePuzzleN(
+	uint8_t *grid, int size, Difficulty difficulty, GeneratorFlags flags);
+
 /* seed the random number generator for reproducible puzzles
  * pass 0 to use time-based seeding
  */
@@ -0,0 +1,57 @@
+/* include/history.h
+ * undo/redo history as a ring buffer of board deltas
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+
+#include "board.h"
+
+#define HISTORY_CAPACITY 1024
+
+/* one cell change packed into 8 bytes
+ * a move that cascades into its peers' notes (placing a digit clears it from
+ * every peer) stays a single entry: peers holds one bit per peer, in
+ * Board_PeerSet order, whose note for the moved digit was flipped.
+ * the moved digit is newValue, or oldValue when the move cleared the cell
+ */
+typedef struct HistoryEntry {
+	unsigned int cell : 7; /* BOARD_CELL index */
+	unsigned int oldValue : 4;
+	unsigned int newValue : 4;
+	unsigned int oldColor : 4;
+	unsigned int newColor : 4;
+	unsigned int oldNotes : 9; /* notes mask >> 1 */
+	unsigned int newNotes : 9;
+	unsigned int peers : 20;
+	unsigned int linked : 1; /* undone/redone together with the previous entry */
+	unsigned int reserved : 2;
+} HistoryEntry;
+
+typedef struct History {
+	HistoryEntry entries[HISTORY_CAPACITY];
+	int head; /* slot the next entry is written to */
+	int undoCount;
+	int redoCount;
+} History;
+
+void History_Clear(History *h);
+
+/* capture (r, c) before a move, digit is the value whose peer notes the move
+ * may touch (0 if none)
+ */
+HistoryEntry History_Begin(const Board *b, int r, int c, int digit);
+
+/* complete the entry with the cell's new state and record it, dropping any
+ * redo entries, and the whole oldest move once the ring is full. returns false
+ * (recording nothing) if the move changed nothing
+ */
+bool History_End(History *h, const Board *b, HistoryEntry e, int digit, bool linked);
+
+/* step back/forward one move, false if there is nothing to undo/redo */
+bool History_Undo(History *h, Board *b);
+bool History_Redo(History *h, Board *b);
+
+#endif // HISTORY_H
@@ -11,4 +11,7 @@
 bool Input_EscapePressed(void);
 void Input_Update(Game *g);
 
+/* true if the player touched anything since the last frame */
+bool Input_AnyActivity(void);
+
 #endif // INPUT_H
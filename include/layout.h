@@ -0,0 +1,100 @@
+/* include/layout.h
+ * precomputed screen layout shared by drawing and hit-testing
+ *
+ * every rectangle, theme color and fixed text width the ui needs is worked
+ * out once per config or theme change by Layout_Refresh. drawing reads it,
+ * and mouse hit-tests map a point back to a cell or keypad slot by grid math
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+
+#include "raylib.h"
+
+#include "config.h"
+
+/* y of the centered title on menu screens */
+#define LAYOUT_TITLE_Y 120
+
+/* lines in the sidebar "controls:" section */
+#define LAYOUT_CONTROL_LINES 8
+
+/* height of the replay scrub bar */
+#define LAYOUT_REPLAY_BAR_H 12
+
+/* theme converted to raylib colors */
+typedef struct ThemeColors {
+	Color bg;
+	Color grid;
+	Color gridBold;
+	Color cellBg;
+	Color cellSel;
+	Color digitGiven;
+	Color digitUser;
+	Color accent;
+	Color text;
+	Color bad;
+	Color highlightRowCol;
+	Color highlightDigit;
+	Color topbarBg;
+	Color topbarText;
+	Color menuText;
+	Color menuSel;
+	Color menuSelBg;
+	Color cellColors[CELL_COLOR_COUNT];
+} ThemeColors;
+
+typedef struct Layout {
+	ThemeColors colors;
+
+	/* board */
+	Rectangle board;
+	int tile;
+
+	/* sidebar */
+	int sidebarX;
+	int controlsHeadingY;
+	int controlLineY[LAYOUT_CONTROL_LINES];
+	int paletteHeadingY;
+	Rectangle colorKeys[CELL_COLOR_COUNT]; /* [0] unused, CELL_COLOR_NONE */
+	Rectangle keypad; /* bounds of the whole color keypad */
+	int keypadStride; /* key size + spacing */
+	int numbersY;
+	int solvedY;
+	Rectangle replayBar; /* replay scrub bar, where the keypad is in play */
+
+	/* puzzle browser */
+	int browserFilterY;
+	Rectangle browserList; /* the visible rows */
+	int browserRowH;
+	int browserRows; /* rows that fit, only these are ever drawn */
+
+	/* what the layout was built from */
+	Config config;
+	Theme theme;
+	bool valid;
+	unsigned generation; /* moves on with every geometry change */
+} Layout;
+
+extern Layout g_layout;
+
+/* bring g_layout up to date with g_config and theme, rebuilding only the
+ * parts a change affects (see Config_Diff)
+ */
+void Layout_Refresh(const Theme *theme);
+
+/* cell under (x, y), false if outside the board */
+bool Layout_CellAt(const Layout *l, int x, int y, int *row, int *col);
+
+/* color keypad slot under (x, y), 0 if none */
+int Layout_ColorAt(const Layout *l, int x, int y);
+
+/* browser row under (x, y), counted from the first visible row, -1 if none */
+int Layout_BrowserRowAt(const Layout *l, int x, int y);
+
+/* MeasureText through a small cache, reset on every layout rebuild */
+int Layout_TextWidth(const char *text, int fontSize);
+
+#endif // LAYOUT_H
@@ -0,0 +1,25 @@
+/* include/mapped_file.h
+ * read-only view of a whole file
+ *
+ * memory-mapped where the platform has mmap, read into memory otherwise.
+ * the view is not NUL-terminated
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct MappedFile {
+	const char *data;
+	size_t size;
+	long long mtime;
+	bool mapped; /* false if data was read into memory instead */
+} MappedFile;
+
+/* false if path cannot be read or is empty */
+bool MappedFile_Open(MappedFile *f, const char *path);
+void MappedFile_Close(MappedFile *f);
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,136 @@
+/* include/mod.h
+ * lua mods
+ *
+ * every .lua file in mods/ is run once at startup in one persistent,
+ * sandboxed Lua state (base, string, table and math only; load takes source
+ * text only, pcall cannot catch a blown budget, metatables cannot have __gc,
+ * string.rep builds at most MOD_STRING_MAX bytes and patterns that could
+ * backtrack past MOD_PATTERN_STEPS on their subject are refused) and returns
+ * a table of hooks, any of:
+ *   on_move(row, col, value, old)  after a digit is placed or cleared
+ *   validate_move(row, col, value) before a digit is placed, false refuses
+ *   on_draw_overlay()              every play frame, draws with overlay.*
+ *   on_generate(grid, difficulty)  after a random puzzle is made, may return
+ *                                  a replacement grid string
+ * rows, columns and grids use 1-based cells and . for blanks. hooks can read
+ * the board through sudoku.cell(row, col), sudoku.given(row, col),
+ * sudoku.selected() and sudoku.size.
+ *
+ * the table may also hold variant rules, compiled into rules.h tables once
+ * at load (a mod whose rules do not compile is not loaded):
+ *   rules = {
+ *     regions = { { {r, c}, ... }, ... },        digits at most once each
+ *     relations = { {
+ *       forbid = "same" | "consecutive" | function(v, w) ... end,
+ *       offsets = { {dr, dc}, ... },  every cell with the one dr, dc away
+ *       pairs = { { {r, c}, {r, c} }, ... },
+ *     }, ... },
+ *     cages = { { sum = n, cells = { {r, c}, ... } }, ... },
+ *   }
+ * forbid(v, w) is true when v in the first cell rules out w in the second,
+ * it runs only while compiling. relations work both ways, so list an offset
+ * and not its negation
+ *
+ * hooks are guests in the frame: an instruction count hook stops any call
+ * past MOD_CALL_INSTRUCTIONS or past what is left of MOD_FRAME_BUDGET_MS,
+ * which all hooks of a frame share. once the budget is spent the frame's
+ * remaining hooks are skipped (moves are then allowed and the last overlay
+ * stays up). the hook only runs between Lua instructions, so a single library
+ * call is not interrupted: the bounds above keep the slow ones short, but a
+ * call into C can still overrun the budget by the time it takes. a mod that
+ * fails or runs over MOD_STRIKES times is switched off, running out of the
+ * share other hooks left it does not count
+ */
+
+#ifndef MOD_H
+#define MOD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "board.h"
+
+#define MOD_DIRECTORY "mods"
+#define MOD_MAX 16
+#define MOD_FRAME_BUDGET_MS 2.0 /* of a 16.7 ms frame at 60 fps */
+#define MOD_LOAD_BUDGET_MS 100.0 /* per file, at startup */
+#define MOD_CALL_INSTRUCTIONS 1000000
+#define MOD_HOOK_STEP 1000 /* instructions between budget checks */
+#define MOD_MEMORY_MAX (16 << 20)
+#define MOD_STRING_MAX (1 << 20) /* bytes string.rep may build */
+#define MOD_PATTERN_STEPS (1 << 20) /* worst case backtracking of one match */
+#define MOD_STRIKES 3
+#define MOD_OVERLAY_MAX 256
+
+struct lua_State;
+
+typedef enum ModHook {
+	MOD_HOOK_ON_MOVE,
+	MOD_HOOK_VALIDATE_MOVE,
+	MOD_HOOK_ON_DRAW_OVERLAY,
+	MOD_HOOK_ON_GENERATE,
+	MOD_HOOK_COUNT
+} ModHook;
+
+typedef struct Mod {
+	char name[64];
+	int hooks[MOD_HOOK_COUNT]; /* registry refs, LUA_NOREF if not defined */
+	int strikes;
+	bool disabled;
+} Mod;
+
+/* one overlay.* call, in board pixels, colors as 0xRRGGBBAA */
+typedef enum ModDrawKind { MOD_DRAW_RECT, MOD_DRAW_CELL, MOD_DRAW_TEXT } ModDrawKind;
+
+typedef struct ModDrawCmd {
+	ModDrawKind kind;
+	int x, y, w, h; /* cell row and column in x, y for MOD_DRAW_CELL */
+	int size; /* font size of MOD_DRAW_TEXT */
+	unsigned int color;
+	char text[48];
+} ModDrawCmd;
+
+typedef struct ModRuntime {
+	struct lua_State *L;
+	Mod mods[MOD_MAX];
+	int count;
+	unsigned hooked; /* bit per ModHook some mod defines */
+
+	/* state of the call in progress */
+	const Board *board;
+	int selRow, selCol;
+	double deadline; /* Profiler_Now */
+	long instructions;
+	bool timedOut;
+	bool exhausted; /* over either limit, pcall can no longer catch it */
+
+	double frameMs; /* spent in hooks this frame */
+	size_t memory; /* bytes the state holds */
+
+	ModDrawCmd overlay[MOD_OVERLAY_MAX]; /* last on_draw_overlay's output */
+	int overlayCount;
+} ModRuntime;
+
+/* load every mod in directory, false if there were none */
+bool Mod_Init(ModRuntime *rt, const char *directory);
+void Mod_Shutdown(ModRuntime *rt);
+
+/* start a new frame's budget */
+void Mod_FrameBegin(ModRuntime *rt);
+
+static inline bool Mod_Hooked(const ModRuntime *rt, ModHook hook) {
+	return rt->hooked & (1u << hook);
+}
+
+void Mod_OnMove(ModRuntime *rt, const Board *b, int r, int c, int v, int old);
+
+/* false if some mod refused v at (r, c) */
+bool Mod_ValidateMove(ModRuntime *rt, const Board *b, int r, int c, int v);
+
+/* rebuild rt->overlay, (selRow, selCol) is the selected cell */
+void Mod_DrawOverlay(ModRuntime *rt, const Board *b, int selRow, int selCol);
+
+/* let mods replace a freshly generated puzzle, true if one did */
+bool Mod_OnGenerate(ModRuntime *rt, Board *b, const char *difficulty);
+
+#endif // MOD_H
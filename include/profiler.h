@@ -0,0 +1,84 @@
+/* include/profiler.h
+ * per-frame phase timings and counters for the f3 overlay
+ *
+ * compiled in unless NDEBUG is defined (make release), in which case every
+ * PROFILE_* macro expands to nothing
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+
+#ifndef NDEBUG
+#define PROFILER_ENABLED
+#endif
+
+typedef enum ProfilePhase {
+	PROF_INPUT,
+	PROF_TIMER,
+	PROF_BOARD,
+	PROF_SIDEBAR,
+	PROF_PRESENT, /* EndDrawing, includes the frame limiter's wait */
+	PROF_MODS, /* lua mod hooks, wherever they run */
+	PROF_PHASE_COUNT
+} ProfilePhase;
+
+typedef enum ProfileCounter {
+	PROF_DRAWS, /* quads/rects the board view submits */
+	PROF_BOARD_RENDERS, /* board cache re-renders */
+	PROF_VALID_MOVE_CHECKS, /* Board_IsValidMove calls */
+	PROF_MOD_CALLS, /* mod hook calls */
+	PROF_MOD_SKIPS, /* mod hooks skipped, the frame's budget was spent */
+	PROF_COUNTER_COUNT
+} ProfileCounter;
+
+#define PROFILER_HISTORY 120
+#define PROFILER_DEPTH 4 /* phases open at once */
+
+typedef struct ProfileFrame {
+	float phaseMs[PROF_PHASE_COUNT];
+	float frameMs;
+	unsigned int counters[PROF_COUNTER_COUNT];
+} ProfileFrame;
+
+typedef struct Profiler {
+	ProfileFrame frames[PROFILER_HISTORY]; /* ring of finished frames */
+	int head; /* slot of the next finished frame */
+	int count;
+	ProfileFrame current;
+	double frameStart;
+	double phaseStart[PROF_PHASE_COUNT];
+	ProfilePhase open[PROFILER_DEPTH]; /* phases begun and not ended */
+	int depth;
+	bool visible;
+} Profiler;
+
+extern Profiler g_profiler;
+
+/* monotonic time in seconds */
+double Profiler_Now(void);
+
+void Profiler_FrameBegin(void);
+void Profiler_FrameEnd(void);
+void Profiler_Begin(ProfilePhase phase);
+void Profiler_End(ProfilePhase phase);
+
+/* finished frame, 0 = most recent */
+const ProfileFrame *Profiler_Frame(int ago);
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_FRAME_BEGIN() Profiler_FrameBegin()
+#define PROFILE_FRAME_END() Profiler_FrameEnd()
+#define PROFILE_BEGIN(phase) Profiler_Begin(phase)
+#define PROFILE_END(phase) Profiler_End(phase)
+#define PROFILE_COUNT(counter) (g_profiler.current.counters[counter]++)
+#else
+#define PROFILE_FRAME_BEGIN() ((void) 0)
+#define PROFILE_FRAME_END() ((void) 0)
+#define PROFILE_BEGIN(phase) ((void) 0)
+#define PROFILE_END(phase) ((void) 0)
+#define PROFILE_COUNT(counter) ((void) 0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,57 @@
+/* include/puzzle_cache.h
+ * persistent metadata index for a puzzles directory
+ *
+ * one tab-separated line per puzzle file:
+ *   mtime  size  clues  rating  filename  title  author
+ * a scan reuses a line when the file's mtime and size still match, so only
+ * new or changed files are opened
+ */
+
+#ifndef PUZZLE_CACHE_H
+#define PUZZLE_CACHE_H
+
+#include <stdbool.h>
+
+#include "puzzle_loader.h"
+
+#define PUZZLE_CACHE_FILE ".puzzle_index"
+
+typedef struct PuzzleCacheRecord {
+	const char *name; /* file name within the directory */
+	const char *title;
+	const char *author;
+	long long mtime;
+	long long size;
+	int clues;
+	int rating;
+} PuzzleCacheRecord;
+
+typedef struct PuzzleCache {
+	char *data; /* file contents, records point into it */
+	PuzzleCacheRecord *records;
+	int count;
+	int *slots; /* open-addressed hash of record indices by name, -1 = empty */
+	int slotCount;
+} PuzzleCache;
+
+/* a missing or unreadable index loads as empty */
+bool PuzzleCache_Load(PuzzleCache *cache, const char *path);
+void PuzzleCache_Free(PuzzleCache *cache);
+const PuzzleCacheRecord *PuzzleCache_Find(const PuzzleCache *cache, const char *name);
+
+/* metadata for one directory entry: from the index if the file's mtime and
+ * size still match (*reused = true), else from the file's header. path gets
+ * the full path. false if name is not a puzzle file
+ */
+bool PuzzleCache_Resolve(const PuzzleCache *cache,
+	const char *directory,
+	const char *name,
+	char path[MAX_FILEPATH_LEN],
+	PuzzleFileEntry *e,
+	PuzzleMetadata *meta,
+	bool *reused);
+
+/* write the list back as the directory's index (via a temp file and rename) */
+bool PuzzleCache_Save(const PuzzleFileList *list, const char *path);
+
+#endif // PUZZLE_CACHE_H
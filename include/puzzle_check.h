@@ -0,0 +1,62 @@
+/* include/puzzle_check.h
+ * validation and rating of a collection on worker threads
+ *
+ * every puzzle goes through the same stages: parse the line, check that no
+ * givens conflict, count solutions up to two, rate the unique ones and finally
+ * mark repeats of earlier puzzles. workers claim chunks of PUZZLE_CHECK_CHUNK
+ * puzzles off a shared counter and parse straight from the mapped file into a
+ * board on their stack, so the only per-puzzle memory is the collection's
+ * result byte. the dedup pass needs the whole file and runs last, on the
+ * worker that finishes last, which then writes the results to the index
+ */
+
+#ifndef PUZZLE_CHECK_H
+#define PUZZLE_CHECK_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "puzzle_collection.h"
+
+#define PUZZLE_CHECK_CHUNK 256
+#define PUZZLE_CHECK_THREADS_MAX 16
+
+typedef struct PuzzleCheck {
+	pthread_t threads[PUZZLE_CHECK_THREADS_MAX];
+	int threadCount;
+	PuzzleCollection *collection;
+
+	int next; /* first puzzle of the next chunk to claim */
+	int checked; /* puzzles through every stage before dedup */
+	int active; /* workers still running */
+	int cancel;
+	int done; /* set once dedup ran and the index was written */
+
+	double started; /* Profiler_Now */
+	double seconds; /* total, once done */
+	bool running;
+} PuzzleCheck;
+
+/* check every puzzle of c unless its index already had the results. c must
+ * stay open and in place until the check is done or cancelled. if no worker
+ * can be started nothing is checked, and c is checked again next time
+ */
+void PuzzleCheck_Start(PuzzleCheck *check, PuzzleCollection *c);
+
+/* join the workers once they are done, returns true while still running */
+bool PuzzleCheck_Poll(PuzzleCheck *check);
+
+/* stop the workers and wait for them, nothing is written to the index. each
+ * worker stops after the puzzle it is on
+ */
+void PuzzleCheck_Cancel(PuzzleCheck *check);
+
+/* puzzles checked so far and per second of wall time */
+int PuzzleCheck_Progress(const PuzzleCheck *check);
+double PuzzleCheck_Rate(const PuzzleCheck *check);
+
+static inline bool PuzzleCheck_Running(const PuzzleCheck *check) {
+	return check->running;
+}
+
+#endif // PUZZLE_CHECK_H
@@ -0,0 +1,85 @@
+/* include/puzzle_collection.h
+ * read-only access to bulk puzzle collections
+ *
+ * a collection is a text file with one board per line, BOARD_SIZE^2 cells of
+ * 1-9 for givens and 0 or . for blanks, optionally followed by whitespace and
+ * anything else. blank, comment and malformed lines are skipped.
+ *
+ * the file is memory-mapped, nothing is copied. the first open walks it once
+ * to find the puzzle lines and, for files of a megabyte or more, leaves the
+ * result next to it in <file>.idx so later opens of the unchanged file cost
+ * one small read. when every line is a
+ * puzzle of the same length, which is how most collections ship, the index is
+ * just that stride and no offsets are stored at all.
+ *
+ * the index also keeps one PuzzleCheckFlag byte per puzzle once the
+ * collection has been checked (puzzle_check.h), so that happens only once
+ * per file as well
+ */
+
+#ifndef PUZZLE_COLLECTION_H
+#define PUZZLE_COLLECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mapped_file.h"
+#include "puzzle_loader.h"
+
+#define PUZZLE_COLLECTION_INDEX_EXT ".idx"
+
+/* results of checking one puzzle, with its PuzzleRating in the top bits */
+typedef enum PuzzleCheckFlag {
+	CHECK_DONE = 1 << 0,
+	CHECK_CONFLICT = 1 << 1, /* two givens clash */
+	CHECK_UNSOLVABLE = 1 << 2,
+	CHECK_MULTIPLE = 1 << 3, /* more than one solution */
+	CHECK_DUPLICATE = 1 << 4 /* same givens as an earlier puzzle */
+} PuzzleCheckFlag;
+
+/* how far the simple techniques get on a unique puzzle */
+typedef enum PuzzleRating {
+	RATING_NONE = 0,
+	RATING_EASY = 1, /* naked singles solve it */
+	RATING_MEDIUM = 2, /* needs hidden singles */
+	RATING_HARD = 3 /* singles get stuck */
+} PuzzleRating;
+
+#define CHECK_RATING_SHIFT 6
+#define CHECK_RATING(check) ((PuzzleRating) ((check) >> CHECK_RATING_SHIFT))
+
+typedef struct PuzzleCollection {
+	MappedFile file;
+
+	int count; /* puzzle lines */
+	uint64_t stride; /* line i starts at i * stride, 0 if offsets is used */
+	uint64_t *offsets;
+
+	/* one PuzzleCheckFlag byte per puzzle, written by PuzzleCheck while it
+	 * runs, so other threads read them with __atomic_load_n
+	 */
+	uint8_t *checks;
+	bool checked; /* all of checks is final, it came from the index */
+
+	char path[MAX_FILEPATH_LEN];
+	/* file name, puzzles are titled "<name> #n" */
+	char name[MAX_PUZZLE_TITLE - 16];
+} PuzzleCollection;
+
+/* map path and load or build its index. false if it cannot be read or holds
+ * no puzzle lines
+ */
+bool PuzzleCollection_Open(PuzzleCollection *c, const char *path);
+void PuzzleCollection_Close(PuzzleCollection *c);
+
+/* rewrite the index with the check results, after every puzzle was checked */
+bool PuzzleCollection_SaveIndex(PuzzleCollection *c);
+
+/* start of puzzle line index, the BOARD_SIZE^2 cells are not terminated */
+const char *PuzzleCollection_Line(const PuzzleCollection *c, int index);
+
+/* load puzzle index of the collection, O(1) */
+bool PuzzleCollection_Get(const PuzzleCollection *c, int index, Puzzle *puzzle);
+
+#endif // PUZZLE_COLLECTION_H
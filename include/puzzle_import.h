@@ -0,0 +1,75 @@
+/* include/puzzle_import.h
+ * puzzle file formats
+ *
+ * importers read puzzles straight out of a buffer, usually a mapped file
+ * (mapped_file.h), through string views, so the only bytes copied are the
+ * ones that end up in a Puzzle. the format is picked by content: every
+ * importer scores the start of the text and the highest score parses it.
+ * built in, from most to least specific:
+ *   opensudoku  OpenSudoku XML, one <game data="..."/> per puzzle
+ *   ss          SimpleSudoku, a grid of givens optionally followed by grids of
+ *               the current state, where a cell of several digits holds its
+ *               pencil marks
+ *   sdm         one board per line, as puzzle_collection.h reads them
+ *   sdk         SadMan, #A/#D/... metadata lines, then the rows with . blanks
+ *   native      title:/author: lines, then the rows (ex. lol.txt)
+ * formats holding several puzzles emit them all, in file order
+ */
+
+#ifndef PUZZLE_IMPORT_H
+#define PUZZLE_IMPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "puzzle_loader.h"
+
+/* bytes of the text an importer's detect sees at most */
+#define PUZZLE_IMPORT_PROBE 4096
+#define PUZZLE_IMPORTERS_MAX 16
+
+/* a slice of someone else's buffer, not terminated */
+typedef struct StrView {
+	const char *s;
+	size_t len;
+} StrView;
+
+/* take the next line off the front of rest, without its line ending */
+StrView StrView_NextLine(StrView *rest);
+StrView StrView_Trim(StrView v);
+bool StrView_StartsWith(StrView v, const char *prefix);
+
+/* called for each puzzle parsed, return false to stop */
+typedef bool (*PuzzleImportFn)(const Puzzle *puzzle, void *user);
+
+typedef struct PuzzleImporter {
+	const char *name;
+	const char *extensions; /* space separated, with the dot */
+
+	/* how likely text is in this format, 0 = not at all */
+	int (*detect)(StrView text);
+
+	/* emit the puzzles in text until emit returns false, returns how many
+	 * were emitted
+	 */
+	int (*parse)(StrView text, PuzzleImportFn emit, void *user);
+} PuzzleImporter;
+
+/* add an importer next to the built in ones, it wins ties with them. not
+ * thread-safe, register before the first scan starts
+ */
+bool PuzzleImport_Register(const PuzzleImporter *importer);
+
+/* importer for text, NULL if none recognizes it */
+const PuzzleImporter *PuzzleImport_Detect(StrView text);
+
+/* true if some importer claims this file name's extension */
+bool PuzzleImport_HasExtension(const char *name);
+
+/* detect and parse text, returns how many puzzles were emitted */
+int PuzzleImport_Parse(StrView text, PuzzleImportFn emit, void *user);
+
+/* the first puzzle in text */
+bool PuzzleImport_First(StrView text, Puzzle *puzzle);
+
+#endif // PUZZLE_IMPORT_H
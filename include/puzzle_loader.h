@@ -6,6 +6,8 @@
 #define PUZZLE_LOADER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "board.h"
 
 #define MAX_PUZZLE_TITLE 128
@@ -21,23 +23,118 @@ typedef struct Puzzle {
 	Board board;
 } Puzzle;
 
-/* load puzzle from file */
+/* load the first puzzle of a file in any format puzzle_import.h knows */
 bool Puzzle_LoadFromFile(Puzzle *puzzle, const char *filepath);
 
-/* load puzzle from string  */
+/* load the first puzzle of a string, as Puzzle_LoadFromFile */
 bool Puzzle_LoadFromString(Puzzle *puzzle, const char *data);
 
-/* puzzle file list management */
-#define MAX_PUZZLE_FILES 100
-#define MAX_FILEPATH_LEN 256
+/* true if all n chars are cells: 1-9 for a given, 0 or . for a blank */
+bool Puzzle_IsCellLine(const char *line, size_t n);
+
+/* encode puzzle as a binary record (puzzle_record.h) into out, which must hold
+ * PUZZLE_RECORD_MAX bytes. givens always go in; entered values, notes, colors
+ * and metadata only if present, the solution only if one is passed.
+ * returns the record's length
+ */
+size_t Puzzle_ToRecord(const Puzzle *puzzle, const Board *solution, uint8_t *out);
+
+/* decode the record at the start of data. solution, if not NULL, gets the
+ * stored solution when the record has one. returns the record's length, so
+ * records can be read back to back, or 0 if it is truncated, corrupt or for
+ * another board size
+ */
+size_t Puzzle_FromRecord(
+	Puzzle *puzzle, Board *solution, const uint8_t *data, size_t len);
+
+/* read the metadata and count the clues of the file's first puzzle. false if
+ * it has no complete board
+ */
+bool Puzzle_ReadHeader(const char *filepath, PuzzleMetadata *meta, int *clues);
+
+/* puzzle file list management
+ * entries grow on demand and keep their strings in one arena. entries are
+ * indexed by lowercased title so a type-to-filter query is a binary search for
+ * the range of titles starting with it, and entries added later are merged
+ * into the index without resorting the rest
+ */
+#define MAX_FILEPATH_LEN 1024
+
+typedef struct PuzzleFileEntry {
+	/* offsets into the string arena, key is the title lowercased */
+	uint32_t path, title, key, author;
+	int clues; /* -1 if the board could not be read */
+	int rating; /* 0 = unrated */
+	long long mtime, size; /* of the file when it was last read */
+} PuzzleFileEntry;
+
+typedef struct PuzzleIndexEntry {
+	uint32_t key; /* arena offset, the arena moves as it grows */
+	int entry;
+} PuzzleIndexEntry;
 
 typedef struct PuzzleFileList {
-	char filepaths[MAX_PUZZLE_FILES][MAX_FILEPATH_LEN];
-	char titles[MAX_PUZZLE_FILES][MAX_PUZZLE_TITLE];
+	PuzzleFileEntry *entries;
 	int count;
+	int capacity;
+
+	char *strings;
+	size_t stringsLen;
+	size_t stringsCap;
+
+	PuzzleIndexEntry *index; /* entries[0..indexed), sorted by key */
+	int indexed;
+	int filterStart; /* rows matching the current filter are index[filterStart..] */
+	int filterCount;
+
+	int *pathSlots; /* open addressing on the path, entry + 1, 0 = empty */
+	int pathCapacity;
+	int pathHashed; /* entries[0..pathHashed) are in pathSlots */
 } PuzzleFileList;
 
-/* scan directory for .txt puzzle files */
+/* scan directory for puzzle files (PuzzleImport_HasExtension), replacing
+ * the list's contents. metadata comes from the directory's index
+ * (puzzle_cache.h) where the file is unchanged, and the index is rewritten if
+ * anything was added or removed
+ */
 int PuzzleFileList_ScanDirectory(PuzzleFileList *list, const char *directory);
+void PuzzleFileList_Free(PuzzleFileList *list);
+
+/* drop all entries but keep the buffers */
+void PuzzleFileList_Clear(PuzzleFileList *list);
+
+/* append an entry, its path/title/key/author offsets are filled in here.
+ * it is not visible to filtering until PuzzleFileList_UpdateIndex
+ */
+bool PuzzleFileList_Add(PuzzleFileList *list,
+	const char *path,
+	const char *title,
+	const char *author,
+	PuzzleFileEntry e);
+
+/* merge entries added since the last call into the index, the current filter
+ * has to be reapplied afterwards
+ */
+bool PuzzleFileList_UpdateIndex(PuzzleFileList *list);
+
+/* entry with this path, -1 if none. looked up in a hash of the paths, which
+ * takes in the entries added since the last lookup first
+ */
+int PuzzleFileList_Find(PuzzleFileList *list, const char *path);
+
+/* drop entry from the list and index. the last entry takes over its number
+ * and the removed strings stay in the arena until the next scan clears it.
+ * the current filter has to be reapplied afterwards
+ */
+void PuzzleFileList_Remove(PuzzleFileList *list, int entry);
+
+const char *PuzzleFileList_Path(const PuzzleFileList *list, int entry);
+const char *PuzzleFileList_Title(const PuzzleFileList *list, int entry);
+
+/* keep only titles starting with prefix (case-insensitive), returns the count */
+int PuzzleFileList_Filter(PuzzleFileList *list, const char *prefix);
+
+/* entry shown at row of the filtered, title-sorted view */
+int PuzzleFileList_FilteredEntry(const PuzzleFileList *list, int row);
 
 #endif // PUZZLE_LOADER_H
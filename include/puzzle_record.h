@@ -0,0 +1,71 @@
+/* include/puzzle_record.h
+ * compact binary puzzle record
+ *
+ * a record is one self-contained byte string, multi-byte fields little-endian.
+ * n = board size, cells = n * n in row-major order:
+ *
+ *   bytes  field
+ *   1      magic 'S'
+ *   1      version (PUZZLE_RECORD_VERSION)
+ *   1      board size n
+ *   1      flags (PuzzleRecordFlag), which of the optional sections follow
+ *   ...    givens, one of
+ *            dense:  cells nibbles, 0 = blank
+ *            sparse: cells-bit clue mask, then one nibble per clue in cell
+ *                    order (RECORD_SPARSE)
+ *   ...    solution, cells nibbles (RECORD_SOLUTION)
+ *   ...    entered values, cells nibbles, 0 = blank or given (RECORD_VALUES)
+ *   ...    notes, for each digit 1..n a cells-bit mask (RECORD_NOTES)
+ *   ...    colors, cells nibbles of CellColor (RECORD_COLORS)
+ *   ...    title and author, each a length byte and that many bytes
+ *          (RECORD_META)
+ *   4      fnv-1a of every byte before it
+ *
+ * nibbles pack two cells per byte, the earlier cell in the low half, and an
+ * odd count pads the last high half with 0. bit masks pack eight cells per
+ * byte, the earlier cell in the low bit. the encoder picks whichever givens
+ * layout is smaller; for 9x9 that is the sparse one up to 59 clues, making a
+ * typical puzzle 4 + 11 + ~13 + 4 bytes
+ */
+
+#ifndef PUZZLE_RECORD_H
+#define PUZZLE_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "puzzle_loader.h"
+
+#define PUZZLE_RECORD_MAGIC 'S'
+#define PUZZLE_RECORD_VERSION 1
+
+typedef enum PuzzleRecordFlag {
+	RECORD_SPARSE = 1 << 0,
+	RECORD_SOLUTION = 1 << 1,
+	RECORD_VALUES = 1 << 2,
+	RECORD_NOTES = 1 << 3,
+	RECORD_COLORS = 1 << 4,
+	RECORD_META = 1 << 5
+} PuzzleRecordFlag;
+
+#define RECORD_NIBBLE_BYTES(n) (((n) + 1) / 2)
+#define RECORD_MASK_BYTES(n) (((n) + 7) / 8)
+
+/* upper bound on a record's size, with every section present */
+#define PUZZLE_RECORD_MAX                                                              \
+	(4 + 4 * RECORD_NIBBLE_BYTES(BOARD_CELLS_MAX)                                  \
+		+ BOARD_SIZE_MAX * RECORD_MASK_BYTES(BOARD_CELLS_MAX)                  \
+		+ 2 + MAX_PUZZLE_TITLE + MAX_PUZZLE_AUTHOR + 4)
+
+/* pack n values of 0-15 two per byte, writes RECORD_NIBBLE_BYTES(n) bytes */
+void Record_PackNibbles(const uint8_t *cells, int n, uint8_t *out);
+void Record_UnpackNibbles(const uint8_t *in, int n, uint8_t *cells);
+
+/* pack n flags (0 or 1) eight per byte, writes RECORD_MASK_BYTES(n) bytes */
+void Record_PackBits(const uint8_t *flags, int n, uint8_t *out);
+void Record_UnpackBits(const uint8_t *in, int n, uint8_t *flags);
+
+uint32_t Record_Checksum(const uint8_t *data, size_t len);
+
+#endif // PUZZLE_RECORD_H
@@ -0,0 +1,53 @@
+/* include/puzzle_scan.h
+ * puzzles directory scan on a worker thread
+ *
+ * the worker does the readdir/stat/header work into a list of its own and
+ * hands finished entries over in batches. the menu polls once a frame and
+ * merges whatever arrived into the list it shows, so entries appear while
+ * the scan is still running
+ */
+
+#ifndef PUZZLE_SCAN_H
+#define PUZZLE_SCAN_H
+
+#include <stdbool.h>
+
+#include "puzzle_loader.h"
+
+/* entries the worker collects before handing them over, it also hands over
+ * whatever it has once PUZZLE_SCAN_INTERVAL seconds pass
+ */
+#define PUZZLE_SCAN_BATCH 64
+#define PUZZLE_SCAN_INTERVAL 0.1
+
+/* the worker's state, shared with the menu until either side lets go */
+typedef struct PuzzleScanJob PuzzleScanJob;
+
+typedef struct PuzzleScan {
+	PuzzleScanJob *job;
+	bool running;
+} PuzzleScan;
+
+/* start scanning directory, list is cleared and fills in as the scan goes.
+ * a scan already running is cancelled first. falls back to a synchronous
+ * PuzzleFileList_ScanDirectory if no thread can be started
+ */
+void PuzzleScan_Start(PuzzleScan *scan, PuzzleFileList *list, const char *directory);
+
+/* merge entries found since the last poll into list and its index. returns
+ * the number merged, the caller reapplies its filter if that is nonzero
+ */
+int PuzzleScan_Poll(PuzzleScan *scan, PuzzleFileList *list);
+
+/* tell the worker to stop and let go of it without waiting, so a worker
+ * stuck on a slow disk never holds up a frame. it frees what it has once it
+ * notices. the list keeps what it already got, and a cancelled scan does not
+ * rewrite the directory's index
+ */
+void PuzzleScan_Cancel(PuzzleScan *scan);
+
+static inline bool PuzzleScan_Running(const PuzzleScan *scan) {
+	return scan->running;
+}
+
+#endif // PUZZLE_SCAN_H
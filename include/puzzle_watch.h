@@ -0,0 +1,41 @@
+/* include/puzzle_watch.h
+ * live updates of a scanned puzzles directory
+ *
+ * after one full scan, files created, rewritten, moved or deleted in the
+ * directory are applied to the list one by one as they happen, so the menu
+ * stays current without rescanning everything. a worker thread reads the
+ * events and the headers of the files they name, so a frame only merges what
+ * it has ready. uses inotify and is only available on linux; elsewhere
+ * PuzzleWatch_Start fails and callers keep rescanning instead
+ */
+
+#ifndef PUZZLE_WATCH_H
+#define PUZZLE_WATCH_H
+
+#include <stdbool.h>
+
+#include "puzzle_loader.h"
+
+/* the worker's state, shared with the menu until either side lets go */
+typedef struct PuzzleWatchJob PuzzleWatchJob;
+
+typedef struct PuzzleWatch {
+	PuzzleWatchJob *job;
+	bool active;
+} PuzzleWatch;
+
+/* start watching directory. events queue up from here on, so start it before
+ * the scan that fills the list
+ */
+bool PuzzleWatch_Start(PuzzleWatch *w, const char *directory);
+/* tell the worker to stop without waiting for it, like PuzzleScan_Cancel */
+void PuzzleWatch_Stop(PuzzleWatch *w);
+
+/* apply the changes queued since the last poll to list and its index. returns
+ * how many files changed, or -1 if changes were lost (the kernel queue
+ * overflowed or the directory went away) and the list needs a full rescan.
+ * the caller reapplies its filter if the result is nonzero
+ */
+int PuzzleWatch_Poll(PuzzleWatch *w, PuzzleFileList *list);
+
+#endif // PUZZLE_WATCH_H
@@ -0,0 +1,180 @@
+/* include/replay.h
+ * replays: every move, selection and pause of a game with its time
+ *
+ * a replay is a stream of 4-byte events. an event is a uint32:
+ *   bits 0-3    ReplayEventKind
+ *   bits 4-10   BOARD_CELL the event happened at
+ *   bits 11-14  digit, color or on/off
+ *   bits 15-31  milliseconds since the previous event
+ * with two exceptions: REPLAY_WAIT holds a longer gap in bits 4-31, and
+ * REPLAY_CELL, which has no time of its own, the cell's value in bits
+ * 11-14, its color in bits 15-18 and its notes mask >> 1 in bits 19-27.
+ *
+ * playback applies moves the way the game does. whatever that does not
+ * reproduce (undo and redo, which depend on the history) is recorded as
+ * the REPLAY_CELL events that follow the move, so the board in playback
+ * always matches the one the player saw.
+ *
+ * every REPLAY_KEYFRAME_EVENTS events the whole state is stored as a
+ * keyframe, the board as a puzzle record (puzzle_record.h), so seeking
+ * decodes the keyframe before the target and applies at most that many
+ * events. the replays screen lists REPLAY_DIRECTORY and plays one back
+ * through a ReplayPlayer
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "puzzle_loader.h"
+
+#define REPLAY_DIRECTORY "replays"
+#define REPLAY_KEYFRAME_EVENTS 128
+#define REPLAY_SPEED_MIN 1.0
+#define REPLAY_SPEED_MAX 64.0
+#define REPLAY_SEEK_STEP_MS 5000 /* left/right on the replays screen */
+#define REPLAY_DELTA_MAX 0x1FFFF /* ms an event can carry */
+#define REPLAY_NAME_MAX 64 /* file name in REPLAY_DIRECTORY */
+
+typedef enum ReplayEventKind {
+	REPLAY_DIGIT,
+	REPLAY_CLEAR,
+	REPLAY_NOTE,
+	REPLAY_COLOR,
+	REPLAY_SELECT,
+	REPLAY_PAUSE, /* arg 1 paused, 0 resumed */
+	REPLAY_UNDO,
+	REPLAY_REDO,
+	REPLAY_AUTO_NOTES, /* arg 1 switched on, 0 off */
+	REPLAY_CELL, /* the state of one cell after the move before it */
+	REPLAY_WAIT, /* a gap too long for the next event */
+	REPLAY_KIND_COUNT
+} ReplayEventKind;
+
+static inline ReplayEventKind Replay_Kind(uint32_t event) {
+	return (ReplayEventKind) (event & 0xF);
+}
+
+static inline int Replay_Cell(uint32_t event) {
+	return (int) ((event >> 4) & 0x7F);
+}
+
+static inline int Replay_Arg(uint32_t event) {
+	return (int) ((event >> 11) & 0xF);
+}
+
+/* everything playback shows at one point in time */
+typedef struct ReplayState {
+	Board board;
+	int selRow, selCol;
+	bool paused;
+	bool autoNotes;
+	uint32_t ms; /* since the start */
+} ReplayState;
+
+typedef struct ReplayKeyframe {
+	uint32_t event; /* the state is that after every event before this one */
+	uint32_t ms;
+	uint32_t record; /* offset of the board's puzzle record in records */
+	uint8_t selRow, selCol;
+	uint8_t flags;
+} ReplayKeyframe;
+
+typedef struct Replay {
+	char title[MAX_PUZZLE_TITLE];
+	uint32_t *events;
+	int eventCount, eventCapacity;
+	ReplayKeyframe *keys;
+	int keyCount, keyCapacity;
+	uint8_t *records; /* keyframe boards, back to back */
+	size_t recordBytes, recordCapacity;
+} Replay;
+
+void Replay_Free(Replay *r);
+
+/* length in ms, the time of the last event */
+uint32_t Replay_Duration(const Replay *r);
+
+/* apply one event to s as the game would have */
+void Replay_Apply(ReplayState *s, uint32_t event);
+
+/* the newest max .rpl files in directory, newest first (the recorder's names
+ * sort by time). returns how many
+ */
+int Replay_List(const char *directory, char (*names)[REPLAY_NAME_MAX], int max);
+
+bool Replay_Save(const Replay *r, const char *path);
+/* false if path is not a replay for the current board size, or one with an
+ * event or keyframe that does not fit it
+ */
+bool Replay_Load(Replay *r, const char *path);
+
+/* whether seeking to each keyframe ends up where playing from the first one
+ * does. Replay_Load and the recorder check every replay with it
+ */
+bool Replay_Verify(const Replay *r);
+
+/* recording, driven by the game as it is played */
+typedef struct ReplayRecorder {
+	Replay replay;
+	bool recording;
+	ReplayState last; /* what the events so far add up to */
+	double startTime;
+	int sinceKey; /* events since the last keyframe */
+} ReplayRecorder;
+
+/* start over from start, now in seconds on any clock that the other calls
+ * use too
+ */
+void ReplayRecorder_Begin(
+	ReplayRecorder *rec, const ReplayState *start, const char *title, double now);
+
+/* a move of the given kind at (r, c) left the board as after */
+void ReplayRecorder_Move(ReplayRecorder *rec,
+	ReplayEventKind kind,
+	int r,
+	int c,
+	int arg,
+	const Board *after,
+	double now);
+
+/* record selection and pause changes since the last call */
+void ReplayRecorder_Poll(
+	ReplayRecorder *rec, int selRow, int selCol, bool paused, double now);
+
+/* stop recording and keep the replay in directory, made if it is missing, if
+ * anything was played
+ */
+void ReplayRecorder_End(ReplayRecorder *rec, const char *directory);
+
+/* playback */
+typedef struct ReplayPlayer {
+	const Replay *replay;
+	ReplayState state;
+	int next; /* the first event not applied yet */
+	double position; /* ms, may run ahead of state.ms between events */
+	double speed;
+} ReplayPlayer;
+
+void ReplayPlayer_Init(ReplayPlayer *p, const Replay *r);
+
+/* jump to ms from the nearest keyframe before it, false if that keyframe's
+ * board does not decode
+ */
+bool ReplayPlayer_Seek(ReplayPlayer *p, uint32_t ms);
+
+/* play on for seconds of real time at the player's speed */
+void ReplayPlayer_Advance(ReplayPlayer *p, double seconds);
+
+/* clamped to REPLAY_SPEED_MIN..REPLAY_SPEED_MAX */
+void ReplayPlayer_SetSpeed(ReplayPlayer *p, double speed);
+
+static inline bool ReplayPlayer_Done(const ReplayPlayer *p) {
+	return p->next >= p->replay->eventCount;
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,102 @@
+/* include/rules.h
+ * variant constraints on top of rows, columns and boxes
+ *
+ * mods describe extra rules in Lua (see mod.h), they are compiled once at
+ * load into these tables and nothing here ever calls back into Lua:
+ * - regions: more sets of cells that hold every digit at most once
+ *   (diagonals, windows), a bit per region on each cell
+ * - relations: a digit in one cell rules out a set of digits in a linked
+ *   cell (anti-knight, non-consecutive neighbours, ...). each relation is a
+ *   table forbid[v] of the digits it rules out, the links of a cell are a
+ *   slice of one flat array
+ * - cages: cells with distinct digits adding up to a sum, checked against
+ *   a table of which digits can still appear for a given remaining sum and
+ *   number of empty cells
+ * digit masks here use bit v - 1 for digit v, like the solver's
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+#define RULES_REGIONS_MAX 32
+#define RULES_RELATIONS_MAX 32 /* tables, each relation takes two */
+#define RULES_LINKS_MAX 4096
+#define RULES_CAGES_MAX BOARD_CELLS_MAX
+#define RULES_SUM_MAX (BOARD_SIZE_MAX * (BOARD_SIZE_MAX + 1) / 2)
+
+/* the cell at (row, col) constrains the cell the link belongs to */
+typedef struct RuleLink {
+	uint8_t cell; /* BOARD_CELL of the owner, only needed while building */
+	uint8_t row, col;
+	uint8_t relation; /* index into forbid */
+} RuleLink;
+
+typedef struct RuleCage {
+	BoardSet cells;
+	int sum;
+	int count;
+} RuleCage;
+
+typedef struct RuleSet {
+	int size; /* BOARD_SIZE the rules were built for, 0 = none */
+
+	int regionCount;
+	BoardSet regions[RULES_REGIONS_MAX];
+	uint32_t regionsOf[BOARD_CELLS_MAX]; /* bit per region holding the cell */
+	BoardSet regionPeers[BOARD_CELLS_MAX]; /* cells sharing a region */
+
+	int relationCount;
+	uint16_t forbid[RULES_RELATIONS_MAX][BOARD_SIZE_MAX + 1];
+	int linkCount;
+	RuleLink links[RULES_LINKS_MAX]; /* grouped by owner once finished */
+	uint16_t linkStart[BOARD_CELLS_MAX + 1]; /* cell i owns linkStart[i..i+1) */
+
+	int cageCount;
+	RuleCage cages[RULES_CAGES_MAX];
+	int8_t cageOf[BOARD_CELLS_MAX]; /* -1 outside any cage */
+
+	/* digits in some set of k distinct digits summing to s */
+	uint16_t combos[BOARD_SIZE_MAX + 1][RULES_SUM_MAX + 1];
+
+	uint64_t hash; /* of everything above, salts solver caches */
+} RuleSet;
+
+/* the rules in play, read-only once the mods are loaded */
+extern RuleSet g_rules;
+
+/* builders, false if a table is full or the input makes no sense. cells are
+ * BOARD_CELL indices
+ */
+void Rules_Clear(RuleSet *rs);
+bool Rules_AddRegion(RuleSet *rs, const int *cells, int count);
+/* returns the relation for Rules_Link, -1 if full. forbid[v] has bit w - 1
+ * set if v in the first cell rules out w in the second
+ */
+int Rules_AddRelation(RuleSet *rs, const uint16_t forbid[BOARD_SIZE_MAX + 1]);
+bool Rules_Link(RuleSet *rs, int relation, int first, int second);
+bool Rules_AddCage(RuleSet *rs, const int *cells, int count, int sum);
+/* group the links and fill in the derived tables, call once after adding */
+void Rules_Finish(RuleSet *rs);
+
+/* rules that apply to the current board, NULL if there are none */
+static inline const RuleSet *Rules_Active(void) {
+	return g_rules.size && g_rules.size == BOARD_SIZE ? &g_rules : NULL;
+}
+
+/* the cells whose candidates the rules tie to cell: its region peers, the
+ * cells linked to it and the rest of its cage
+ */
+BoardSet Rules_Peers(const RuleSet *rs, int cell);
+
+/* true if v at (r, c) breaks none of the rules given the rest of b */
+bool Rules_Allows(const RuleSet *rs, const Board *b, int r, int c, int v);
+
+/* add the filled cells of b that break a rule to conflicts */
+void Rules_FindConflicts(const RuleSet *rs, const Board *b, BoardSet *conflicts);
+
+#endif // RULES_H
@@ -8,14 +8,25 @@
 #include <stdbool.h>
 
 #include "game.h"
+#include "layout.h"
 #include "raylib.h"
 
+/* a board as drawn: the game in play, or the state a replay is at */
+typedef struct BoardView {
+	const Board *board;
+	int selRow, selCol;
+	bool paused; /* drawn covered */
+	bool highlightConflicts;
+	const BoardSet *conflicts; /* filled cells clashing with a peer */
+	const BoardSet *noteConflicts; /* BOARD_SIZE_MAX sets, by digit */
+	unsigned int version; /* moves on whenever board changes */
+	const Theme *theme;
+	const ModRuntime *mods; /* overlay drawn on top, NULL for none */
+} BoardView;
+
 /* helper function to safely convert unsigned int color to Color struct */
 Color ColorFromUInt(unsigned int c);
 
-/* forward declare internal type */
-typedef struct ThemeColors ThemeColors;
-
 /* drawing helpers */
 void UI_DrawTopBar(const Game *g);
 void UI_DrawBoard(const Game *g);
@@ -23,6 +34,16 @@ void UI_DrawSidebar(const Game *g, const ThemeColors *colors);
 void UI_DrawDifficultyMenu(Game *g);
 void UI_DrawLoadPuzzleMenu(Game *g);
 void UI_DrawSettingsMenu(Game *g);
+void UI_DrawReplayMenu(Game *g);
+
+#include "profiler.h"
+#ifdef PROFILER_ENABLED
+/* frame profiler overlay, toggled with f3 */
+void UI_DrawProfiler(void);
+#endif
+
+/* release the cached board and glyph textures, call before CloseWindow */
+void UI_Shutdown(void);
 
 /* menu helpers */
 int UI_Menu(const char *const *items, int count, int *selected);
@@ -0,0 +1,444 @@
+/* src/autosave.c
+ * move journal and snapshots, written off the render thread
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "autosave.h"
+#include "mapped_file.h"
+
+#define SNAPSHOT_MAGIC "SDKSAV1"
+#define JOURNAL_MAGIC "SDKJRN1"
+#define AUTOSAVE_VERSION 1
+#define AUTO_NOTES_FLAG 1u
+
+/* native byte order like the config snapshot, the records are packed by hand */
+typedef struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t generation;
+	int32_t elapsedSeconds;
+	uint32_t flags;
+	uint32_t recordSize; /* the puzzle record that follows */
+	uint32_t boardSize;
+} SnapshotHeader;
+
+typedef struct JournalHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t generation;
+} JournalHeader;
+
+/* records */
+
+static uint8_t check_byte(uint32_t payload, uint32_t index) {
+	uint8_t bytes[7] = { (uint8_t) payload,
+		(uint8_t) (payload >> 8),
+		(uint8_t) (payload >> 16),
+		(uint8_t) index,
+		(uint8_t) (index >> 8),
+		(uint8_t) (index >> 16),
+		(uint8_t) (index >> 24) };
+	return (uint8_t) Record_Checksum(bytes, sizeof(bytes));
+}
+
+static void put_record(uint8_t *out, uint32_t payload, uint32_t index) {
+	uint32_t v = payload | (uint32_t) check_byte(payload, index) << 24;
+	for (int i = 0; i < 4; i++)
+		out[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint32_t cell_payload(const Board *b, int i) {
+	int r = i / BOARD_SIZE_MAX, c = i % BOARD_SIZE_MAX;
+	return (uint32_t) i | (uint32_t) Board_Value(b, r, c) << 7
+		| (uint32_t) Board_Color(b, r, c) << 11
+		| (uint32_t) (Board_GetNotes(b, r, c) >> 1) << 15;
+}
+
+static uint32_t clock_payload(int seconds) {
+	if (seconds < 0) seconds = 0;
+	if (seconds > 0x1FFFF) seconds = 0x1FFFF;
+	return AUTOSAVE_CLOCK | (uint32_t) seconds << 7;
+}
+
+/* file helpers */
+
+static bool sync_file(FILE *f) {
+	if (fflush(f) != 0) return false;
+#ifdef _WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+/* a file's name lives in its directory, which needs its own sync for a new
+ * or renamed file to survive a crash. ntfs journals that with the move
+ */
+static void sync_directory(const char *path) {
+#ifndef _WIN32
+	char dir[256] = ".";
+	const char *slash = strrchr(path, '/');
+	if (slash) snprintf(dir, sizeof(dir), "%.*s", (int) (slash - path), path);
+	int fd = open(dir, O_RDONLY);
+	if (fd < 0) return;
+	fsync(fd);
+	close(fd);
+#else
+	(void) path;
+#endif
+}
+
+/* move tmpPath over path in one step, there is never a moment without it */
+static bool replace_file(const char *tmpPath, const char *path) {
+#ifdef _WIN32
+	/* rename does not replace an existing file there, removing it first would
+	 * leave a window with no snapshot at all
+	 */
+	DWORD flags = MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH;
+	return MoveFileExA(tmpPath, path, flags) != 0;
+#else
+	if (rename(tmpPath, path) != 0) return false;
+	sync_directory(path);
+	return true;
+#endif
+}
+
+/* data, synced, then renamed over path so a crash leaves the old or new file */
+static bool write_atomic(const char *path, const void *data, size_t size) {
+	char tmpPath[256];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+	FILE *f = fopen(tmpPath, "wb");
+	if (!f) return false;
+	bool ok = fwrite(data, 1, size, f) == size && sync_file(f);
+	ok = fclose(f) == 0 && ok;
+
+	if (ok && replace_file(tmpPath, path)) return true;
+	remove(tmpPath);
+	return false;
+}
+
+static FILE *start_journal(uint32_t generation) {
+	JournalHeader h = { .version = AUTOSAVE_VERSION, .generation = generation };
+	memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+
+	FILE *f = fopen(AUTOSAVE_JOURNAL, "wb");
+	if (!f) return NULL;
+	if (fwrite(&h, sizeof(h), 1, f) != 1 || !sync_file(f)) {
+		fclose(f);
+		return NULL;
+	}
+	sync_directory(AUTOSAVE_JOURNAL);
+	return f;
+}
+
+/* worker */
+
+static FILE *close_journal(FILE *journal) {
+	if (journal) fclose(journal);
+	return NULL;
+}
+
+/* the journal belongs to the snapshot before it, a new one restarts it. a
+ * crash between the two leaves a journal of the old generation, which
+ * loading skips. returns the new journal
+ */
+static FILE *write_snapshot(FILE *journal, const uint8_t *snapshot, size_t size) {
+	close_journal(journal);
+	if (!write_atomic(AUTOSAVE_SNAPSHOT, snapshot, size)) {
+		fprintf(stderr, "autosave: cannot write %s\n", AUTOSAVE_SNAPSHOT);
+		return NULL;
+	}
+	SnapshotHeader h;
+	memcpy(&h, snapshot, sizeof(h));
+	return start_journal(h.generation);
+}
+
+/* a failed write ends the journal there, the records after it would not line
+ * up. it comes back with the next snapshot
+ */
+static FILE *append_records(FILE *journal, const uint8_t *records, int count) {
+	size_t n = (size_t) count;
+	if (fwrite(records, 4, n, journal) == n && sync_file(journal)) return journal;
+	fprintf(stderr, "autosave: cannot write %s\n", AUTOSAVE_JOURNAL);
+	return close_journal(journal);
+}
+
+/* sleep until the next batch is due, false once told to stop */
+static bool wait_batch(Autosave *a) {
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	long ns = until.tv_nsec + (long) (AUTOSAVE_SYNC_INTERVAL * 1e9);
+	until.tv_sec += ns / 1000000000L;
+	until.tv_nsec = ns % 1000000000L;
+
+	while (!a->stop && pthread_cond_timedwait(&a->wake, &a->lock, &until) == 0)
+		;
+	return !a->stop;
+}
+
+static void *autosave_worker(void *arg) {
+	Autosave *a = arg;
+	FILE *journal = NULL;
+	static uint8_t records[sizeof(a->queue)];
+	static uint8_t snapshot[sizeof(a->snapshot)];
+
+	pthread_mutex_lock(&a->lock);
+	for (;;) {
+		bool more = wait_batch(a);
+
+		/* take the batch and leave the lock before touching the disk */
+		int count = a->queued;
+		memcpy(records, a->queue, (size_t) count * 4);
+		a->queued = 0;
+		size_t snapSize = a->snapshotSize;
+		if (snapSize) memcpy(snapshot, a->snapshot, snapSize);
+		a->snapshotSize = 0;
+		bool discard = a->discard;
+		a->discard = false;
+		pthread_mutex_unlock(&a->lock);
+
+		if (discard) {
+			journal = close_journal(journal);
+			remove(AUTOSAVE_SNAPSHOT);
+			remove(AUTOSAVE_JOURNAL);
+		}
+		if (snapSize) journal = write_snapshot(journal, snapshot, snapSize);
+		if (journal && count) journal = append_records(journal, records, count);
+
+		pthread_mutex_lock(&a->lock);
+		if (!more) break;
+	}
+	pthread_mutex_unlock(&a->lock);
+
+	close_journal(journal);
+	return NULL;
+}
+
+bool Autosave_Start(Autosave *a) {
+	*a = (Autosave) { 0 };
+	/* generations count up from the start time, so a journal one run left
+	 * behind never matches a snapshot of the next
+	 */
+	a->generation = (uint32_t) time(NULL) << 8;
+	if (pthread_mutex_init(&a->lock, NULL) != 0) return false;
+	if (pthread_cond_init(&a->wake, NULL) != 0) {
+		pthread_mutex_destroy(&a->lock);
+		return false;
+	}
+	if (pthread_create(&a->thread, NULL, autosave_worker, a) != 0) {
+		pthread_cond_destroy(&a->wake);
+		pthread_mutex_destroy(&a->lock);
+		return false;
+	}
+	a->running = true;
+	return true;
+}
+
+void Autosave_Stop(Autosave *a) {
+	if (!a->running) return;
+
+	pthread_mutex_lock(&a->lock);
+	a->stop = true;
+	pthread_cond_signal(&a->wake);
+	pthread_mutex_unlock(&a->lock);
+
+	/* the worker writes out the last batch before it returns */
+	pthread_join(a->thread, NULL);
+	pthread_cond_destroy(&a->wake);
+	pthread_mutex_destroy(&a->lock);
+	a->running = false;
+	a->active = false;
+}
+
+/* render thread */
+
+/* hand the worker a snapshot of a->game, dropping the records it covers */
+static void queue_snapshot(Autosave *a) {
+	uint8_t buffer[sizeof(a->snapshot)];
+	SnapshotHeader h = { .version = AUTOSAVE_VERSION,
+		.generation = ++a->generation,
+		.elapsedSeconds = a->game.elapsedSeconds,
+		.flags = a->game.autoNotes ? AUTO_NOTES_FLAG : 0,
+		.boardSize = BOARD_SIZE };
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	size_t size = Puzzle_ToRecord(&a->game.puzzle, NULL, buffer + sizeof(h));
+	h.recordSize = (uint32_t) size;
+	memcpy(buffer, &h, sizeof(h));
+	a->records = 0;
+
+	pthread_mutex_lock(&a->lock);
+	memcpy(a->snapshot, buffer, sizeof(h) + size);
+	a->snapshotSize = sizeof(h) + size;
+	a->queued = 0;
+	a->discard = false;
+	pthread_mutex_unlock(&a->lock);
+}
+
+void Autosave_Begin(Autosave *a, const AutosaveGame *game) {
+	if (!a->running) return;
+	a->game = *game;
+	a->active = true;
+	queue_snapshot(a);
+}
+
+void Autosave_Checkpoint(Autosave *a, int elapsedSeconds) {
+	if (!a->running || !a->active) return;
+	a->game.elapsedSeconds = elapsedSeconds;
+	queue_snapshot(a);
+}
+
+void Autosave_Discard(Autosave *a) {
+	if (!a->running || !a->active) return;
+	a->active = false;
+
+	pthread_mutex_lock(&a->lock);
+	a->queued = 0;
+	a->snapshotSize = 0;
+	a->discard = true;
+	pthread_mutex_unlock(&a->lock);
+}
+
+/* true if the planes that records carry are the same */
+static bool same_cells(const Board *x, const Board *y) {
+	return memcmp(x->value, y->value, sizeof(x->value)) == 0
+		&& memcmp(x->color, y->color, sizeof(x->color)) == 0
+		&& memcmp(x->notes, y->notes, sizeof(x->notes)) == 0;
+}
+
+void Autosave_Record(Autosave *a, const Board *b, int elapsedSeconds, bool autoNotes) {
+	if (!a->active) return;
+	AutosaveGame *saved = &a->game;
+	Board *last = &saved->puzzle.board;
+
+	if (autoNotes != saved->autoNotes) {
+		/* not worth a record kind of its own */
+		saved->autoNotes = autoNotes;
+		saved->elapsedSeconds = elapsedSeconds;
+		*last = *b;
+		queue_snapshot(a);
+		return;
+	}
+	bool changed = !same_cells(last, b);
+	int ticked = elapsedSeconds - saved->elapsedSeconds;
+	if (!changed && ticked < AUTOSAVE_CLOCK_STEP) return;
+
+	uint8_t batch[(BOARD_CELLS_MAX + 1) * 4];
+	int count = 0;
+	if (ticked) {
+		put_record(batch, clock_payload(elapsedSeconds), a->records + count++);
+		saved->elapsedSeconds = elapsedSeconds;
+	}
+	for (int r = 0; changed && r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			int i = BOARD_CELL(r, c);
+			uint32_t payload = cell_payload(b, i);
+			if (payload == cell_payload(last, i)) continue;
+			put_record(batch + count * 4, payload, a->records + count);
+			count++;
+		}
+	*last = *b;
+
+	/* a full queue means the disk is behind, a snapshot replaces all of it */
+	bool full = false;
+	if (a->records + count < AUTOSAVE_SNAPSHOT_MOVES) {
+		pthread_mutex_lock(&a->lock);
+		full = a->queued + count > AUTOSAVE_QUEUE;
+		if (!full) {
+			memcpy(a->queue + a->queued * 4, batch, (size_t) count * 4);
+			a->queued += count;
+		}
+		pthread_mutex_unlock(&a->lock);
+		a->records += (uint32_t) count;
+		if (!full) return;
+	}
+	queue_snapshot(a);
+}
+
+/* loading */
+
+static uint32_t load_le32(const uint8_t *p) {
+	return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16
+		| (uint32_t) p[3] << 24;
+}
+
+/* apply the journal's records on top of out, up to the first bad one */
+static int replay_journal(AutosaveGame *out, uint32_t generation) {
+	MappedFile m;
+	if (!MappedFile_Open(&m, AUTOSAVE_JOURNAL)) return 0;
+
+	JournalHeader h;
+	int applied = 0;
+	if (m.size < sizeof(h)) goto done;
+	memcpy(&h, m.data, sizeof(h));
+	if (memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) != 0) goto done;
+	if (h.version != AUTOSAVE_VERSION || h.generation != generation) goto done;
+
+	Board *b = &out->puzzle.board;
+	const uint8_t *p = (const uint8_t *) m.data + sizeof(h);
+	size_t count = (m.size - sizeof(h)) / 4;
+	for (size_t k = 0; k < count; k++, p += 4) {
+		uint32_t v = load_le32(p), payload = v & 0xFFFFFF;
+		if ((v >> 24) != check_byte(payload, (uint32_t) k)) break;
+
+		int cell = payload & 0x7F;
+		if (cell == AUTOSAVE_CLOCK) {
+			out->elapsedSeconds = (int) (payload >> 7);
+			applied++;
+			continue;
+		}
+		int r = cell / BOARD_SIZE_MAX, c = cell % BOARD_SIZE_MAX;
+		if (r >= BOARD_SIZE || c >= BOARD_SIZE) break;
+		int value = (payload >> 7) & 0xF;
+		if (value > BOARD_SIZE) break;
+
+		if (!Board_IsGiven(b, r, c)) Board_Set(b, r, c, value, false);
+		Board_SetColor(b, r, c, (int) ((payload >> 11) & 0xF));
+		Board_SetNotes(b, r, c, (uint16_t) (((payload >> 15) & 0x1FF) << 1));
+		applied++;
+	}
+
+done:
+	MappedFile_Close(&m);
+	return applied;
+}
+
+bool Autosave_Load(AutosaveGame *out) {
+	MappedFile m;
+	if (!MappedFile_Open(&m, AUTOSAVE_SNAPSHOT)) return false;
+
+	SnapshotHeader h;
+	bool ok = m.size >= sizeof(h);
+	if (ok) memcpy(&h, m.data, sizeof(h));
+	ok = ok && memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0;
+	ok = ok && h.version == AUTOSAVE_VERSION && h.boardSize == (uint32_t) BOARD_SIZE;
+	ok = ok && h.recordSize <= m.size - sizeof(h);
+
+	*out = (AutosaveGame) { 0 };
+	if (ok) {
+		const uint8_t *record = (const uint8_t *) m.data + sizeof(h);
+		ok = Puzzle_FromRecord(&out->puzzle, NULL, record, h.recordSize)
+			== h.recordSize;
+	}
+	MappedFile_Close(&m);
+	if (!ok) return false;
+
+	out->elapsedSeconds = h.elapsedSeconds;
+	out->autoNotes = h.flags & AUTO_NOTES_FLAG;
+	replay_journal(out, h.generation);
+	return true;
+}
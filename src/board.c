@@ -7,56 +7,234 @@
 
 #include "board.h"
 #include "generator.h"
+#include "profiler.h"
+#include "rules.h"
+
+static inline int box_of(int r, int c) {
+	return (r / SUBGRID) * SUBGRID + (c / SUBGRID);
+}
+
+/* shift a 128-bit set left by n (n < 128) */
+static inline BoardSet set_shl(BoardSet s, int n) {
+	if (n == 0) return s;
+	if (n >= 64) return (BoardSet) { 0, s.lo << (n - 64) };
+	return (BoardSet) { s.lo << n, (s.hi << n) | (s.lo >> (64 - n)) };
+}
+
+BoardSet Board_RowSet(int r) {
+	BoardSet row = { (1ull << BOARD_SIZE) - 1, 0 };
+	return set_shl(row, r * BOARD_SIZE_MAX);
+}
+
+BoardSet Board_ColSet(int c) {
+	BoardSet col = { 0, 0 };
+	for (int i = 0; i < BOARD_SIZE; i++)
+		col = BoardSet_Or(col, BoardSet_Bit(BOARD_CELL(i, c)));
+	return col;
+}
+
+BoardSet Board_BoxSet(int r, int c) {
+	int r0 = (r / SUBGRID) * SUBGRID;
+	int c0 = (c / SUBGRID) * SUBGRID;
+	BoardSet strip = { (1ull << SUBGRID) - 1, 0 };
+	BoardSet box = { 0, 0 };
+	for (int i = 0; i < SUBGRID; i++)
+		box = BoardSet_Or(box, set_shl(strip, BOARD_CELL(r0 + i, c0)));
+	return box;
+}
+
+BoardSet Board_PeerSet(int r, int c) {
+	BoardSet peers = BoardSet_Or(Board_RowSet(r), Board_ColSet(c));
+	peers = BoardSet_Or(peers, Board_BoxSet(r, c));
+	return BoardSet_AndNot(peers, BoardSet_Bit(BOARD_CELL(r, c)));
+}
 
 void Board_Clear(Board *b) {
-	memset(b->cells, 0, sizeof(b->cells));
+	memset(b, 0, sizeof(*b));
 }
 
 void Board_FromString(Board *b, const char *s) {
 	Board_Clear(b);
 	if (!s) return;
 	for (int i = 0; i < BOARD_SIZE * BOARD_SIZE && s[i]; i++) {
-		int r = i / BOARD_SIZE, c = i % BOARD_SIZE;
 		char ch = s[i];
-		if (ch >= '1' && ch <= '9') {
-			b->cells[r][c].value = (uint8_t) (ch - '0');
-			b->cells[r][c].given = true;
-		}
+		if (ch >= '1' && ch <= '9')
+			Board_Set(b, i / BOARD_SIZE, i % BOARD_SIZE, ch - '0', true);
 	}
 }
 
 bool Board_IsValidMove(const Board *b, int r, int c, int v) {
+	PROFILE_COUNT(PROF_VALID_MOVE_CHECKS);
 	if (v < 1 || v > 9) return false;
 
-	/* check row and column simultaneously */
+	/* if v is in one of the three units, the cell itself must be its only
+	 * holder there
+	 */
+	uint16_t bit = (uint16_t) (1u << v);
+	if ((b->rowMask[r] | b->colMask[c] | b->boxMask[box_of(r, c)]) & bit) {
+		if (b->value[BOARD_CELL(r, c)] != v) return false;
+		if (BoardSet_Any(BoardSet_And(b->digits[v - 1], Board_PeerSet(r, c))))
+			return false;
+	}
+
+	const RuleSet *rules = Rules_Active();
+	return !rules || Rules_Allows(rules, b, r, c, v);
+}
+
+/* drop v from a unit mask once no cell in the unit holds it anymore */
+static void Board_UnplaceDigit(Board *b, int r, int c, int v) {
+	BoardSet cells = b->digits[v - 1];
+	uint16_t bit = (uint16_t) (1u << v);
+	int box = box_of(r, c);
+
+	if (!BoardSet_Any(BoardSet_And(cells, Board_RowSet(r)))) b->rowMask[r] &= ~bit;
+	if (!BoardSet_Any(BoardSet_And(cells, Board_ColSet(c)))) b->colMask[c] &= ~bit;
+	if (!BoardSet_Any(BoardSet_And(cells, Board_BoxSet(r, c))))
+		b->boxMask[box] &= ~bit;
+}
+
+void Board_Set(Board *b, int r, int c, int v, bool markGiven) {
+	if (r < 0 || r >= BOARD_SIZE || c < 0 || c >= BOARD_SIZE) return;
+
+	int i = BOARD_CELL(r, c);
+	BoardSet bit = BoardSet_Bit(i);
+	int old = b->value[i];
+
+	if (old) {
+		b->digits[old - 1] = BoardSet_AndNot(b->digits[old - 1], bit);
+		Board_UnplaceDigit(b, r, c, old);
+		b->filled--;
+		b->hash ^= Board_ZobristKey(i, old);
+	}
+
+	b->value[i] = (uint8_t) v;
+	if (v) {
+		uint16_t mask = (uint16_t) (1u << v);
+		b->digits[v - 1] = BoardSet_Or(b->digits[v - 1], bit);
+		b->rowMask[r] |= mask;
+		b->colMask[c] |= mask;
+		b->boxMask[box_of(r, c)] |= mask;
+		b->filled++;
+		b->hash ^= Board_ZobristKey(i, v);
+		if (markGiven) b->given = BoardSet_Or(b->given, bit);
+	}
+	else {
+		/* an empty cell can never be part of the puzzle */
+		b->given = BoardSet_AndNot(b->given, bit);
+	}
+}
+
+/* all cells on the board */
+static BoardSet all_cells(void) {
+	BoardSet all = { 0, 0 };
+	for (int r = 0; r < BOARD_SIZE; r++)
+		all = BoardSet_Or(all, Board_RowSet(r));
+	return all;
+}
+
+static BoardSet empty_cells(const Board *b) {
+	BoardSet filled = { 0, 0 };
+	for (int v = 0; v < BOARD_SIZE; v++)
+		filled = BoardSet_Or(filled, b->digits[v]);
+	return BoardSet_AndNot(all_cells(), filled);
+}
+
+/* cells sharing a unit with a placed v */
+static BoardSet blocked_by(const Board *b, int v) {
+	uint16_t bit = (uint16_t) (1u << v);
+	BoardSet blocked = { 0, 0 };
 	for (int i = 0; i < BOARD_SIZE; i++) {
-		if (i != c && b->cells[r][i].value == v) return false;
-		if (i != r && b->cells[i][c].value == v) return false;
+		if (b->rowMask[i] & bit) blocked = BoardSet_Or(blocked, Board_RowSet(i));
+		if (b->colMask[i] & bit) blocked = BoardSet_Or(blocked, Board_ColSet(i));
+		if (b->boxMask[i] & bit) {
+			int r0 = (i / SUBGRID) * SUBGRID, c0 = (i % SUBGRID) * SUBGRID;
+			blocked = BoardSet_Or(blocked, Board_BoxSet(r0, c0));
+		}
 	}
+	return blocked;
+}
 
-	/* check subgrid */
-	int r0 = (r / SUBGRID) * SUBGRID;
-	int c0 = (c / SUBGRID) * SUBGRID;
-	for (int rr = r0; rr < r0 + SUBGRID; rr++) {
-		for (int cc = c0; cc < c0 + SUBGRID; cc++) {
-			if ((rr != r || cc != c) && b->cells[rr][cc].value == v)
-				return false;
+/* drop the notes in cells that the variant rules rule out, cell by cell */
+static void prune_notes(Board *b, const RuleSet *rules, BoardSet cells) {
+	for (int v = 1; v <= BOARD_SIZE; v++) {
+		BoardSet notes = BoardSet_And(b->notes[v - 1], cells);
+		int i;
+		while ((i = BoardSet_Pop(&notes)) >= 0) {
+			int r = i / BOARD_SIZE_MAX, c = i % BOARD_SIZE_MAX;
+			if (Rules_Allows(rules, b, r, c, v)) continue;
+			BoardSet bit = BoardSet_Bit(i);
+			b->notes[v - 1] = BoardSet_AndNot(b->notes[v - 1], bit);
 		}
 	}
-	return true;
 }
 
-void Board_Set(Board *b, int r, int c, int v, bool markGiven) {
-	if (r < 0 || r >= BOARD_SIZE || c < 0 || c >= BOARD_SIZE) return;
-	b->cells[r][c].value = (uint8_t) v;
-	if (markGiven) b->cells[r][c].given = true;
+void Board_FillCandidates(Board *b) {
+	BoardSet empty = empty_cells(b);
+	for (int v = 1; v <= BOARD_SIZE; v++)
+		b->notes[v - 1] = BoardSet_AndNot(empty, blocked_by(b, v));
+
+	const RuleSet *rules = Rules_Active();
+	if (rules) prune_notes(b, rules, empty);
+}
+
+void Board_RestoreCandidates(Board *b, int r, int c, int v) {
+	if (v < 1 || v > 9) return;
+
+	/* the cell's own candidates straight from the unit masks */
+	int cell = BOARD_CELL(r, c);
+	uint16_t all = (uint16_t) (((1u << BOARD_SIZE) - 1) << 1);
+	uint16_t used = b->rowMask[r] | b->colMask[c] | b->boxMask[box_of(r, c)];
+	if (!b->value[cell]) Board_SetNotes(b, r, c, all & ~used);
+
+	BoardSet empty = empty_cells(b);
+	BoardSet targets = BoardSet_And(Board_PeerSet(r, c), empty);
+	const RuleSet *rules = Rules_Active();
+	if (!rules) {
+		targets = BoardSet_AndNot(targets, blocked_by(b, v));
+		b->notes[v - 1] = BoardSet_Or(b->notes[v - 1], targets);
+		return;
+	}
+
+	/* v may be back in the cells the rules tie to (r, c) as well, and a
+	 * relation or cage may have held any digit out of them. add everything
+	 * the units allow there, then let the rules prune it
+	 */
+	BoardSet tied = BoardSet_And(Rules_Peers(rules, cell), empty);
+	targets = BoardSet_Or(targets, tied);
+	for (int w = 1; w <= BOARD_SIZE; w++) {
+		BoardSet add = BoardSet_AndNot(w == v ? targets : tied, blocked_by(b, w));
+		b->notes[w - 1] = BoardSet_Or(b->notes[w - 1], add);
+	}
+	prune_notes(b, rules, BoardSet_Or(targets, BoardSet_Bit(cell)));
 }
 
 bool Board_IsComplete(const Board *b) {
-	for (int r = 0; r < BOARD_SIZE; r++)
-		for (int c = 0; c < BOARD_SIZE; c++)
-			if (b->cells[r][c].value == 0) return false;
-	return true;
+	return b->filled == BOARD_SIZE * BOARD_SIZE;
+}
+
+uint16_t Board_GetNotes(const Board *b, int r, int c) {
+	int i = BOARD_CELL(r, c);
+	uint16_t notes = 0;
+	for (int v = 1; v <= BOARD_SIZE; v++)
+		if (BoardSet_Test(b->notes[v - 1], i)) notes |= (uint16_t) (1u << v);
+	return notes;
+}
+
+void Board_SetNotes(Board *b, int r, int c, uint16_t notes) {
+	BoardSet bit = BoardSet_Bit(BOARD_CELL(r, c));
+	for (int v = 1; v <= BOARD_SIZE; v++) {
+		if (notes & (1u << v))
+			b->notes[v - 1] = BoardSet_Or(b->notes[v - 1], bit);
+		else
+			b->notes[v - 1] = BoardSet_AndNot(b->notes[v - 1], bit);
+	}
+}
+
+void Board_ToggleNote(Board *b, int r, int c, int v) {
+	if (v < 1 || v > 9) return;
+	BoardSet bit = BoardSet_Bit(BOARD_CELL(r, c));
+	b->notes[v - 1].lo ^= bit.lo;
+	b->notes[v - 1].hi ^= bit.hi;
 }
 
 void Board_GenerateRandom(Board *b, Difficulty difficulty) {
@@ -66,20 +244,34 @@ void Board_GenerateRandom(Board *b, Difficulty difficulty) {
 void Board_ClearNotesAffectedBy(Board *b, int r, int c, int v) {
 	if (v < 1 || v > 9) return;
 
-	unsigned int noteBit = 1u << v;
+	/* row, column, subgrid and the cell itself in one mask */
+	BoardSet affected
+		= BoardSet_Or(Board_PeerSet(r, c), BoardSet_Bit(BOARD_CELL(r, c)));
+	b->notes[v - 1] = BoardSet_AndNot(b->notes[v - 1], affected);
 
-	/* clear notes in the same row and column simultaneously */
-	for (int i = 0; i < BOARD_SIZE; i++) {
-		b->cells[r][i].notes &= ~noteBit;
-		b->cells[i][c].notes &= ~noteBit;
-	}
+	/* regions, relations and cages reach further, and past v */
+	const RuleSet *rules = Rules_Active();
+	if (rules) prune_notes(b, rules, Rules_Peers(rules, BOARD_CELL(r, c)));
+}
 
-	/* clear notes in the same subgrid (some cells already cleared above) */
-	int r0 = (r / SUBGRID) * SUBGRID;
-	int c0 = (c / SUBGRID) * SUBGRID;
-	for (int row = r0; row < r0 + SUBGRID; row++) {
-		for (int col = c0; col < c0 + SUBGRID; col++) {
-			b->cells[row][col].notes &= ~noteBit;
-		}
+void Board_FindConflicts(
+	const Board *b, BoardSet *conflicts, BoardSet noteConflicts[BOARD_SIZE_MAX]) {
+	*conflicts = (BoardSet) { 0, 0 };
+
+	for (int v = 1; v <= BOARD_SIZE; v++) {
+		/* every cell that can see a placed v */
+		BoardSet seen = { 0, 0 };
+		BoardSet placed = b->digits[v - 1];
+		int i;
+		while ((i = BoardSet_Pop(&placed)) >= 0)
+			seen = BoardSet_Or(seen,
+				Board_PeerSet(i / BOARD_SIZE_MAX, i % BOARD_SIZE_MAX));
+
+		BoardSet clash = BoardSet_And(b->digits[v - 1], seen);
+		*conflicts = BoardSet_Or(*conflicts, clash);
+		noteConflicts[v - 1] = BoardSet_And(b->notes[v - 1], seen);
 	}
+
+	const RuleSet *rules = Rules_Active();
+	if (rules) Rules_FindConflicts(rules, b, conflicts);
 }
@@ -5,10 +5,12 @@
 #define _GNU_SOURCE
 
 #include "config.h"
+#include "config_snapshot.h"
 
 #define LUA_IMPL
 #include "minilua.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -141,6 +143,7 @@ bool Config_Load(Config *cfg, const char *path) {
 		lua_get_int(L, "size_normal", &cfg->font_size_normal);
 		lua_get_int(L, "size_small", &cfg->font_size_small);
 		lua_get_int(L, "size_note", &cfg->font_size_note);
+		lua_get_str(L, "path", cfg->font_path, sizeof(cfg->font_path));
 	}
 	lua_pop(L, 1);
 
@@ -314,9 +317,36 @@ bool Config_UpdateValues(
 	return Config_Load(&g_config, path);
 }
 
-/* initialize config with defaults and load from file */
-void Config_Init(void) {
-	g_config = (Config) { .app_title = "sudoku",
+/* fields first..last of both configs differ, they have to be adjacent */
+#define CONFIG_RANGE_DIFFERS(a, b, first, last)                                        \
+	(memcmp(&(a)->first,                                                           \
+		 &(b)->first,                                                          \
+		 offsetof(Config, last) + sizeof((a)->last) - offsetof(Config, first)) \
+		!= 0)
+
+unsigned Config_Diff(const Config *a, const Config *b) {
+	unsigned changed = 0;
+	if (strcmp(a->app_title, b->app_title) != 0) changed |= CONFIG_CHANGED_TITLE;
+	if (CONFIG_RANGE_DIFFERS(a, b, board_size, subgrid))
+		changed |= CONFIG_CHANGED_GRID;
+	if (CONFIG_RANGE_DIFFERS(a, b, window_w, window_h))
+		changed |= CONFIG_CHANGED_WINDOW;
+	if (CONFIG_RANGE_DIFFERS(a, b, tile_pix, topbar_h)
+		|| CONFIG_RANGE_DIFFERS(a, b, menu_start_y, color_keypad_cols)
+		|| CONFIG_RANGE_DIFFERS(a, b, note_padding_x, note_grid_size))
+		changed |= CONFIG_CHANGED_LAYOUT;
+	if (CONFIG_RANGE_DIFFERS(a, b, font_size_title, font_size_note)
+		|| strcmp(a->font_path, b->font_path) != 0)
+		changed |= CONFIG_CHANGED_FONTS;
+	if (memcmp(&a->theme, &b->theme, sizeof(Theme)) != 0)
+		changed |= CONFIG_CHANGED_THEME;
+	if (CONFIG_RANGE_DIFFERS(a, b, repeat_delay_frames, repeat_rate_frames))
+		changed |= CONFIG_CHANGED_INPUT;
+	return changed;
+}
+
+void Config_SetDefaults(Config *cfg) {
+	*cfg = (Config) { .app_title = "sudoku",
 		.app_version = "0.1.1",
 		.board_size = 9,
 		.subgrid = 3,
@@ -379,12 +409,25 @@ void Config_Init(void) {
 				[CELL_COLOR_WHITE] = 0xFFFFFF80 } } };
 
 	/* calculate window dimensions with defaults */
-	g_config.window_w = g_config.board_pad * 2
-		+ g_config.tile_pix * g_config.board_size + g_config.sidebar_w;
-	g_config.window_h = g_config.board_pad * 2
-		+ g_config.tile_pix * g_config.board_size + g_config.topbar_h;
+	cfg->window_w
+		= cfg->board_pad * 2 + cfg->tile_pix * cfg->board_size + cfg->sidebar_w;
+	cfg->window_h
+		= cfg->board_pad * 2 + cfg->tile_pix * cfg->board_size + cfg->topbar_h;
+}
+
+bool Config_LoadCached(Config *cfg, const char *path) {
+	ConfigSnapshotKey key;
+	if (ConfigSnapshot_Load(cfg, path, &key)) return true;
 
-	if (!Config_Load(&g_config, "config.lua")) {
+	Config_SetDefaults(cfg);
+	if (!Config_Load(cfg, path)) return false;
+	ConfigSnapshot_Save(cfg, path, &key);
+	return true;
+}
+
+/* initialize config with defaults and load from file */
+void Config_Init(void) {
+	if (!Config_LoadCached(&g_config, "config.lua")) {
 		fprintf(stderr, "warning: failed to load config.lua, using defaults\n");
 	}
 }
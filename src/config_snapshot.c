@@ -0,0 +1,116 @@
+/* src/config_snapshot.c
+ * binary config snapshots
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config_snapshot.h"
+#include "mapped_file.h"
+
+#define SNAPSHOT_MAGIC "SDKCFG1"
+
+/* <script>.snap layout, native byte order like the puzzle indexes: this
+ * header, then the Config
+ */
+typedef struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t configSize;
+	uint64_t defaultsHash;
+	uint64_t size; /* of the script */
+	int64_t mtime;
+	uint64_t hash;
+} SnapshotHeader;
+
+/* fnv-1a */
+static uint64_t hash_bytes(const void *data, size_t size) {
+	const uint8_t *p = data;
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+/* a snapshot resolved against other defaults would hide their changes */
+static uint64_t defaults_hash(void) {
+	Config defaults;
+	Config_SetDefaults(&defaults);
+	return hash_bytes(&defaults, sizeof(defaults));
+}
+
+static SnapshotHeader header_for(const ConfigSnapshotKey *key) {
+	SnapshotHeader h = { .version = CONFIG_SNAPSHOT_VERSION,
+		.configSize = (uint32_t) sizeof(Config),
+		.defaultsHash = defaults_hash(),
+		.size = key->size,
+		.mtime = key->mtime,
+		.hash = key->hash };
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	return h;
+}
+
+static void snapshot_path(const char *path, char *out, size_t size) {
+	snprintf(out, size, "%s%s", path, CONFIG_SNAPSHOT_EXT);
+}
+
+static bool write_snapshot(const SnapshotHeader *h, const Config *cfg, const char *path) {
+	char snapPath[512], tmpPath[520];
+	snapshot_path(path, snapPath, sizeof(snapPath));
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", snapPath);
+
+	FILE *f = fopen(tmpPath, "wb");
+	if (!f) return false;
+	bool ok = fwrite(h, sizeof(*h), 1, f) == 1;
+	ok = ok && fwrite(cfg, sizeof(*cfg), 1, f) == 1;
+	ok = fclose(f) == 0 && ok;
+
+#ifdef _WIN32
+	/* rename does not replace an existing file there */
+	if (ok) remove(snapPath);
+#endif
+	/* an unwritable directory only costs running the script every start */
+	if (ok && rename(tmpPath, snapPath) == 0) return true;
+	remove(tmpPath);
+	return false;
+}
+
+bool ConfigSnapshot_Load(Config *cfg, const char *path, ConfigSnapshotKey *key) {
+	*key = (ConfigSnapshotKey) { 0 };
+	MappedFile script;
+	if (!MappedFile_Open(&script, path)) return false;
+	*key = (ConfigSnapshotKey) { .size = (uint64_t) script.size,
+		.mtime = (int64_t) script.mtime,
+		.hash = hash_bytes(script.data, script.size),
+		.valid = true };
+	MappedFile_Close(&script);
+
+	char snapPath[512];
+	snapshot_path(path, snapPath, sizeof(snapPath));
+	MappedFile snap;
+	if (!MappedFile_Open(&snap, snapPath)) return false;
+
+	SnapshotHeader want = header_for(key), h;
+	bool ok = snap.size == sizeof(h) + sizeof(Config);
+	if (ok) {
+		memcpy(&h, snap.data, sizeof(h));
+		ok = memcmp(h.magic, want.magic, sizeof(h.magic)) == 0
+			&& h.version == want.version && h.configSize == want.configSize
+			&& h.defaultsHash == want.defaultsHash && h.size == want.size
+			&& h.hash == want.hash;
+	}
+	if (ok) memcpy(cfg, snap.data + sizeof(h), sizeof(Config));
+	MappedFile_Close(&snap);
+
+	/* same contents under a new mtime, keep the stamp current */
+	if (ok && h.mtime != want.mtime) write_snapshot(&want, cfg, path);
+	return ok;
+}
+
+bool ConfigSnapshot_Save(
+	const Config *cfg, const char *path, const ConfigSnapshotKey *key) {
+	if (!key->valid) return false;
+	SnapshotHeader h = header_for(key);
+	return write_snapshot(&h, cfg, path);
+}
@@ -0,0 +1,119 @@
+/* src/config_watch.c
+ * background config.lua reloads
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "config_watch.h"
+
+typedef struct FileStamp {
+	long long mtime, size;
+	bool exists;
+} FileStamp;
+
+static FileStamp stamp_of(const char *path) {
+	struct stat st;
+	if (stat(path, &st) != 0) return (FileStamp) { 0 };
+	return (FileStamp) { (long long) st.st_mtime, (long long) st.st_size, true };
+}
+
+static bool same_stamp(FileStamp a, FileStamp b) {
+	return a.exists == b.exists && a.mtime == b.mtime && a.size == b.size;
+}
+
+/* sleep one interval, false if told to stop meanwhile */
+static bool wait_interval(ConfigWatch *w) {
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	long ns = until.tv_nsec + (long) (CONFIG_WATCH_INTERVAL * 1e9);
+	until.tv_sec += ns / 1000000000L;
+	until.tv_nsec = ns % 1000000000L;
+
+	pthread_mutex_lock(&w->lock);
+	while (!w->stop && pthread_cond_timedwait(&w->wake, &w->lock, &until) == 0)
+		;
+	bool stop = w->stop;
+	pthread_mutex_unlock(&w->lock);
+	return !stop;
+}
+
+static void *watch_worker(void *arg) {
+	ConfigWatch *w = arg;
+	FileStamp loaded = stamp_of(w->path), seen = loaded;
+
+	while (wait_interval(w)) {
+		FileStamp now = stamp_of(w->path);
+		bool settled = same_stamp(now, seen);
+		seen = now;
+		if (!settled || !now.exists || same_stamp(now, loaded)) continue;
+		loaded = now;
+
+		/* leaves a fresh snapshot behind for the next start */
+		Config next;
+		if (!Config_LoadCached(&next, w->path)) continue;
+
+		pthread_mutex_lock(&w->lock);
+		w->pending = next;
+		w->hasPending = true;
+		pthread_mutex_unlock(&w->lock);
+		if (w->notify) w->notify();
+	}
+	return NULL;
+}
+
+bool ConfigWatch_Start(ConfigWatch *w, const char *path, void (*notify)(void)) {
+	*w = (ConfigWatch) { .notify = notify };
+	snprintf(w->path, sizeof(w->path), "%s", path);
+
+	if (pthread_mutex_init(&w->lock, NULL) != 0) return false;
+	if (pthread_cond_init(&w->wake, NULL) != 0) {
+		pthread_mutex_destroy(&w->lock);
+		return false;
+	}
+	if (pthread_create(&w->thread, NULL, watch_worker, w) != 0) {
+		pthread_cond_destroy(&w->wake);
+		pthread_mutex_destroy(&w->lock);
+		return false;
+	}
+	w->running = true;
+	return true;
+}
+
+void ConfigWatch_Stop(ConfigWatch *w) {
+	if (!w->running) return;
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = true;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+	pthread_cond_destroy(&w->wake);
+	pthread_mutex_destroy(&w->lock);
+	w->running = false;
+}
+
+bool ConfigWatch_Poll(ConfigWatch *w, Config *out) {
+	if (!w->running) return false;
+
+	pthread_mutex_lock(&w->lock);
+	bool has = w->hasPending;
+	if (has) *out = w->pending;
+	w->hasPending = false;
+	pthread_mutex_unlock(&w->lock);
+	return has;
+}
+
+bool ConfigWatch_Pending(ConfigWatch *w) {
+	if (!w->running) return false;
+
+	pthread_mutex_lock(&w->lock);
+	bool has = w->hasPending;
+	pthread_mutex_unlock(&w->lock);
+	return has;
+}
@@ -2,6 +2,7 @@
  * core game logic
  */
 
+#include <stdio.h>
 #include <string.h>
 
 #include "raylib.h"
@@ -10,6 +11,12 @@
 #include "ui.h"
 #include "input.h"
 #include "puzzle_loader.h"
+#include "profiler.h"
+
+/* raylib links glfw in without wrapping this one. it is safe from any thread
+ * and makes the event wait of an idle loop return
+ */
+void glfwPostEmptyEvent(void);
 
 /* timer logic for pause/play */
 static void Game_UpdateTimer(Game *g) {
@@ -32,6 +39,22 @@ static void Game_UpdateTimer(Game *g) {
 	}
 }
 
+bool Game_ClockRunning(const Game *g) {
+	if (g->screen == SCREEN_REPLAYS && g->replayOpen && g->replayPlaying) return true;
+	return g->screen == SCREEN_PLAY && !g->paused && !Board_IsComplete(&g->board);
+}
+
+bool Game_Busy(const Game *g) {
+	bool checking = g->screen == SCREEN_LOAD_PUZZLE
+		&& PuzzleCheck_Running(&g->collectionCheck);
+	return PuzzleScan_Running(&g->puzzleScan) || checking;
+}
+
+bool Game_Watching(Game *g) {
+	if (ConfigWatch_Pending(&g->configWatch)) return true;
+	return g->screen == SCREEN_LOAD_PUZZLE && g->puzzleWatch.active;
+}
+
 void Game_Init(Game *g) {
 	*g = (Game) { 0 };
 	g->theme = Theme_Default();
@@ -40,6 +63,7 @@ void Game_Init(Game *g) {
 	g->selCol = 0;
 	g->inputMode = INPUT_MODE_INSERT;
 	g->highlightConflicts = true;
+	g->autoNotes = false;
 	g->selectedColorIndex = 0;
 	strcpy(g->puzzleTitle, "Sudoku");
 
@@ -54,40 +78,364 @@ void Game_Init(Game *g) {
 	g->menuSelection = 0;
 	g->difficultySelection = 0;
 	g->loadPuzzleSelection = 0;
+	g->loadPuzzleScroll = 0;
+	g->puzzleFilter[0] = '\0';
 	g->puzzleListInitialized = false;
-	g->puzzleList.count = 0;
 
 	/* settings state */
 	g->settingsSelection = 0;
 	g->tempConfig = g_config;
 	g->settingsNeedApply = false;
 
+	if (!ConfigWatch_Start(&g->configWatch, "config.lua", glfwPostEmptyEvent))
+		fprintf(stderr, "warning: not watching config.lua for changes\n");
+	Mod_Init(&g->mods, MOD_DIRECTORY);
+
 	Board_Clear(&g->board);
+	History_Clear(&g->history);
+	Game_OnBoardChanged(g);
+
+	/* pick up where the last run left off, paused */
+	AutosaveGame saved;
+	if (Autosave_Load(&saved)) {
+		g->board = saved.puzzle.board;
+		Game_OnBoardChanged(g);
+		const char *title = saved.puzzle.meta.title;
+		snprintf(g->puzzleTitle, sizeof(g->puzzleTitle), "%s", title);
+		g->autoNotes = saved.autoNotes;
+		g->elapsedSeconds = saved.elapsedSeconds;
+		g->startTime = GetTime() - saved.elapsedSeconds;
+		g->paused = true;
+		g->screen = SCREEN_PLAY;
+	}
+	if (!Autosave_Start(&g->autosave))
+		fprintf(stderr, "warning: games will not be autosaved\n");
+}
+
+bool Game_OpenCollection(Game *g, const char *filepath) {
+	PuzzleCollection c;
+	if (!PuzzleCollection_Open(&c, filepath)) return false;
+	if (c.count < 2) {
+		PuzzleCollection_Close(&c);
+		return false;
+	}
+
+	Game_CloseCollection(g);
+	g->collection = c;
+	g->collectionSelection = 0;
+	g->collectionScroll = 0;
+	g->collectionJump[0] = '\0';
+
+	/* only now, the workers keep a pointer to g->collection */
+	PuzzleCheck_Start(&g->collectionCheck, &g->collection);
+	return true;
+}
+
+bool Game_CloseCollection(Game *g) {
+	if (g->collection.count == 0) return false;
+	PuzzleCheck_Cancel(&g->collectionCheck);
+	PuzzleCollection_Close(&g->collection);
+	return true;
+}
+
+bool Game_OpenReplay(Game *g, int i) {
+	char path[MAX_FILEPATH_LEN];
+	snprintf(path, sizeof(path), "%s/%s", REPLAY_DIRECTORY, g->replayNames[i]);
+	Replay r;
+	if (!Replay_Load(&r, path)) return false;
+
+	Game_CloseReplay(g);
+	g->replayShown = r;
+	g->replayOpen = true;
+	g->replayDuration = Replay_Duration(&g->replayShown);
+	g->replayPlaying = false;
+	/* the player keeps a pointer to replayShown, so only now */
+	ReplayPlayer_Init(&g->replayPlayer, &g->replayShown);
+	g->replayViewNext = -1;
+	Game_SyncReplay(g);
+	return true;
+}
+
+void Game_SyncReplay(Game *g) {
+	if (g->replayPlayer.next == g->replayViewNext) return;
+	g->replayViewNext = g->replayPlayer.next;
+	const Board *b = &g->replayPlayer.state.board;
+	Board_FindConflicts(b, &g->replayConflicts, g->replayNoteConflicts);
+	g->replayVersion++;
+}
+
+bool Game_CloseReplay(Game *g) {
+	if (!g->replayOpen) return false;
+	Replay_Free(&g->replayShown);
+	g->replayOpen = false;
+	g->replayPlaying = false;
+	return true;
+}
+
+void Game_Shutdown(Game *g) {
+	/* a clean exit leaves just a snapshot behind */
+	Autosave_Record(&g->autosave, &g->board, g->elapsedSeconds, g->autoNotes);
+	Autosave_Checkpoint(&g->autosave, g->elapsedSeconds);
+	Autosave_Stop(&g->autosave);
+	ReplayRecorder_End(&g->replay, REPLAY_DIRECTORY);
+	ConfigWatch_Stop(&g->configWatch);
+	/* the collection check solves under the mods' rules until it is joined */
+	Game_CloseCollection(g);
+	Mod_Shutdown(&g->mods);
+	PuzzleScan_Cancel(&g->puzzleScan);
+	PuzzleWatch_Stop(&g->puzzleWatch);
+	PuzzleFileList_Free(&g->puzzleList);
+	Game_CloseReplay(g);
+}
+
+void Game_OnBoardChanged(Game *g) {
+	Board_FindConflicts(&g->board, &g->conflicts, g->noteConflicts);
+	g->boardVersion++;
+}
+
+/* empty (r, c) as one history entry; in auto notes mode the removed digit's
+ * candidates come back to the cell and its peers
+ */
+static bool clear_cell(Game *g, int r, int c, bool linked) {
+	Board *b = &g->board;
+	int old = Board_Value(b, r, c);
+
+	HistoryEntry e = History_Begin(b, r, c, old);
+	Board_Set(b, r, c, 0, false);
+	Board_SetNotes(b, r, c, 0);
+	if (g->autoNotes && old) Board_RestoreCandidates(b, r, c, old);
+	return History_End(&g->history, b, e, old, linked);
+}
+
+void Game_SetDigit(Game *g, int v) {
+	Board *b = &g->board;
+	int r = g->selRow, c = g->selCol;
+	if (Board_IsGiven(b, r, c)) return;
+	if (!Mod_ValidateMove(&g->mods, b, r, c, v)) return;
+
+	/* replacing a digit in auto notes mode restores the old one's candidates
+	 * first, the two entries are undone together
+	 */
+	int old = Board_Value(b, r, c);
+	bool linked = false;
+	if (g->autoNotes && old && old != v) linked = clear_cell(g, r, c, false);
+
+	HistoryEntry e = History_Begin(b, r, c, v);
+	Board_Set(b, r, c, v, false);
+	Board_SetNotes(b, r, c, 0);
+	/* auto-remove notes from affected cells */
+	Board_ClearNotesAffectedBy(b, r, c, v);
+	History_End(&g->history, b, e, v, linked);
+
+	ReplayRecorder_Move(&g->replay, REPLAY_DIGIT, r, c, v, b, GetTime());
+	Game_OnBoardChanged(g);
+	Mod_OnMove(&g->mods, b, r, c, v, old);
+}
+
+void Game_ToggleNote(Game *g, int v) {
+	Board *b = &g->board;
+	int r = g->selRow, c = g->selCol;
+	if (Board_IsGiven(b, r, c)) return;
+
+	HistoryEntry e = History_Begin(b, r, c, 0);
+	Board_ToggleNote(b, r, c, v);
+	History_End(&g->history, b, e, 0, false);
+
+	ReplayRecorder_Move(&g->replay, REPLAY_NOTE, r, c, v, b, GetTime());
+	Game_OnBoardChanged(g);
+}
+
+void Game_ClearCell(Game *g) {
+	int r = g->selRow, c = g->selCol;
+	if (Board_IsGiven(&g->board, r, c)) return;
+
+	int old = Board_Value(&g->board, r, c);
+	clear_cell(g, r, c, false);
+	ReplayRecorder_Move(&g->replay, REPLAY_CLEAR, r, c, 0, &g->board, GetTime());
+	Game_OnBoardChanged(g);
+	if (old) Mod_OnMove(&g->mods, &g->board, r, c, 0, old);
+}
+
+/* fill in one pass, recorded as one linked move of every touched cell */
+static void fill_candidates(Game *g) {
+	Board *b = &g->board;
+	Board before = *b;
+	Board_FillCandidates(b);
+
+	bool linked = false;
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			HistoryEntry e = History_Begin(&before, r, c, 0);
+			if (History_End(&g->history, b, e, 0, linked)) linked = true;
+		}
+
+	Game_OnBoardChanged(g);
+}
+
+void Game_ToggleAutoNotes(Game *g) {
+	g->autoNotes = !g->autoNotes;
+	if (g->autoNotes) fill_candidates(g);
+
+	int r = g->selRow, c = g->selCol;
+	ReplayRecorder_Move(&g->replay,
+		REPLAY_AUTO_NOTES,
+		r,
+		c,
+		g->autoNotes,
+		&g->board,
+		GetTime());
+}
+
+void Game_OnNewPuzzle(Game *g) {
+	Autosave_End(&g->autosave);
+	ReplayRecorder_End(&g->replay, REPLAY_DIRECTORY);
+	History_Clear(&g->history);
+	if (g->autoNotes) Board_FillCandidates(&g->board);
+	Game_OnBoardChanged(g);
+}
+
+void Game_SetColor(Game *g, int color) {
+	Board *b = &g->board;
+	HistoryEntry e = History_Begin(b, g->selRow, g->selCol, 0);
+	Board_SetColor(b, g->selRow, g->selCol, color);
+	History_End(&g->history, b, e, 0, false);
+
+	int r = g->selRow, c = g->selCol;
+	ReplayRecorder_Move(&g->replay, REPLAY_COLOR, r, c, color, b, GetTime());
+	Game_OnBoardChanged(g);
+}
+
+/* undo and redo are recorded with the cells they touched */
+static void record_step(Game *g, ReplayEventKind kind) {
+	int r = g->selRow, c = g->selCol;
+	ReplayRecorder_Move(&g->replay, kind, r, c, 0, &g->board, GetTime());
+	Game_OnBoardChanged(g);
+}
+
+void Game_Undo(Game *g) {
+	if (History_Undo(&g->history, &g->board)) record_step(g, REPLAY_UNDO);
+}
+
+void Game_Redo(Game *g) {
+	if (History_Redo(&g->history, &g->board)) record_step(g, REPLAY_REDO);
+}
+
+/* moves are recorded as they happen, selection and pause once a frame. a
+ * replay runs from a new (or resumed) puzzle until it is solved or replaced
+ */
+static void Game_UpdateReplay(Game *g) {
+	ReplayRecorder *rec = &g->replay;
+	bool solved = Board_IsComplete(&g->board);
+	if (rec->recording) {
+		ReplayRecorder_Poll(rec, g->selRow, g->selCol, g->paused, GetTime());
+		if (solved) ReplayRecorder_End(rec, REPLAY_DIRECTORY);
+		return;
+	}
+	if (solved) return;
+
+	ReplayState start = { .board = g->board,
+		.selRow = g->selRow,
+		.selCol = g->selCol,
+		.paused = g->paused,
+		.autoNotes = g->autoNotes };
+	ReplayRecorder_Begin(rec, &start, g->puzzleTitle, GetTime());
+}
+
+/* keep the save in step with the board, a new puzzle starts a new save and
+ * a solved one needs none
+ */
+static void Game_UpdateAutosave(Game *g) {
+	Autosave *a = &g->autosave;
+	if (Board_IsComplete(&g->board)) {
+		Autosave_Discard(a);
+		return;
+	}
+	if (a->active) {
+		Autosave_Record(a, &g->board, g->elapsedSeconds, g->autoNotes);
+		return;
+	}
+
+	AutosaveGame save = { .elapsedSeconds = g->elapsedSeconds,
+		.autoNotes = g->autoNotes };
+	save.puzzle.board = g->board;
+	snprintf(save.puzzle.meta.title, MAX_PUZZLE_TITLE, "%s", g->puzzleTitle);
+	snprintf(save.puzzle.meta.author, MAX_PUZZLE_AUTHOR, "unknown");
+	Autosave_Begin(a, &save);
+}
+
+void Game_ApplyConfig(Game *g, const Config *next) {
+	Config cfg = *next;
+	unsigned changed = Config_Diff(&g_config, &cfg);
+
+	/* boards, histories and collections are all sized at startup */
+	if (changed & CONFIG_CHANGED_GRID) {
+		fprintf(stderr, "config: board size changes apply after a restart\n");
+		cfg.board_size = g_config.board_size;
+		cfg.subgrid = g_config.subgrid;
+		int boardPix = cfg.tile_pix * cfg.board_size;
+		cfg.window_w = cfg.board_pad * 2 + boardPix + cfg.sidebar_w;
+		cfg.window_h = cfg.board_pad * 2 + boardPix + cfg.topbar_h;
+		changed = Config_Diff(&g_config, &cfg);
+	}
+	if (!changed) return;
+
+	g_config = cfg;
+	if (changed & CONFIG_CHANGED_THEME) g->theme = Theme_Default();
+	if (changed & CONFIG_CHANGED_WINDOW) SetWindowSize(WINDOW_W, WINDOW_H);
+	if (changed & CONFIG_CHANGED_TITLE) SetWindowTitle(APP_TITLE);
+	if (g->screen != SCREEN_SETTINGS) g->tempConfig = g_config;
+
+	/* the layout and text caches catch up in Layout_Refresh */
 }
 
 void Game_Update(Game *g) {
+	Mod_FrameBegin(&g->mods);
+
+	Config reloaded;
+	if (ConfigWatch_Poll(&g->configWatch, &reloaded)) Game_ApplyConfig(g, &reloaded);
+	Layout_Refresh(&g->theme);
+
+	/* a scan cut short left the list partial, rescan on the next visit */
+	if (g->screen != SCREEN_LOAD_PUZZLE && PuzzleScan_Running(&g->puzzleScan)) {
+		PuzzleScan_Cancel(&g->puzzleScan);
+		g->puzzleListInitialized = false;
+	}
+
 	/* handle input for play screen */
 	if (g->screen == SCREEN_PLAY) {
+		PROFILE_BEGIN(PROF_TIMER);
 		Game_UpdateTimer(g);
+		PROFILE_END(PROF_TIMER);
+
+		PROFILE_BEGIN(PROF_INPUT);
 		Input_Update(g);
+		PROFILE_END(PROF_INPUT);
+
+		Game_UpdateAutosave(g);
+		Game_UpdateReplay(g);
+
+		if (!g->paused) Mod_DrawOverlay(&g->mods, &g->board, g->selRow, g->selCol);
 		return;
 	}
 
 	/* all menu screens share the same rendering setup */
-	ClearBackground(ColorFromUInt(g->theme.bg));
+	ClearBackground(g_layout.colors.bg);
 	UI_DrawTopBar(g);
 
 	switch (g->screen) {
 	case SCREEN_MENU:
 		UI_DrawCenteredText("sudoku", 120);
-		const char *items[] = { "play random", "load puzzle", "settings", "quit" };
-		int hit = UI_Menu(items, 4, &g->menuSelection);
+		const char *items[]
+			= { "play random", "load puzzle", "replays", "settings", "quit" };
+		int hit = UI_Menu(items, 5, &g->menuSelection);
 		if (hit >= 0) {
 			const AppScreen screens[] = { SCREEN_DIFFICULTY,
 				SCREEN_LOAD_PUZZLE,
+				SCREEN_REPLAYS,
 				SCREEN_SETTINGS,
 				SCREEN_QUIT };
 			g->screen = screens[hit];
+			if (g->screen == SCREEN_REPLAYS) g->replayListInitialized = false;
 
 			/* initialize settings when entering settings screen */
 			if (g->screen == SCREEN_SETTINGS) {
@@ -106,6 +454,9 @@ void Game_Update(Game *g) {
 	case SCREEN_SETTINGS:
 		UI_DrawSettingsMenu(g);
 		break;
+	case SCREEN_REPLAYS:
+		UI_DrawReplayMenu(g);
+		break;
 	default:
 		break;
 	}
@@ -116,12 +467,12 @@ void Game_Draw(const Game *g) {
 
 	switch (g->screen) {
 	case SCREEN_PLAY:
-		ClearBackground(ColorFromUInt(g->theme.bg));
+		ClearBackground(g_layout.colors.bg);
 		UI_DrawTopBar(g);
 		UI_DrawBoard(g);
 		break;
 	case SCREEN_QUIT:
-		ClearBackground(ColorFromUInt(g->theme.bg));
+		ClearBackground(g_layout.colors.bg);
 		UI_DrawTopBar(g);
 		UI_DrawCenteredText("goodbye!", WINDOW_H / 2 - 18);
 		break;
@@ -129,16 +480,27 @@ void Game_Draw(const Game *g) {
 		break;
 	}
 
+#ifdef PROFILER_ENABLED
+	if (g_profiler.visible) UI_DrawProfiler();
+#endif
+
+	PROFILE_BEGIN(PROF_PRESENT);
 	EndDrawing();
+	PROFILE_END(PROF_PRESENT);
 }
 
 bool Game_LoadPuzzleFile(Game *g, const char *filepath) {
 	Puzzle puzzle;
 	if (!Puzzle_LoadFromFile(&puzzle, filepath)) return false;
+	Game_LoadPuzzle(g, &puzzle);
+	return true;
+}
 
+void Game_LoadPuzzle(Game *g, const Puzzle *puzzle) {
 	/* load board and puzzle */
-	g->board = puzzle.board;
-	strncpy(g->puzzleTitle, puzzle.meta.title, MAX_PUZZLE_TITLE_GAME - 1);
+	g->board = puzzle->board;
+	Game_OnNewPuzzle(g);
+	strncpy(g->puzzleTitle, puzzle->meta.title, MAX_PUZZLE_TITLE_GAME - 1);
 	g->puzzleTitle[MAX_PUZZLE_TITLE_GAME - 1] = '\0';
 
 	/* reset game state */
@@ -153,6 +515,4 @@ bool Game_LoadPuzzleFile(Game *g, const char *filepath) {
 	g->elapsedSeconds = 0;
 	g->startTime = 0.0;
 	g->pauseTime = 0.0;
-
-	return true;
 }
@@ -1,6 +1,9 @@
 /* src/generator.c
  * puzzle generation
  * uses knuth's algorithm x and dlx for generating valid solved boards
+ *
+ * the solver and generator are instantiated per board size from
+ * generator_impl.h, the public api dispatches on the requested size
  */
 
 #include <stdlib.h>
@@ -9,10 +12,7 @@
 
 #include "generator.h"
 #include "config.h"
-
-static inline int get_box_id(int row, int col) {
-	return (row / SUBGRID) * SUBGRID + (col / SUBGRID);
-}
+#include "rules.h"
 
 void Generator_Seed(unsigned int seed) {
 	srand(seed ? seed : (unsigned int) time(NULL));
@@ -36,9 +36,6 @@ typedef struct DLXRoot {
 	int num_columns, node_idx;
 } DLXRoot;
 
-#define DLX_COLUMNS 324
-#define DLX_MAX_NODES (BOARD_SIZE * BOARD_SIZE * BOARD_SIZE * 4)
-
 static void DLX_Cover(DLXColumn *col) {
 	col->header.right->left = col->header.left;
 	col->header.left->right = col->header.right;
@@ -63,7 +60,7 @@ static void DLX_Uncover(DLXColumn *col) {
 
 static DLXColumn *DLX_ChooseColumnMRV(DLXRoot *dlx) {
 	DLXColumn *best = NULL;
-	int min_size = BOARD_SIZE + 1;
+	int min_size = GENERATOR_SIZE_MAX + 1;
 	for (DLXNode *node = dlx->columns[0].header.right; node != &dlx->columns[0].header;
 		node = node->right) {
 		DLXColumn *col = node->column;
@@ -76,19 +73,16 @@ static DLXColumn *DLX_ChooseColumnMRV(DLXRoot *dlx) {
 	return best;
 }
 
-/* encode sudoku constraints: cell, row, col, box */
-static void encode_constraints(int row, int col, int val, int c[4]) {
-	c[0] = row * BOARD_SIZE + col;
-	c[1] = 81 + row * BOARD_SIZE + (val - 1);
-	c[2] = 162 + col * BOARD_SIZE + (val - 1);
-	c[3] = 243 + get_box_id(row, col) * BOARD_SIZE + (val - 1);
-}
-
-static void DLX_Init(DLXRoot *dlx) {
-	dlx->num_columns = DLX_COLUMNS;
+static bool DLX_Init(DLXRoot *dlx, int num_columns, int max_nodes) {
+	dlx->num_columns = num_columns;
 	dlx->node_idx = 0;
-	dlx->columns = malloc((DLX_COLUMNS + 1) * sizeof(DLXColumn));
-	dlx->nodes = malloc(DLX_MAX_NODES * sizeof(DLXNode));
+	dlx->columns = malloc((num_columns + 1) * sizeof(DLXColumn));
+	dlx->nodes = malloc(max_nodes * sizeof(DLXNode));
+	if (!dlx->columns || !dlx->nodes) {
+		free(dlx->columns);
+		free(dlx->nodes);
+		return false;
+	}
 
 	DLXColumn *root = &dlx->columns[0];
 	root->header.left = root->header.right = &root->header;
@@ -96,7 +90,7 @@ static void DLX_Init(DLXRoot *dlx) {
 	root->header.column = NULL;
 	root->header.row_id = root->size = root->id = -1;
 
-	for (int i = 1; i <= DLX_COLUMNS; i++) {
+	for (int i = 1; i <= num_columns; i++) {
 		DLXColumn *col = &dlx->columns[i];
 		col->size = 0;
 		col->id = i - 1;
@@ -108,6 +102,12 @@ static void DLX_Init(DLXRoot *dlx) {
 		root->header.left->right = &col->header;
 		root->header.left = &col->header;
 	}
+	return true;
+}
+
+static void DLX_Free(DLXRoot *dlx) {
+	free(dlx->columns);
+	free(dlx->nodes);
 }
 
 static void DLX_AddRow(DLXRoot *dlx, int row_id, int constraints[4]) {
@@ -136,26 +136,13 @@ static void DLX_AddRow(DLXRoot *dlx, int row_id, int constraints[4]) {
 	}
 }
 
-static void DLX_BuildFromBoard(DLXRoot *dlx, const Board *b) {
-	DLX_Init(dlx);
-	for (int r = 0; r < BOARD_SIZE; r++)
-		for (int c = 0; c < BOARD_SIZE; c++) {
-			uint8_t fixed = b->cells[r][c].value;
-			for (int v = (fixed ? fixed : 1); v <= (fixed ? fixed : 9); v++) {
-				int constraints[4];
-				encode_constraints(r, c, v, constraints);
-				DLX_AddRow(dlx, r * 81 + c * 9 + v - 1, constraints);
-			}
-		}
-}
-
-static bool DLX_SolveRandom(DLXRoot *dlx, int sol[BOARD_SIZE * BOARD_SIZE * BOARD_SIZE]) {
+static bool DLX_SolveRandom(DLXRoot *dlx, uint8_t *sol) {
 	if (dlx->columns[0].header.right == &dlx->columns[0].header) return true;
 	DLXColumn *col = DLX_ChooseColumnMRV(dlx);
 	if (!col || col->size == 0) return false;
 	DLX_Cover(col);
 
-	DLXNode *rows[9];
+	DLXNode *rows[GENERATOR_SIZE_MAX];
 	int cnt = 0;
 	for (DLXNode *row = col->header.down; row != &col->header; row = row->down)
 		rows[cnt++] = row;
@@ -185,201 +172,191 @@ static bool DLX_SolveRandom(DLXRoot *dlx, int sol[BOARD_SIZE * BOARD_SIZE * BOAR
 	return found;
 }
 
-bool Generator_FillGrid(Board *b) {
-	Board_Clear(b);
+/* transposition table: board hash -> solution count
+ * direct mapped, shared by every thread without locks. each slot holds the
+ * payload and hash ^ payload, so a torn or overwritten slot fails the check
+ * and is just a miss
+ */
+#define TT_BITS 16
+#define TT_SIZE (1u << TT_BITS)
+#define TT_VALID (1ull << 32)
+
+typedef struct TTEntry {
+	uint64_t check; /* hash ^ data */
+	uint64_t data; /* TT_VALID | max_solutions << 16 | count */
+} TTEntry;
+
+static TTEntry tt[TT_SIZE];
+
+static bool tt_probe(uint64_t hash, int max_solutions, int *count) {
+	TTEntry *e = &tt[hash & (TT_SIZE - 1)];
+	uint64_t check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+	if (!(data & TT_VALID) || (check ^ data) != hash) return false;
+
+	int stored = (int) (data & 0xFFFF);
+	int stored_max = (int) ((data >> 16) & 0xFFFF);
+
+	/* below its cap the stored count is exact, at the cap it's a lower bound */
+	if (stored < stored_max) {
+		*count = stored < max_solutions ? stored : max_solutions;
+		return true;
+	}
+	if (max_solutions <= stored_max) {
+		*count = max_solutions;
+		return true;
+	}
+	return false;
+}
 
-	DLXRoot dlx;
-	DLX_BuildFromBoard(&dlx, b);
-	int solution[729] = { 0 };
-	bool success = DLX_SolveRandom(&dlx, solution);
+static void tt_store(uint64_t hash, int max_solutions, int count) {
+	if (max_solutions > 0xFFFF) return;
+	TTEntry *e = &tt[hash & (TT_SIZE - 1)];
+	uint64_t data = TT_VALID | (uint64_t) max_solutions << 16 | (uint64_t) count;
+	__atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->check, hash ^ data, __ATOMIC_RELAXED);
+}
 
-	if (success)
-		for (int i = 0; i < 729; i++)
-			if (solution[i]) {
-				b->cells[i / 81][(i / 9) % 9].value = i % 9 + 1;
-				b->cells[i / 81][(i / 9) % 9].given = true;
-			}
+/* cells solve_random may try per attempt at a rule-bound fill, and attempts */
+#define GEN_RANDOM_NODES (1l << 14)
+#define GEN_RANDOM_RESTARTS 1024
 
-	free(dlx.columns);
-	free(dlx.nodes);
-	return success;
+/* search nodes one uniqueness check of a puzzle being dug out may take. an
+ * easy 9x9 check takes well under a hundred, a 25x25 one can take forever
+ */
+#define GEN_CHECK_NODES (1l << 16)
+
+/* size specialisations, 16x16 and up need 32-bit digit masks */
+#define GEN_N 4
+#define GEN_BOX 2
+#define GEN_MASK uint16_t
+#include "generator_impl.h"
+
+#define GEN_N 9
+#define GEN_BOX 3
+#define GEN_MASK uint16_t
+#include "generator_impl.h"
+
+#define GEN_N 16
+#define GEN_BOX 4
+#define GEN_MASK uint32_t
+#include "generator_impl.h"
+
+#define GEN_N 25
+#define GEN_BOX 5
+#define GEN_MASK uint32_t
+#include "generator_impl.h"
+
+bool Generator_SupportsSize(int size) {
+	return size == 4 || size == 9 || size == 16 || size == 25;
 }
 
-/* fast backtracking solver via bitmasking */
-typedef struct {
-	uint8_t grid[9][9];
-	uint16_t row_mask[9], col_mask[9], box_mask[9];
-	int solution_count, max_solutions;
-} FastSolver;
-
-static void FastSolver_Init(FastSolver *fs, const Board *b) {
-	memset(fs->row_mask, 0, sizeof(fs->row_mask));
-	memset(fs->col_mask, 0, sizeof(fs->col_mask));
-	memset(fs->box_mask, 0, sizeof(fs->box_mask));
-	fs->solution_count = 0;
-	for (int r = 0; r < 9; r++)
-		for (int c = 0; c < 9; c++) {
-			int v = b->cells[r][c].value;
-			fs->grid[r][c] = v;
-			if (v > 0) {
-				int bit = 1 << (v - 1);
-				fs->row_mask[r] |= bit;
-				fs->col_mask[c] |= bit;
-				fs->box_mask[get_box_id(r, c)] |= bit;
-			}
-		}
+/* the variant rules in play if they were built for this size */
+static const RuleSet *rules_for(int size) {
+	const RuleSet *rules = Rules_Active();
+	return rules && rules->size == size ? rules : NULL;
 }
 
-static inline uint16_t get_candidates(FastSolver *fs, int r, int c) {
-	return fs->grid[r][c]
-		? 0
-		: ~(fs->row_mask[r] | fs->col_mask[c] | fs->box_mask[get_box_id(r, c)])
-			& 0x1FF;
+bool Generator_FillGridN(uint8_t *grid, int size) {
+	const RuleSet *rules = rules_for(size);
+	switch (size) {
+	case 4:
+		return fill_4(grid, rules);
+	case 9:
+		return fill_9(grid, rules);
+	case 16:
+		return fill_16(grid, rules);
+	case 25:
+		return fill_25(grid, rules);
+	default:
+		return false;
+	}
 }
 
-static bool find_mrv(FastSolver *fs, int *r, int *c, uint16_t *cand) {
-	int min_cnt = 10, br = -1, bc = -1;
-	uint16_t bcand = 0;
-	for (int rr = 0; rr < 9; rr++)
-		for (int cc = 0; cc < 9; cc++)
-			if (!fs->grid[rr][cc]) {
-				uint16_t candidates = get_candidates(fs, rr, cc);
-				int cnt = __builtin_popcount(candidates);
-				if (cnt == 0) return false;
-				if (cnt < min_cnt) {
-					min_cnt = cnt;
-					br = rr;
-					bc = cc;
-					bcand = candidates;
-					if (cnt == 1) {
-						*r = br;
-						*c = bc;
-						*cand = bcand;
-						return true;
-					}
-				}
-			}
-	if (br == -1) return false;
-	*r = br;
-	*c = bc;
-	*cand = bcand;
-	return true;
+static uint64_t grid_hash(const uint8_t *grid, int size) {
+	uint64_t hash = 0;
+	for (int i = 0; i < size * size; i++)
+		if (grid[i]) hash ^= Board_ZobristKey(i, grid[i]);
+	return hash;
 }
 
-static void solve_fast(FastSolver *fs) {
-	if (fs->solution_count >= fs->max_solutions) return;
-	int r = -1, c = -1;
-	uint16_t cand;
-	if (!find_mrv(fs, &r, &c, &cand)) {
-		if (r == -1) fs->solution_count++;
-		return;
+static int count_solutions_n(
+	const uint8_t *grid, int size, uint64_t hash, int max_solutions) {
+	const RuleSet *rules = rules_for(size);
+	switch (size) {
+	case 4:
+		return count_solutions_4(grid, hash, max_solutions, rules, 0);
+	case 9:
+		return count_solutions_9(grid, hash, max_solutions, rules, 0);
+	case 16:
+		return count_solutions_16(grid, hash, max_solutions, rules, 0);
+	case 25:
+		return count_solutions_25(grid, hash, max_solutions, rules, 0);
+	default:
+		return 0;
 	}
-	int box = get_box_id(r, c);
-	for (int v = 1; v <= 9; v++)
-		if (cand & (1 << (v - 1))) {
-			int bit = 1 << (v - 1);
-			fs->grid[r][c] = v;
-			fs->row_mask[r] |= bit;
-			fs->col_mask[c] |= bit;
-			fs->box_mask[box] |= bit;
-			solve_fast(fs);
-			fs->grid[r][c] = 0;
-			fs->row_mask[r] &= ~bit;
-			fs->col_mask[c] &= ~bit;
-			fs->box_mask[box] &= ~bit;
-			if (fs->solution_count >= fs->max_solutions) return;
-		}
+}
+
+int Generator_CountSolutionsN(const uint8_t *grid, int size, int max_solutions) {
+	return count_solutions_n(grid, size, grid_hash(grid, size), max_solutions);
+}
+
+GeneratorResult Generator_CreatePuzzleN(
+	uint8_t *grid, int size, Difficulty difficulty, GeneratorFlags flags) {
+	const RuleSet *rules = rules_for(size);
+	switch (size) {
+	case 4:
+		return create_puzzle_4(grid, difficulty, flags, rules);
+	case 9:
+		return create_puzzle_9(grid, difficulty, flags, rules);
+	case 16:
+		return create_puzzle_16(grid, difficulty, flags, rules);
+	case 25:
+		return create_puzzle_25(grid, difficulty, flags, rules);
+	default:
+		return (GeneratorResult) { 0 };
+	}
+}
+
+/* board wrappers, the board holds sizes up to BOARD_SIZE_MAX */
+static void board_to_grid(const Board *b, uint8_t *grid) {
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++)
+			grid[r * BOARD_SIZE + c] = (uint8_t) Board_Value(b, r, c);
+}
+
+static void grid_to_board(const uint8_t *grid, Board *b) {
+	Board_Clear(b);
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++)
+			if (grid[r * BOARD_SIZE + c])
+				Board_Set(b, r, c, grid[r * BOARD_SIZE + c], true);
+}
+
+bool Generator_FillGrid(Board *b) {
+	uint8_t grid[BOARD_CELLS_MAX] = { 0 };
+	bool success = Generator_FillGridN(grid, BOARD_SIZE);
+	grid_to_board(grid, b);
+	return success;
 }
 
 int Generator_CountSolutions(const Board *b, int max_solutions) {
-	FastSolver fs;
-	FastSolver_Init(&fs, b);
-	fs.max_solutions = max_solutions;
-	solve_fast(&fs);
-	return fs.solution_count;
+	uint8_t grid[BOARD_CELLS_MAX];
+	board_to_grid(b, grid);
+
+	/* with a full-width board the incremental hash already matches the grid */
+	uint64_t hash
+		= BOARD_SIZE == BOARD_SIZE_MAX ? b->hash : grid_hash(grid, BOARD_SIZE);
+	return count_solutions_n(grid, BOARD_SIZE, hash, max_solutions);
 }
 
 bool Generator_HasUniqueSolution(const Board *b) {
 	return Generator_CountSolutions(b, 2) == 1;
 }
 
-/* digging out values from previously generated solved puzzle */
 GeneratorResult Generator_CreatePuzzle(Board *b, Difficulty diff, GeneratorFlags flags) {
-	GeneratorResult result = { 0 };
-	if (!Generator_FillGrid(b)) return result;
-
-	bool check = (flags & GEN_FLAG_UNIQUE) != 0;
-	static const int base[] = { 40, 32, 28, 24, 20 }, range[] = { 6, 7, 5, 5, 5 };
-	int target = (diff <= DIFFICULTY_EXPERT) ? base[diff] + rand() % range[diff] : 35;
-	int clues = 81,
-	    check_freq
-		= (diff <= DIFFICULTY_MEDIUM) ? (diff == DIFFICULTY_EASY ? 5 : 3) : 1;
-
-	int pos[81];
-	for (int i = 0; i < 81; i++)
-		pos[i] = i;
-	for (int i = 80; i > 0; i--) {
-		int j = rand() % (i + 1);
-		int tmp = pos[i];
-		pos[i] = pos[j];
-		pos[j] = tmp;
-	}
-
-	/* two phase removal: course then fine */
-	int idx = 0, thresh = target + (diff <= DIFFICULTY_MEDIUM ? 5 : 8);
-	int since_check = 0, agg_freq = (diff <= DIFFICULTY_MEDIUM) ? 3 : 1;
-
-	/* phase 1: course */
-	while (clues > thresh && idx < 81) {
-		int r = pos[idx] / 9, c = pos[idx] % 9;
-		idx++;
-		if (!b->cells[r][c].value) continue;
-		uint8_t saved = b->cells[r][c].value;
-		b->cells[r][c].value = 0;
-		b->cells[r][c].given = false;
-		clues--;
-		result.attempts++;
-		since_check++;
-		if (check && since_check >= agg_freq) {
-			if (!Generator_HasUniqueSolution(b)) {
-				b->cells[r][c].value = saved;
-				b->cells[r][c].given = true;
-				clues++;
-				result.attempts--;
-				break;
-			}
-			since_check = 0;
-		}
-	}
-
-	/* phase 2: fine */
-	int fails = 0, careful_check = 0;
-	for (int i = idx; i < 81 && clues > target; i++) {
-		int r = pos[i] / 9, c = pos[i] % 9;
-		if (!b->cells[r][c].value) continue;
-		result.attempts++;
-		careful_check++;
-		uint8_t saved = b->cells[r][c].value;
-		b->cells[r][c].value = 0;
-		b->cells[r][c].given = false;
-		bool ok = true;
-		if (check && careful_check >= check_freq) {
-			ok = Generator_HasUniqueSolution(b);
-			careful_check = 0;
-		}
-		if (ok) {
-			clues--;
-			fails = 0;
-		}
-		else {
-			b->cells[r][c].value = saved;
-			b->cells[r][c].given = true;
-			if (++fails >= 10) break;
-		}
-	}
-
-	result.success = true;
-	result.clues = clues;
-	result.unique = check && Generator_HasUniqueSolution(b);
+	uint8_t grid[BOARD_CELLS_MAX];
+	GeneratorResult result = Generator_CreatePuzzleN(grid, BOARD_SIZE, diff, flags);
+	if (result.success) grid_to_board(grid, b);
 	return result;
 }
@@ -0,0 +1,396 @@
+/* src/generator_impl.h
+ * size-specialised solver and generator
+ *
+ * included by generator.c once per supported board size, with these defined:
+ * - GEN_N: side length (digits 1..GEN_N)
+ * - GEN_BOX: subgrid side, GEN_BOX * GEN_BOX == GEN_N
+ * - GEN_MASK: unsigned type with at least GEN_N bits for digit masks
+ * every function is static and suffixed with the size (fill_grid_9, ...), so
+ * each size compiles to its own code with constant bounds
+ */
+
+#define GEN_CELLS (GEN_N * GEN_N)
+#define GEN_FULL ((GEN_MASK) ((1ul << GEN_N) - 1))
+#define GEN_CAT_(a, b) a##_##b
+#define GEN_CAT(a, b) GEN_CAT_(a, b)
+#define GEN_FN(name) GEN_CAT(name, GEN_N)
+
+static inline int GEN_FN(box_id)(int row, int col) {
+	return (row / GEN_BOX) * GEN_BOX + (col / GEN_BOX);
+}
+
+/* encode sudoku constraints: cell, row, col, box */
+static void GEN_FN(encode_constraints)(int row, int col, int val, int c[4]) {
+	c[0] = row * GEN_N + col;
+	c[1] = GEN_CELLS + row * GEN_N + (val - 1);
+	c[2] = 2 * GEN_CELLS + col * GEN_N + (val - 1);
+	c[3] = 3 * GEN_CELLS + GEN_FN(box_id)(row, col) * GEN_N + (val - 1);
+}
+
+static bool GEN_FN(DLX_BuildFromGrid)(DLXRoot *dlx, const uint8_t *grid) {
+	if (!DLX_Init(dlx, 4 * GEN_CELLS, GEN_CELLS * GEN_N * 4)) return false;
+	for (int r = 0; r < GEN_N; r++)
+		for (int c = 0; c < GEN_N; c++) {
+			int fixed = grid[r * GEN_N + c];
+			int lo = fixed ? fixed : 1, hi = fixed ? fixed : GEN_N;
+			for (int v = lo; v <= hi; v++) {
+				int constraints[4];
+				GEN_FN(encode_constraints)(r, c, v, constraints);
+				DLX_AddRow(dlx, (r * GEN_N + c) * GEN_N + v - 1,
+					constraints);
+			}
+		}
+	return true;
+}
+
+/* complete the grid in place (givens are kept) with a random solution */
+static bool GEN_FN(fill_grid)(uint8_t *grid) {
+	DLXRoot dlx;
+	if (!GEN_FN(DLX_BuildFromGrid)(&dlx, grid)) return false;
+
+	uint8_t solution[GEN_CELLS * GEN_N] = { 0 };
+	bool success = DLX_SolveRandom(&dlx, solution);
+
+	if (success)
+		for (int i = 0; i < GEN_CELLS * GEN_N; i++)
+			if (solution[i]) grid[i / GEN_N] = (uint8_t) (i % GEN_N + 1);
+
+	DLX_Free(&dlx);
+	return success;
+}
+
+/* fast backtracking solver via bitmasking */
+typedef struct {
+	uint8_t grid[GEN_CELLS];
+	GEN_MASK row_mask[GEN_N], col_mask[GEN_N], box_mask[GEN_N];
+	int solution_count, max_solutions;
+
+	/* variant rules (rules.h), NULL for plain sudoku */
+	const RuleSet *rules;
+	GEN_MASK region_mask[RULES_REGIONS_MAX];
+	GEN_MASK cage_used[RULES_CAGES_MAX];
+	int cage_sum[RULES_CAGES_MAX], cage_empty[RULES_CAGES_MAX];
+	long nodes; /* searched by solve_random, and solve_fast under a budget */
+	long max_nodes; /* solve_fast gives up past this many, 0 = never */
+} GEN_FN(FastSolver);
+
+/* rules only ever exist for sizes up to BOARD_SIZE_MAX, so BOARD_CELL holds */
+static inline void GEN_FN(rules_place)(GEN_FN(FastSolver) * fs, int r, int c, int v) {
+	const RuleSet *rs = fs->rules;
+	int cell = BOARD_CELL(r, c);
+	GEN_MASK bit = (GEN_MASK) (1ul << (v - 1));
+	for (uint32_t regs = rs->regionsOf[cell]; regs; regs &= regs - 1)
+		fs->region_mask[__builtin_ctz(regs)] |= bit;
+	int cage = rs->cageOf[cell];
+	if (cage >= 0) {
+		fs->cage_used[cage] |= bit;
+		fs->cage_sum[cage] += v;
+		fs->cage_empty[cage]--;
+	}
+}
+
+/* undo rules_place of a digit the search placed, so no region had it yet */
+static inline void GEN_FN(rules_unplace)(GEN_FN(FastSolver) * fs, int r, int c, int v) {
+	const RuleSet *rs = fs->rules;
+	int cell = BOARD_CELL(r, c);
+	GEN_MASK bit = (GEN_MASK) (1ul << (v - 1));
+	for (uint32_t regs = rs->regionsOf[cell]; regs; regs &= regs - 1)
+		fs->region_mask[__builtin_ctz(regs)] &= (GEN_MASK) ~bit;
+	int cage = rs->cageOf[cell];
+	if (cage >= 0) {
+		fs->cage_used[cage] &= (GEN_MASK) ~bit;
+		fs->cage_sum[cage] -= v;
+		fs->cage_empty[cage]++;
+	}
+}
+
+/* digits the rules leave for an empty (r, c), table lookups only */
+static inline GEN_MASK GEN_FN(rules_candidates)(
+	const GEN_FN(FastSolver) * fs, int r, int c) {
+	const RuleSet *rs = fs->rules;
+	int cell = BOARD_CELL(r, c);
+	GEN_MASK banned = 0;
+	for (uint32_t regs = rs->regionsOf[cell]; regs; regs &= regs - 1)
+		banned |= fs->region_mask[__builtin_ctz(regs)];
+	for (int k = rs->linkStart[cell]; k < rs->linkStart[cell + 1]; k++) {
+		const RuleLink *l = &rs->links[k];
+		int w = fs->grid[l->row * GEN_N + l->col];
+		if (w) banned |= rs->forbid[l->relation][w];
+	}
+
+	int cage = rs->cageOf[cell];
+	if (cage < 0) return GEN_FULL & ~banned;
+	int left = rs->cages[cage].sum - fs->cage_sum[cage];
+	if (left <= 0 || left > RULES_SUM_MAX) return 0;
+	GEN_MASK fits = rs->combos[fs->cage_empty[cage]][left];
+	return fits & ~fs->cage_used[cage] & ~banned;
+}
+
+static inline void GEN_FN(place)(GEN_FN(FastSolver) * fs, int r, int c, int v) {
+	GEN_MASK bit = (GEN_MASK) (1ul << (v - 1));
+	fs->grid[r * GEN_N + c] = (uint8_t) v;
+	fs->row_mask[r] |= bit;
+	fs->col_mask[c] |= bit;
+	fs->box_mask[GEN_FN(box_id)(r, c)] |= bit;
+	if (fs->rules) GEN_FN(rules_place)(fs, r, c, v);
+}
+
+static inline void GEN_FN(unplace)(GEN_FN(FastSolver) * fs, int r, int c, int v) {
+	GEN_MASK bit = (GEN_MASK) (1ul << (v - 1));
+	fs->grid[r * GEN_N + c] = 0;
+	fs->row_mask[r] &= (GEN_MASK) ~bit;
+	fs->col_mask[c] &= (GEN_MASK) ~bit;
+	fs->box_mask[GEN_FN(box_id)(r, c)] &= (GEN_MASK) ~bit;
+	if (fs->rules) GEN_FN(rules_unplace)(fs, r, c, v);
+}
+
+static void GEN_FN(FastSolver_Init)(
+	GEN_FN(FastSolver) * fs, const uint8_t *grid, const RuleSet *rules) {
+	memset(fs, 0, sizeof(*fs));
+	fs->rules = rules;
+	if (rules)
+		for (int i = 0; i < rules->cageCount; i++)
+			fs->cage_empty[i] = rules->cages[i].count;
+	for (int r = 0; r < GEN_N; r++)
+		for (int c = 0; c < GEN_N; c++) {
+			int v = grid[r * GEN_N + c];
+			if (v > 0) GEN_FN(place)(fs, r, c, v);
+		}
+}
+
+static inline GEN_MASK GEN_FN(get_candidates)(GEN_FN(FastSolver) * fs, int r, int c) {
+	if (fs->grid[r * GEN_N + c]) return 0;
+	GEN_MASK used = fs->row_mask[r] | fs->col_mask[c];
+	used |= fs->box_mask[GEN_FN(box_id)(r, c)];
+	GEN_MASK cand = ~used & GEN_FULL;
+	if (fs->rules && cand) cand &= GEN_FN(rules_candidates)(fs, r, c);
+	return cand;
+}
+
+static bool GEN_FN(find_mrv)(GEN_FN(FastSolver) * fs, int *r, int *c, GEN_MASK *cand) {
+	int min_cnt = GEN_N + 1, br = -1, bc = -1;
+	GEN_MASK bcand = 0;
+	for (int rr = 0; rr < GEN_N; rr++)
+		for (int cc = 0; cc < GEN_N; cc++)
+			if (!fs->grid[rr * GEN_N + cc]) {
+				GEN_MASK candidates = GEN_FN(get_candidates)(fs, rr, cc);
+				int cnt = __builtin_popcount(candidates);
+				if (cnt == 0) {
+					/* dead end, r != -1 tells it from solved */
+					*r = rr;
+					return false;
+				}
+				if (cnt < min_cnt) {
+					min_cnt = cnt;
+					br = rr;
+					bc = cc;
+					bcand = candidates;
+					if (cnt == 1) {
+						*r = br;
+						*c = bc;
+						*cand = bcand;
+						return true;
+					}
+				}
+			}
+	if (br == -1) return false;
+	*r = br;
+	*c = bc;
+	*cand = bcand;
+	return true;
+}
+
+static void GEN_FN(solve_fast)(GEN_FN(FastSolver) * fs) {
+	if (fs->solution_count >= fs->max_solutions) return;
+	if (fs->max_nodes && ++fs->nodes > fs->max_nodes) return;
+	int r = -1, c = -1;
+	GEN_MASK cand;
+	if (!GEN_FN(find_mrv)(fs, &r, &c, &cand)) {
+		if (r == -1) fs->solution_count++;
+		return;
+	}
+	while (cand) {
+		int v = __builtin_ctz(cand) + 1;
+		cand &= cand - 1;
+		GEN_FN(place)(fs, r, c, v);
+		GEN_FN(solve_fast)(fs);
+		GEN_FN(unplace)(fs, r, c, v);
+		if (fs->solution_count >= fs->max_solutions) return;
+	}
+}
+
+/* first solution with the digits of each cell tried in random order, gives
+ * up after GEN_RANDOM_NODES cells and leaves fs as it found it
+ */
+static bool GEN_FN(solve_random)(GEN_FN(FastSolver) * fs) {
+	if (++fs->nodes > GEN_RANDOM_NODES) return false;
+	int r = -1, c = -1;
+	GEN_MASK cand;
+	if (!GEN_FN(find_mrv)(fs, &r, &c, &cand)) return r == -1;
+
+	int digits[GEN_N], n = 0;
+	for (; cand; cand &= cand - 1)
+		digits[n++] = __builtin_ctz(cand) + 1;
+	for (int i = n - 1; i > 0; i--) {
+		int j = rand() % (i + 1);
+		int tmp = digits[i];
+		digits[i] = digits[j];
+		digits[j] = tmp;
+	}
+
+	for (int i = 0; i < n; i++) {
+		GEN_FN(place)(fs, r, c, digits[i]);
+		if (GEN_FN(solve_random)(fs)) return true;
+		GEN_FN(unplace)(fs, r, c, digits[i]);
+	}
+	return false;
+}
+
+/* fill_grid under variant rules, which the dlx matrix does not encode. a
+ * random search that goes wrong early tends to stay lost, so it starts over
+ * with a new order rather than digging on
+ */
+static bool GEN_FN(fill_grid_rules)(uint8_t *grid, const RuleSet *rules) {
+	GEN_FN(FastSolver) fs;
+	GEN_FN(FastSolver_Init)(&fs, grid, rules);
+	for (int attempt = 0; attempt < GEN_RANDOM_RESTARTS; attempt++) {
+		fs.nodes = 0;
+		if (!GEN_FN(solve_random)(&fs)) continue;
+		memcpy(grid, fs.grid, GEN_CELLS);
+		return true;
+	}
+	return false;
+}
+
+static bool GEN_FN(fill)(uint8_t *grid, const RuleSet *rules) {
+	return rules ? GEN_FN(fill_grid_rules)(grid, rules) : GEN_FN(fill_grid)(grid);
+}
+
+/* hash is the zobrist hash of grid, salted per size and rule set before
+ * hitting the table. -1 if the search ran past max_nodes (0 = no limit)
+ */
+static int GEN_FN(count_solutions)(const uint8_t *grid,
+	uint64_t hash,
+	int max_solutions,
+	const RuleSet *rules,
+	long max_nodes) {
+	uint64_t key = hash ^ Board_ZobristKey(GEN_CELLS, 0) ^ (rules ? rules->hash : 0);
+	int count;
+	if (tt_probe(key, max_solutions, &count)) return count;
+
+	GEN_FN(FastSolver) fs;
+	GEN_FN(FastSolver_Init)(&fs, grid, rules);
+	fs.max_solutions = max_solutions;
+	fs.max_nodes = max_nodes;
+	GEN_FN(solve_fast)(&fs);
+	if (max_nodes && fs.nodes > max_nodes) return -1;
+
+	tt_store(key, max_solutions, fs.solution_count);
+	return fs.solution_count;
+}
+
+/* is the dug out grid still unique, a check that runs past its budget counts
+ * as no so the clue stays
+ */
+static bool GEN_FN(still_unique)(
+	const uint8_t *grid, uint64_t hash, const RuleSet *rules) {
+	return GEN_FN(count_solutions)(grid, hash, 2, rules, GEN_CHECK_NODES) == 1;
+}
+
+/* digging out values from previously generated solved puzzle */
+static GeneratorResult GEN_FN(create_puzzle)(
+	uint8_t *grid, Difficulty diff, GeneratorFlags flags, const RuleSet *rules) {
+	GeneratorResult result = { 0 };
+	memset(grid, 0, GEN_CELLS);
+	if (!GEN_FN(fill)(grid, rules)) return result;
+
+	uint64_t hash = 0;
+	for (int i = 0; i < GEN_CELLS; i++)
+		if (grid[i]) hash ^= Board_ZobristKey(i, grid[i]);
+
+	/* clue counts are tuned for 81 cells and scaled to the board */
+	bool check = (flags & GEN_FLAG_UNIQUE) != 0;
+	static const int base[] = { 40, 32, 28, 24, 20 }, range[] = { 6, 7, 5, 5, 5 };
+	int target = (diff <= DIFFICULTY_EXPERT) ? base[diff] + rand() % range[diff] : 35;
+	target = target * GEN_CELLS / 81;
+	int clues = GEN_CELLS,
+	    check_freq
+		= (diff <= DIFFICULTY_MEDIUM) ? (diff == DIFFICULTY_EASY ? 5 : 3) : 1;
+
+	int pos[GEN_CELLS];
+	for (int i = 0; i < GEN_CELLS; i++)
+		pos[i] = i;
+	for (int i = GEN_CELLS - 1; i > 0; i--) {
+		int j = rand() % (i + 1);
+		int tmp = pos[i];
+		pos[i] = pos[j];
+		pos[j] = tmp;
+	}
+
+	/* two phase removal: course then fine */
+	int slack = (diff <= DIFFICULTY_MEDIUM ? 5 : 8) * GEN_CELLS / 81;
+	int idx = 0, thresh = target + slack;
+	int since_check = 0, agg_freq = (diff <= DIFFICULTY_MEDIUM) ? 3 : 1;
+
+	/* phase 1: course */
+	while (clues > thresh && idx < GEN_CELLS) {
+		int i = pos[idx++];
+		if (!grid[i]) continue;
+		int saved = grid[i];
+		grid[i] = 0;
+		hash ^= Board_ZobristKey(i, saved);
+		clues--;
+		result.attempts++;
+		since_check++;
+		if (check && since_check >= agg_freq) {
+			if (!GEN_FN(still_unique)(grid, hash, rules)) {
+				grid[i] = (uint8_t) saved;
+				hash ^= Board_ZobristKey(i, saved);
+				clues++;
+				result.attempts--;
+				break;
+			}
+			since_check = 0;
+		}
+	}
+
+	/* phase 2: fine */
+	int fails = 0, careful_check = 0;
+	for (int k = idx; k < GEN_CELLS && clues > target; k++) {
+		int i = pos[k];
+		if (!grid[i]) continue;
+		result.attempts++;
+		careful_check++;
+		int saved = grid[i];
+		grid[i] = 0;
+		hash ^= Board_ZobristKey(i, saved);
+		bool ok = true;
+		if (check && careful_check >= check_freq) {
+			ok = GEN_FN(still_unique)(grid, hash, rules);
+			careful_check = 0;
+		}
+		if (ok) {
+			clues--;
+			fails = 0;
+		}
+		else {
+			grid[i] = (uint8_t) saved;
+			hash ^= Board_ZobristKey(i, saved);
+			if (++fails >= 10) break;
+		}
+	}
+
+	result.success = true;
+	result.clues = clues;
+	result.unique = check && GEN_FN(still_unique)(grid, hash, rules);
+	return result;
+}
+
+#undef GEN_FN
+#undef GEN_CAT
+#undef GEN_CAT_
+#undef GEN_FULL
+#undef GEN_CELLS
+#undef GEN_MASK
+#undef GEN_BOX
+#undef GEN_N
@@ -0,0 +1,113 @@
+/* src/history.c
+ * undo/redo ring buffer
+ */
+
+#include <string.h>
+
+#include "history.h"
+
+/* bit k set if the k-th peer of cell i has note v */
+static unsigned int peer_notes(const Board *b, int i, int v) {
+	if (v < 1) return 0;
+	BoardSet peers = Board_PeerSet(i / BOARD_SIZE_MAX, i % BOARD_SIZE_MAX);
+	unsigned int mask = 0;
+	int p;
+	for (int k = 0; (p = BoardSet_Pop(&peers)) >= 0; k++)
+		if (BoardSet_Test(b->notes[v - 1], p)) mask |= 1u << k;
+	return mask;
+}
+
+static void flip_peer_notes(Board *b, int i, int v, unsigned int mask) {
+	if (v < 1 || !mask) return;
+	BoardSet peers = Board_PeerSet(i / BOARD_SIZE_MAX, i % BOARD_SIZE_MAX);
+	int p;
+	for (int k = 0; (p = BoardSet_Pop(&peers)) >= 0; k++)
+		if (mask & (1u << k))
+			Board_ToggleNote(b, p / BOARD_SIZE_MAX, p % BOARD_SIZE_MAX, v);
+}
+
+/* put a cell back into one side of an entry */
+static void apply(Board *b, HistoryEntry e, bool forward) {
+	int r = e.cell / BOARD_SIZE_MAX, c = e.cell % BOARD_SIZE_MAX;
+	int digit = e.newValue ? e.newValue : e.oldValue;
+
+	Board_Set(b, r, c, forward ? e.newValue : e.oldValue, false);
+	Board_SetNotes(b, r, c, (uint16_t) ((forward ? e.newNotes : e.oldNotes) << 1));
+	Board_SetColor(b, r, c, forward ? e.newColor : e.oldColor);
+	flip_peer_notes(b, e.cell, digit, e.peers);
+}
+
+void History_Clear(History *h) {
+	h->head = 0;
+	h->undoCount = 0;
+	h->redoCount = 0;
+}
+
+HistoryEntry History_Begin(const Board *b, int r, int c, int digit) {
+	HistoryEntry e;
+	memset(&e, 0, sizeof(e));
+	e.cell = BOARD_CELL(r, c);
+	e.oldValue = Board_Value(b, r, c);
+	e.oldColor = Board_Color(b, r, c);
+	e.oldNotes = Board_GetNotes(b, r, c) >> 1;
+	e.peers = peer_notes(b, e.cell, digit); /* diffed in History_End */
+	return e;
+}
+
+bool History_End(History *h, const Board *b, HistoryEntry e, int digit, bool linked) {
+	int r = e.cell / BOARD_SIZE_MAX, c = e.cell % BOARD_SIZE_MAX;
+	e.newValue = Board_Value(b, r, c);
+	e.newColor = Board_Color(b, r, c);
+	e.newNotes = Board_GetNotes(b, r, c) >> 1;
+	e.peers ^= peer_notes(b, e.cell, digit);
+	e.linked = linked;
+
+	if (e.oldValue == e.newValue && e.oldColor == e.newColor
+		&& e.oldNotes == e.newNotes && !e.peers)
+		return false;
+
+	h->entries[h->head] = e;
+	h->head = (h->head + 1) % HISTORY_CAPACITY;
+	h->redoCount = 0;
+	if (h->undoCount < HISTORY_CAPACITY) {
+		h->undoCount++;
+		return true;
+	}
+
+	/* the ring was full and the oldest move lost its first entry. drop the
+	 * rest of it too, or undoing that far would only revert part of it
+	 */
+	int oldest = h->head;
+	while (h->undoCount > 1 && h->entries[oldest].linked) {
+		oldest = (oldest + 1) % HISTORY_CAPACITY;
+		h->undoCount--;
+	}
+	return true;
+}
+
+bool History_Undo(History *h, Board *b) {
+	if (h->undoCount == 0) return false;
+
+	/* unwind the whole linked chain */
+	HistoryEntry e;
+	do {
+		h->head = (h->head - 1 + HISTORY_CAPACITY) % HISTORY_CAPACITY;
+		h->undoCount--;
+		h->redoCount++;
+		e = h->entries[h->head];
+		apply(b, e, false);
+	} while (e.linked && h->undoCount > 0);
+	return true;
+}
+
+bool History_Redo(History *h, Board *b) {
+	if (h->redoCount == 0) return false;
+
+	do {
+		apply(b, h->entries[h->head], true);
+		h->head = (h->head + 1) % HISTORY_CAPACITY;
+		h->undoCount++;
+		h->redoCount--;
+	} while (h->redoCount > 0 && h->entries[h->head].linked);
+	return true;
+}
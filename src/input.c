@@ -6,82 +6,48 @@
 
 #include "input.h"
 #include "board.h"
+#include "layout.h"
 
 bool Input_EscapePressed(void) {
 	return IsKeyPressed(KEY_ESCAPE);
 }
 
-static bool MouseToBoardCoords(int mouseX, int mouseY, int *row, int *col) {
-	/* calculate board bounds */
-	int boardX = BOARD_PAD;
-	int boardY = TOPBAR_H + BOARD_PAD;
-	int boardSize = TILE_PIX * BOARD_SIZE;
-
-	/* check if mouse is within board bounds */
-	if (mouseX < boardX || mouseX >= boardX + boardSize || mouseY < boardY
-		|| mouseY >= boardY + boardSize) {
-		*row = -1;
-		*col = -1;
-		return false;
-	}
-
-	/* convert to cell coordinates - already in valid range due to bounds check */
-	*col = (mouseX - boardX) / TILE_PIX;
-	*row = (mouseY - boardY) / TILE_PIX;
-
-	return true;
-}
-
-static int MouseToColorIndex(int mouseX, int mouseY) {
-	/* calculate color keypad position - must match UI_DrawSidebar exactly */
-	int keypadX = BOARD_PAD + TILE_PIX * BOARD_SIZE + SIDEBAR_MARGIN;
-	/* Start: TOPBAR_H + BOARD_PAD
-	 * + CONTROLS_SECTION_SPACING (after "controls:")
-	 * + CONTROLS_LINE_SPACING * 5 (5 control lines)
-	 * + CONTROLS_SECTION_SPACING + 8 (after last control)
-	 * + CONTROLS_SECTION_SPACING (after "color palette:")
-	 */
-	int keypadY = TOPBAR_H + BOARD_PAD + CONTROLS_SECTION_SPACING * 3
-		+ CONTROLS_LINE_SPACING * 5 + 8;
-
-	/* check each color button */
-	for (int i = 1; i < CELL_COLOR_COUNT; i++) {
-		int row = (i - 1) / COLOR_KEYPAD_COLS;
-		int col = (i - 1) % COLOR_KEYPAD_COLS;
-		int px = keypadX + col * (COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING);
-		int py = keypadY + row * (COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING);
-
-		if (mouseX >= px && mouseX < px + COLOR_KEYPAD_SIZE && mouseY >= py
-			&& mouseY < py + COLOR_KEYPAD_SIZE) {
-			return i;
-		}
-	}
-
-	return 0; /* no color selected */
+bool Input_AnyActivity(void) {
+	Vector2 delta = GetMouseDelta();
+	if (delta.x != 0.0f || delta.y != 0.0f) return true;
+	if (GetMouseWheelMove() != 0.0f) return true;
+	if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) || IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
+		return true;
+	if (IsWindowResized()) return true;
+
+	/* scan key states rather than draining the key queue */
+	for (int key = KEY_SPACE; key <= KEY_KB_MENU; key++)
+		if (IsKeyDown(key) || IsKeyReleased(key)) return true;
+	return false;
 }
 
 void Input_Update(Game *g) {
 	/* mouse input for cell selection and color keypad */
 	if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
 		Vector2 mousePos = GetMousePosition();
+		int mx = (int) mousePos.x, my = (int) mousePos.y;
 		int row, col;
-		if (MouseToBoardCoords((int) mousePos.x, (int) mousePos.y, &row, &col)) {
+		if (Layout_CellAt(&g_layout, mx, my, &row, &col)) {
 			g->selRow = row;
 			g->selCol = col;
 		}
 		else {
 			/* check if clicking on color keypad */
-			int colorIdx
-				= MouseToColorIndex((int) mousePos.x, (int) mousePos.y);
+			int colorIdx = Layout_ColorAt(&g_layout, mx, my);
+			int cellColor = Board_Color(&g->board, g->selRow, g->selCol);
 			if (colorIdx > 0) {
-				Cell *cell = &g->board.cells[g->selRow][g->selCol];
 				/* toggle color: if same color is already on cell, remove it */
-				if (cell->color == colorIdx) {
-					cell->color = 0;
+				if (cellColor == colorIdx) {
+					Game_SetColor(g, 0);
 					g->selectedColorIndex = 0;
 				}
 				else {
-					cell->color = (uint8_t) colorIdx;
+					Game_SetColor(g, colorIdx);
 					g->selectedColorIndex = colorIdx;
 				}
 			}
@@ -96,46 +62,46 @@ void Input_Update(Game *g) {
 	if (IsKeyPressed(KEY_UP)) g->selRow = (g->selRow - 1 + BOARD_SIZE) % BOARD_SIZE;
 
 	/* digit input */
-	Cell *ce = &g->board.cells[g->selRow][g->selCol];
-	if (!ce->given) {
+	if (!Board_IsGiven(&g->board, g->selRow, g->selCol)) {
 		/* check if clear key (0, bcksp, del) */
 		if (IsKeyPressed(KEY_ZERO) || IsKeyPressed(KEY_KP_0)
 			|| IsKeyPressed(KEY_BACKSPACE) || IsKeyPressed(KEY_DELETE)) {
-			ce->value = 0;
-			ce->notes = 0;
-		}
-		else if (g->inputMode == INPUT_MODE_INSERT) {
-			/* insert mode */
-			for (int v = 1; v <= 9; v++) {
-				if (IsKeyPressed(KEY_ZERO + v)
-					|| IsKeyPressed(KEY_KP_0 + v)) {
-					ce->value = (uint8_t) v;
-					ce->notes = 0; /* clear notes */
-					/* auto-remove notes from affected cells */
-					Board_ClearNotesAffectedBy(
-						&g->board, g->selRow, g->selCol, v);
-					break;
-				}
-			}
+			Game_ClearCell(g);
 		}
 		else {
-			/* notes mode: toggle candidates */
 			for (int v = 1; v <= 9; v++) {
 				if (IsKeyPressed(KEY_ZERO + v)
 					|| IsKeyPressed(KEY_KP_0 + v)) {
-					/* toggle the bit for this number */
-					ce->notes ^= (1u << v);
+					/* insert sets the digit, notes toggles it */
+					if (g->inputMode == INPUT_MODE_INSERT)
+						Game_SetDigit(g, v);
+					else
+						Game_ToggleNote(g, v);
 					break;
 				}
 			}
 		}
 	}
 
+	/* undo/redo (ctrl+shift+z also redoes) */
+	bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+	bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+	if (ctrl && IsKeyPressed(KEY_Z)) {
+		if (shift)
+			Game_Redo(g);
+		else
+			Game_Undo(g);
+	}
+	if (ctrl && IsKeyPressed(KEY_Y)) Game_Redo(g);
+
 	/* mode toggle */
 	if (IsKeyPressed(KEY_N))
 		g->inputMode = (g->inputMode == INPUT_MODE_INSERT) ? INPUT_MODE_NOTES
 								   : INPUT_MODE_INSERT;
 
+	/* auto notes (default off) */
+	if (IsKeyPressed(KEY_A)) Game_ToggleAutoNotes(g);
+
 	/* conflict highlighting (default on)*/
 	if (IsKeyPressed(KEY_H)) g->highlightConflicts = !g->highlightConflicts;
 
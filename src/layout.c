@@ -0,0 +1,175 @@
+/* src/layout.c
+ * precomputed screen layout
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "layout.h"
+#include "ui.h"
+
+Layout g_layout;
+
+/* direct-mapped MeasureText cache, entries are checked against the full text */
+#define TEXT_CACHE_SIZE 256
+#define TEXT_CACHE_MAX_LEN 64
+
+typedef struct TextWidthEntry {
+	char text[TEXT_CACHE_MAX_LEN];
+	int fontSize;
+	int width; /* 0 = empty slot */
+} TextWidthEntry;
+
+static TextWidthEntry s_textCache[TEXT_CACHE_SIZE];
+
+static ThemeColors CacheThemeColors(const Theme *theme) {
+	ThemeColors colors = { .bg = ColorFromUInt(theme->bg),
+		.grid = ColorFromUInt(theme->grid),
+		.gridBold = ColorFromUInt(theme->gridBold),
+		.cellBg = ColorFromUInt(theme->cellBg),
+		.cellSel = ColorFromUInt(theme->cellSel),
+		.digitGiven = ColorFromUInt(theme->digitGiven),
+		.digitUser = ColorFromUInt(theme->digitUser),
+		.accent = ColorFromUInt(theme->accent),
+		.text = ColorFromUInt(theme->text),
+		.bad = ColorFromUInt(theme->bad),
+		.highlightRowCol = ColorFromUInt(theme->highlightRowCol),
+		.highlightDigit = ColorFromUInt(theme->highlightDigit),
+		.topbarBg = ColorFromUInt(theme->topbarBg),
+		.topbarText = ColorFromUInt(theme->topbarText),
+		.menuText = ColorFromUInt(theme->menuText),
+		.menuSel = ColorFromUInt(theme->menuSel),
+		.menuSelBg = ColorFromUInt(theme->menuSelBg) };
+	for (int i = 0; i < CELL_COLOR_COUNT; i++) {
+		colors.cellColors[i] = ColorFromUInt(theme->cellColors[i]);
+	}
+	return colors;
+}
+
+static void Layout_Build(Layout *l) {
+	int boardSize = TILE_PIX * BOARD_SIZE;
+	l->tile = TILE_PIX;
+	l->board = (Rectangle) { BOARD_PAD, TOPBAR_H + BOARD_PAD, boardSize, boardSize };
+
+	/* sidebar, top to bottom in drawing order */
+	int x = BOARD_PAD + boardSize + SIDEBAR_MARGIN;
+	int y = TOPBAR_H + BOARD_PAD;
+	l->sidebarX = x;
+
+	l->controlsHeadingY = y;
+	y += CONTROLS_SECTION_SPACING;
+	for (int i = 0; i < LAYOUT_CONTROL_LINES; i++) {
+		l->controlLineY[i] = y;
+		y += CONTROLS_LINE_SPACING;
+	}
+	y += CONTROLS_SECTION_SPACING + 8 - CONTROLS_LINE_SPACING;
+
+	l->paletteHeadingY = y;
+	y += CONTROLS_SECTION_SPACING;
+
+	l->keypadStride = COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING;
+	int keyRows = (CELL_COLOR_COUNT - 2) / COLOR_KEYPAD_COLS + 1;
+	l->keypad = (Rectangle) {
+		x, y, COLOR_KEYPAD_COLS * l->keypadStride, keyRows * l->keypadStride
+	};
+	l->colorKeys[CELL_COLOR_NONE] = (Rectangle) { 0 };
+	for (int i = 1; i < CELL_COLOR_COUNT; i++) {
+		int row = (i - 1) / COLOR_KEYPAD_COLS;
+		int col = (i - 1) % COLOR_KEYPAD_COLS;
+		l->colorKeys[i] = (Rectangle) { x + col * l->keypadStride,
+			y + row * l->keypadStride,
+			COLOR_KEYPAD_SIZE,
+			COLOR_KEYPAD_SIZE };
+	}
+	y += keyRows * l->keypadStride + CONTROLS_SECTION_SPACING;
+
+	l->numbersY = y;
+	l->solvedY = y + CONTROLS_SECTION_SPACING;
+
+	int barW = WINDOW_W - BOARD_PAD - x;
+	if (barW < 2 * TILE_PIX) barW = 2 * TILE_PIX;
+	l->replayBar = (Rectangle) { x, l->keypad.y, barW, LAYOUT_REPLAY_BAR_H };
+
+	/* puzzle browser, under the screen title */
+	l->browserFilterY = LAYOUT_TITLE_Y + FONT_SIZE_TITLE + 8;
+	l->browserRowH = FONT_SIZE_NORMAL + 2 * MENU_PADDING_Y;
+	int listY = l->browserFilterY + FONT_SIZE_NORMAL + 2 * MENU_PADDING_Y;
+	l->browserRows = (WINDOW_H - BOARD_PAD - listY) / l->browserRowH;
+	if (l->browserRows < 1) l->browserRows = 1;
+	l->browserList = (Rectangle) { BOARD_PAD,
+		listY,
+		WINDOW_W - 2 * BOARD_PAD,
+		l->browserRows * l->browserRowH };
+}
+
+void Layout_Refresh(const Theme *theme) {
+	Layout *l = &g_layout;
+	unsigned changed = l->valid ? Config_Diff(&l->config, &g_config) : ~0u;
+	bool themeChanged = !l->valid || memcmp(&l->theme, theme, sizeof(Theme)) != 0;
+	if (!changed && !themeChanged) return;
+
+	/* only redo what the change touched, a theme edit keeps the geometry */
+	if (themeChanged) l->colors = CacheThemeColors(theme);
+	if (changed
+		& (CONFIG_CHANGED_GRID | CONFIG_CHANGED_WINDOW | CONFIG_CHANGED_LAYOUT
+			| CONFIG_CHANGED_FONTS)) {
+		Layout_Build(l);
+		l->generation++;
+	}
+	if (changed & CONFIG_CHANGED_FONTS) memset(s_textCache, 0, sizeof(s_textCache));
+
+	l->config = g_config;
+	l->theme = *theme;
+	l->valid = true;
+}
+
+bool Layout_CellAt(const Layout *l, int x, int y, int *row, int *col) {
+	int bx = x - (int) l->board.x, by = y - (int) l->board.y;
+	if (bx < 0 || by < 0 || bx >= l->board.width || by >= l->board.height) {
+		*row = -1;
+		*col = -1;
+		return false;
+	}
+
+	*col = bx / l->tile;
+	*row = by / l->tile;
+	return true;
+}
+
+int Layout_ColorAt(const Layout *l, int x, int y) {
+	int kx = x - (int) l->keypad.x, ky = y - (int) l->keypad.y;
+	if (kx < 0 || ky < 0 || kx >= l->keypad.width || ky >= l->keypad.height) return 0;
+
+	/* the spacing between keys does not count as a hit */
+	if (kx % l->keypadStride >= COLOR_KEYPAD_SIZE) return 0;
+	if (ky % l->keypadStride >= COLOR_KEYPAD_SIZE) return 0;
+
+	int i = (ky / l->keypadStride) * COLOR_KEYPAD_COLS + kx / l->keypadStride + 1;
+	return i < CELL_COLOR_COUNT ? i : 0;
+}
+
+int Layout_BrowserRowAt(const Layout *l, int x, int y) {
+	Rectangle r = l->browserList;
+	if (x < r.x || x >= r.x + r.width || y < r.y || y >= r.y + r.height) return -1;
+	return (y - (int) r.y) / l->browserRowH;
+}
+
+int Layout_TextWidth(const char *text, int fontSize) {
+	size_t len = strlen(text);
+	if (len >= TEXT_CACHE_MAX_LEN) return MeasureText(text, fontSize);
+
+	/* fnv-1a over the text and size */
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ (uint8_t) text[i]) * 16777619u;
+	h = (h ^ (uint32_t) fontSize) * 16777619u;
+
+	TextWidthEntry *e = &s_textCache[h % TEXT_CACHE_SIZE];
+	if (e->width && e->fontSize == fontSize && strcmp(e->text, text) == 0)
+		return e->width;
+
+	memcpy(e->text, text, len + 1);
+	e->fontSize = fontSize;
+	e->width = MeasureText(text, fontSize);
+	return e->width;
+}
@@ -10,6 +10,28 @@
 #include "game.h"
 #include "config.h"
 #include "input.h"
+#include "ui.h"
+#include "profiler.h"
+
+/* frame pacing: full rate while the player is active, then throttle down.
+ * the clock only needs a tick every second, anything else with no input
+ * can block until the next event
+ */
+#define ACTIVE_FPS 60
+#define IDLE_FPS 10
+#define IDLE_AFTER_SECONDS 0.5
+
+typedef enum FramePace { PACE_ACTIVE, PACE_THROTTLED, PACE_WAITING } FramePace;
+
+static void SetFramePace(FramePace *current, FramePace pace) {
+	if (*current == pace) return;
+	if (pace == PACE_WAITING)
+		EnableEventWaiting();
+	else if (*current == PACE_WAITING)
+		DisableEventWaiting();
+	SetTargetFPS(pace == PACE_THROTTLED ? IDLE_FPS : ACTIVE_FPS);
+	*current = pace;
+}
 
 int main(void) {
 	/* seed rng */
@@ -20,7 +42,9 @@ int main(void) {
 
 	SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_VSYNC_HINT);
 	InitWindow(WINDOW_W, WINDOW_H, APP_TITLE);
-	SetTargetFPS(60);
+	SetTargetFPS(ACTIVE_FPS);
+	FramePace pace = PACE_ACTIVE;
+	double lastActivity = 0.0;
 
 	/* disable default esc behaviour */
 	SetExitKey(0);
@@ -31,9 +55,17 @@ int main(void) {
 	while (true) {
 		if (Input_EscapePressed()) {
 			switch (game.screen) {
+			case SCREEN_LOAD_PUZZLE:
+				/* out of an open collection first */
+				if (!Game_CloseCollection(&game))
+					game.screen = SCREEN_MENU;
+				break;
+			case SCREEN_REPLAYS:
+				/* out of an open replay first */
+				if (!Game_CloseReplay(&game)) game.screen = SCREEN_MENU;
+				break;
 			case SCREEN_PLAY:
 			case SCREEN_DIFFICULTY:
-			case SCREEN_LOAD_PUZZLE:
 			case SCREEN_SETTINGS:
 				game.screen = SCREEN_MENU;
 				break;
@@ -49,10 +81,27 @@ int main(void) {
 			break;
 		}
 
+#ifdef PROFILER_ENABLED
+		if (IsKeyPressed(KEY_F3)) g_profiler.visible = !g_profiler.visible;
+#endif
+
+		PROFILE_FRAME_BEGIN();
 		Game_Update(&game);
 		Game_Draw(&game);
+		PROFILE_FRAME_END();
+
+		/* any input or visible background work snaps back to full rate */
+		if (Input_AnyActivity()) lastActivity = GetTime();
+		if (GetTime() - lastActivity < IDLE_AFTER_SECONDS || Game_Busy(&game))
+			SetFramePace(&pace, PACE_ACTIVE);
+		else if (Game_ClockRunning(&game) || Game_Watching(&game))
+			SetFramePace(&pace, PACE_THROTTLED);
+		else
+			SetFramePace(&pace, PACE_WAITING);
 	}
 
+	Game_Shutdown(&game);
+	UI_Shutdown();
 	CloseWindow();
 	return 0;
 }
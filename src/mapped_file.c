@@ -0,0 +1,66 @@
+/* src/mapped_file.c
+ * whole-file read-only views
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+bool MappedFile_Open(MappedFile *f, const char *path) {
+	memset(f, 0, sizeof(*f));
+	struct stat st;
+
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+
+	f->data = data;
+	f->size = (size_t) st.st_size;
+	f->mapped = true;
+#else
+	/* no mmap here, read it in instead */
+	if (stat(path, &st) != 0 || st.st_size <= 0) return false;
+	FILE *file = fopen(path, "rb");
+	if (!file) return false;
+	char *data = malloc((size_t) st.st_size);
+	size_t len = data ? fread(data, 1, (size_t) st.st_size, file) : 0;
+	fclose(file);
+	if (len != (size_t) st.st_size) {
+		free(data);
+		return false;
+	}
+
+	f->data = data;
+	f->size = len;
+	f->mapped = false;
+#endif
+
+	f->mtime = (long long) st.st_mtime;
+	return true;
+}
+
+void MappedFile_Close(MappedFile *f) {
+#ifndef _WIN32
+	if (f->mapped) munmap((void *) f->data, f->size);
+#endif
+	if (!f->mapped) free((void *) f->data);
+	memset(f, 0, sizeof(*f));
+}
@@ -0,0 +1,740 @@
+/* src/mod.c
+ * lua mod runtime and hook budgets
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minilua.h"
+
+#include "mod.h"
+#include "profiler.h"
+#include "puzzle_loader.h"
+#include "rules.h"
+
+static const char *s_hookNames[MOD_HOOK_COUNT]
+	= { "on_move", "validate_move", "on_draw_overlay", "on_generate" };
+
+static ModRuntime *runtime_of(lua_State *L) {
+	return *(ModRuntime **) lua_getextraspace(L);
+}
+
+/* every allocation of the state goes through here, so a mod cannot take
+ * more than MOD_MEMORY_MAX
+ */
+static void *mod_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	ModRuntime *rt = ud;
+	size_t old = ptr ? osize : 0;
+	if (nsize == 0) {
+		free(ptr);
+		rt->memory -= old;
+		return NULL;
+	}
+	if (nsize > old && rt->memory - old + nsize > MOD_MEMORY_MAX) return NULL;
+
+	void *p = realloc(ptr, nsize);
+	if (p) rt->memory = rt->memory - old + nsize;
+	return p;
+}
+
+/* runs every MOD_HOOK_STEP instructions while any Lua code does */
+static void budget_hook(lua_State *L, lua_Debug *ar) {
+	(void) ar;
+	ModRuntime *rt = runtime_of(L);
+	rt->instructions += MOD_HOOK_STEP;
+	if (rt->instructions > MOD_CALL_INSTRUCTIONS) {
+		rt->exhausted = true;
+		luaL_error(L, "instruction limit reached");
+	}
+	if (Profiler_Now() > rt->deadline) {
+		rt->timedOut = true;
+		rt->exhausted = true;
+		luaL_error(L, "out of time budget");
+	}
+}
+
+/* pcall and xpcall, upvalue 1, that pass a blown budget on instead of
+ * catching it, or a mod could loop around the error forever
+ */
+static int guarded_pcall(lua_State *L) {
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+	if (runtime_of(L)->exhausted) luaL_error(L, "out of budget");
+	return lua_gettop(L);
+}
+
+/* xpcall's message handler, upvalue 1, skipped for a blown budget: that error
+ * comes from inside the count hook, so the handler would run without it
+ */
+static int guarded_handler(lua_State *L) {
+	if (runtime_of(L)->exhausted) return 1;
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, 1);
+	return 1;
+}
+
+static int guarded_xpcall(lua_State *L) {
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	lua_pushvalue(L, 2);
+	lua_pushcclosure(L, guarded_handler, 1);
+	lua_replace(L, 2);
+	return guarded_pcall(L);
+}
+
+/* setmetatable, upvalue 1, refusing __gc. finalizers run with hooks off, so
+ * one could loop forever
+ */
+static int guarded_setmetatable(lua_State *L) {
+	if (lua_istable(L, 2)) {
+		lua_pushliteral(L, "__gc");
+		bool gc = lua_rawget(L, 2) != LUA_TNIL;
+		lua_pop(L, 1);
+		if (gc) luaL_error(L, "__gc is not allowed in mods");
+	}
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, 1);
+	return 1;
+}
+
+/* load, upvalue 1, for source text only. bytecode is not checked by the VM */
+static int text_load(lua_State *L) {
+	if (lua_gettop(L) < 3) lua_settop(L, 3);
+	lua_pushliteral(L, "t");
+	lua_replace(L, 3);
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+	return lua_gettop(L);
+}
+
+/* replace global name with f, which gets the original as its upvalue */
+static void wrap_global(lua_State *L, const char *name, lua_CFunction f) {
+	lua_getglobal(L, name);
+	lua_pushcclosure(L, f, 1);
+	lua_setglobal(L, name);
+}
+
+/* the count hook does not run inside C functions, so the string functions
+ * that can loop for long in one call are bounded up front
+ */
+
+/* call upvalue 1 with the arguments as they are */
+static int call_original(lua_State *L) {
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+	return lua_gettop(L);
+}
+
+/* string.rep, upvalue 1, building at most MOD_STRING_MAX bytes in at most
+ * that many steps, so rep("", 1e15) is refused as well
+ */
+static int bounded_rep(lua_State *L) {
+	size_t len, sepLen = 0;
+	luaL_checklstring(L, 1, &len);
+	lua_Integer n = luaL_checkinteger(L, 2);
+	luaL_optlstring(L, 3, "", &sepLen);
+	double bytes = (double) n * (double) (len + sepLen);
+	if (n > MOD_STRING_MAX || bytes > MOD_STRING_MAX)
+		luaL_error(L, "string.rep result too long for a mod");
+	return call_original(L);
+}
+
+/* worst case steps of matching pattern p against len bytes: every start, and
+ * for each * + - or %b one more scan of the subject, each ? doubles it
+ */
+static double pattern_steps(const char *p, size_t patLen, size_t len) {
+	double steps = (double) len + 1;
+	for (size_t i = 0; i < patLen; i++) {
+		switch (p[i]) {
+		case '%':
+			/* %bxy scans to its closing y, the x and y are not quantifiers */
+			if (i + 1 < patLen && p[i + 1] == 'b') {
+				steps *= (double) len + 1;
+				i += 2;
+			}
+			i++;
+			break;
+		case '[':
+			/* a set is one class, a ] right after [ or [^ is part of it */
+			i += i + 1 < patLen && p[i + 1] == '^' ? 2 : 1;
+			if (i < patLen && p[i] == ']') i++;
+			while (i < patLen && p[i] != ']')
+				i += p[i] == '%' ? 2 : 1;
+			break;
+		case '*':
+		case '+':
+		case '-':
+			steps *= (double) len + 1;
+			break;
+		case '?':
+			steps *= 2;
+			break;
+		}
+	}
+	return steps;
+}
+
+/* refuse a pattern that could backtrack past MOD_PATTERN_STEPS on its subject */
+static void check_pattern(lua_State *L) {
+	size_t len, patLen;
+	luaL_checklstring(L, 1, &len);
+	const char *p = luaL_checklstring(L, 2, &patLen);
+	if (pattern_steps(p, patLen, len) > MOD_PATTERN_STEPS)
+		luaL_error(L, "pattern too costly for its subject in a mod");
+}
+
+/* match, gmatch and gsub, upvalue 1 */
+static int bounded_match(lua_State *L) {
+	check_pattern(L);
+	return call_original(L);
+}
+
+/* find, upvalue 1, whose plain search does no matching */
+static int bounded_find(lua_State *L) {
+	if (!lua_toboolean(L, 4)) check_pattern(L);
+	return call_original(L);
+}
+
+/* replace string.name with f, which gets the original as its upvalue. the
+ * string metatable indexes the same table, so methods are covered too
+ */
+static void wrap_string(lua_State *L, const char *name, lua_CFunction f) {
+	lua_getglobal(L, "string");
+	lua_getfield(L, -1, name);
+	lua_pushcclosure(L, f, 1);
+	lua_setfield(L, -2, name);
+	lua_pop(L, 1);
+}
+
+/* board access for hooks */
+
+static bool check_cell(lua_State *L, int *r, int *c) {
+	ModRuntime *rt = runtime_of(L);
+	*r = (int) luaL_checkinteger(L, 1) - 1;
+	*c = (int) luaL_checkinteger(L, 2) - 1;
+	return rt->board && *r >= 0 && *r < BOARD_SIZE && *c >= 0 && *c < BOARD_SIZE;
+}
+
+static int sudoku_cell(lua_State *L) {
+	int r, c;
+	bool ok = check_cell(L, &r, &c);
+	lua_pushinteger(L, ok ? Board_Value(runtime_of(L)->board, r, c) : 0);
+	return 1;
+}
+
+static int sudoku_given(lua_State *L) {
+	int r, c;
+	bool ok = check_cell(L, &r, &c);
+	lua_pushboolean(L, ok && Board_IsGiven(runtime_of(L)->board, r, c));
+	return 1;
+}
+
+static int sudoku_selected(lua_State *L) {
+	ModRuntime *rt = runtime_of(L);
+	lua_pushinteger(L, rt->selRow + 1);
+	lua_pushinteger(L, rt->selCol + 1);
+	return 2;
+}
+
+/* overlay drawing, recorded for ui.c to replay */
+
+static ModDrawCmd *overlay_push(lua_State *L, ModDrawKind kind) {
+	ModRuntime *rt = runtime_of(L);
+	if (rt->overlayCount >= MOD_OVERLAY_MAX) return NULL;
+	ModDrawCmd *cmd = &rt->overlay[rt->overlayCount++];
+	*cmd = (ModDrawCmd) { .kind = kind };
+	return cmd;
+}
+
+static int overlay_rect(lua_State *L) {
+	ModDrawCmd *cmd = overlay_push(L, MOD_DRAW_RECT);
+	if (!cmd) return 0;
+	cmd->x = (int) luaL_checkinteger(L, 1);
+	cmd->y = (int) luaL_checkinteger(L, 2);
+	cmd->w = (int) luaL_checkinteger(L, 3);
+	cmd->h = (int) luaL_checkinteger(L, 4);
+	cmd->color = (unsigned int) luaL_checkinteger(L, 5);
+	return 0;
+}
+
+static int overlay_cell(lua_State *L) {
+	ModDrawCmd *cmd = overlay_push(L, MOD_DRAW_CELL);
+	if (!cmd) return 0;
+	cmd->y = (int) luaL_checkinteger(L, 1) - 1;
+	cmd->x = (int) luaL_checkinteger(L, 2) - 1;
+	cmd->color = (unsigned int) luaL_checkinteger(L, 3);
+	return 0;
+}
+
+static int overlay_text(lua_State *L) {
+	ModDrawCmd *cmd = overlay_push(L, MOD_DRAW_TEXT);
+	if (!cmd) return 0;
+	snprintf(cmd->text, sizeof(cmd->text), "%s", luaL_checkstring(L, 1));
+	cmd->x = (int) luaL_checkinteger(L, 2);
+	cmd->y = (int) luaL_checkinteger(L, 3);
+	cmd->size = (int) luaL_checkinteger(L, 4);
+	cmd->color = (unsigned int) luaL_checkinteger(L, 5);
+	return 0;
+}
+
+static const luaL_Reg s_sudokuLib[] = { { "cell", sudoku_cell },
+	{ "given", sudoku_given },
+	{ "selected", sudoku_selected },
+	{ NULL, NULL } };
+
+static const luaL_Reg s_overlayLib[] = { { "rect", overlay_rect },
+	{ "cell", overlay_cell },
+	{ "text", overlay_text },
+	{ NULL, NULL } };
+
+/* no io, os, package or debug, nothing that reads files and no bytecode */
+static void open_sandbox(lua_State *L) {
+	static const luaL_Reg libs[] = { { LUA_GNAME, luaopen_base },
+		{ LUA_STRLIBNAME, luaopen_string },
+		{ LUA_TABLIBNAME, luaopen_table },
+		{ LUA_MATHLIBNAME, luaopen_math },
+		{ NULL, NULL } };
+	for (const luaL_Reg *lib = libs; lib->func; lib++) {
+		luaL_requiref(L, lib->name, lib->func, 1);
+		lua_pop(L, 1);
+	}
+	lua_pushnil(L);
+	lua_setglobal(L, "dofile");
+	lua_pushnil(L);
+	lua_setglobal(L, "loadfile");
+	wrap_global(L, "pcall", guarded_pcall);
+	wrap_global(L, "xpcall", guarded_xpcall);
+	wrap_global(L, "setmetatable", guarded_setmetatable);
+	wrap_global(L, "load", text_load);
+	lua_getglobal(L, "string");
+	lua_pushnil(L);
+	lua_setfield(L, -2, "dump");
+	lua_pop(L, 1);
+	wrap_string(L, "rep", bounded_rep);
+	wrap_string(L, "find", bounded_find);
+	wrap_string(L, "match", bounded_match);
+	wrap_string(L, "gmatch", bounded_match);
+	wrap_string(L, "gsub", bounded_match);
+
+	luaL_newlib(L, s_sudokuLib);
+	lua_pushinteger(L, BOARD_SIZE);
+	lua_setfield(L, -2, "size");
+	lua_setglobal(L, "sudoku");
+	luaL_newlib(L, s_overlayLib);
+	lua_setglobal(L, "overlay");
+}
+
+/* pcall the function and nargs arguments on the stack with budgetMs to run,
+ * an error or overrun is a strike against m
+ */
+static bool mod_call(
+	ModRuntime *rt, Mod *m, int nargs, int nresults, double budgetMs) {
+	lua_State *L = rt->L;
+	double start = Profiler_Now();
+	rt->deadline = start + budgetMs / 1000.0;
+	rt->instructions = 0;
+	rt->timedOut = false;
+	rt->exhausted = false;
+
+	PROFILE_BEGIN(PROF_MODS);
+	PROFILE_COUNT(PROF_MOD_CALLS);
+	int status = lua_pcall(L, nargs, nresults, 0);
+	PROFILE_END(PROF_MODS);
+	double ms = (Profiler_Now() - start) * 1000.0;
+	rt->frameMs += ms;
+	if (status == LUA_OK) return true;
+
+	const char *err = lua_tostring(L, -1);
+	fprintf(stderr, "mod %s: %s\n", m->name, err ? err : "error");
+	lua_pop(L, 1);
+
+	/* cut short by what other hooks left over, not by its own appetite */
+	if (rt->timedOut && ms < MOD_FRAME_BUDGET_MS / 2) return false;
+	if (++m->strikes >= MOD_STRIKES) {
+		m->disabled = true;
+		fprintf(stderr, "mod %s: switched off\n", m->name);
+	}
+	return false;
+}
+
+/* push m's hook if it has one and the frame has budget left for it */
+static bool mod_hook(ModRuntime *rt, Mod *m, ModHook hook) {
+	if (m->disabled || m->hooks[hook] == LUA_NOREF) return false;
+	if (rt->frameMs >= MOD_FRAME_BUDGET_MS) {
+		PROFILE_COUNT(PROF_MOD_SKIPS);
+		return false;
+	}
+	lua_rawgeti(rt->L, LUA_REGISTRYINDEX, m->hooks[hook]);
+	return true;
+}
+
+static double frame_left(const ModRuntime *rt) {
+	return MOD_FRAME_BUDGET_MS - rt->frameMs;
+}
+
+/* rules tables, compiled into native tables once at load (see rules.h) */
+
+static RuleSet s_staged; /* g_rules plus the mod being loaded */
+
+/* the {row, col} pair at idx as a BOARD_CELL */
+static int rules_cell(lua_State *L, int idx) {
+	luaL_checktype(L, idx, LUA_TTABLE);
+	lua_geti(L, idx, 1);
+	lua_geti(L, idx, 2);
+	int r = (int) luaL_checkinteger(L, -2) - 1;
+	int c = (int) luaL_checkinteger(L, -1) - 1;
+	lua_pop(L, 2);
+	if (r < 0 || r >= BOARD_SIZE || c < 0 || c >= BOARD_SIZE)
+		luaL_error(L, "rules: cell (%d, %d) is off the board", r + 1, c + 1);
+	return BOARD_CELL(r, c);
+}
+
+/* the list of {row, col} pairs at idx */
+static int rules_cells(lua_State *L, int idx, int *cells) {
+	luaL_checktype(L, idx, LUA_TTABLE);
+	int count = (int) luaL_len(L, idx);
+	if (count > BOARD_SIZE) luaL_error(L, "rules: more than %d cells", BOARD_SIZE);
+	for (int i = 0; i < count; i++) {
+		lua_geti(L, idx, i + 1);
+		cells[i] = rules_cell(L, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+	return count;
+}
+
+/* forbid[v] of a relation: "same", "consecutive" or function(v, w) that is
+ * true when v in the first cell rules out w in the second. the function runs
+ * BOARD_SIZE^2 times here and never again
+ */
+static void rules_forbid(
+	lua_State *L, int idx, uint16_t forbid[BOARD_SIZE_MAX + 1]) {
+	memset(forbid, 0, (BOARD_SIZE_MAX + 1) * sizeof(*forbid));
+	lua_getfield(L, idx, "forbid");
+	const char *name = NULL;
+	if (lua_type(L, -1) == LUA_TSTRING) name = lua_tostring(L, -1);
+	for (int v = 1; v <= BOARD_SIZE; v++)
+		for (int w = 1; w <= BOARD_SIZE; w++) {
+			bool out;
+			if (name && strcmp(name, "same") == 0)
+				out = v == w;
+			else if (name && strcmp(name, "consecutive") == 0)
+				out = v - w == 1 || w - v == 1;
+			else if (lua_isfunction(L, -1)) {
+				lua_pushvalue(L, -1);
+				lua_pushinteger(L, v);
+				lua_pushinteger(L, w);
+				lua_call(L, 2, 1);
+				out = lua_toboolean(L, -1);
+				lua_pop(L, 1);
+			}
+			else
+				return (void) luaL_error(L, "rules: unknown forbid");
+			if (out) forbid[v] |= (uint16_t) (1u << (w - 1));
+		}
+	lua_pop(L, 1);
+}
+
+/* link every cell to the one (dr, dc) away from it */
+static void rules_offset(lua_State *L, RuleSet *rs, int rel, int dr, int dc) {
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			int r2 = r + dr, c2 = c + dc;
+			if (r2 < 0 || r2 >= BOARD_SIZE || c2 < 0 || c2 >= BOARD_SIZE)
+				continue;
+			if (!Rules_Link(rs, rel, BOARD_CELL(r, c), BOARD_CELL(r2, c2)))
+				luaL_error(L, "rules: too many links");
+		}
+}
+
+static void rules_relation(lua_State *L, RuleSet *rs, int idx) {
+	uint16_t forbid[BOARD_SIZE_MAX + 1];
+	rules_forbid(L, idx, forbid);
+	int rel = Rules_AddRelation(rs, forbid);
+	if (rel < 0) luaL_error(L, "rules: too many relations");
+
+	lua_getfield(L, idx, "offsets");
+	int offsets = lua_istable(L, -1) ? (int) luaL_len(L, -1) : 0;
+	for (int i = 1; i <= offsets; i++) {
+		lua_geti(L, -1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		lua_geti(L, -1, 1);
+		lua_geti(L, -2, 2);
+		int dr = (int) luaL_checkinteger(L, -2);
+		int dc = (int) luaL_checkinteger(L, -1);
+		lua_pop(L, 3);
+		rules_offset(L, rs, rel, dr, dc);
+	}
+	lua_pop(L, 1);
+
+	lua_getfield(L, idx, "pairs");
+	int pairs = lua_istable(L, -1) ? (int) luaL_len(L, -1) : 0;
+	for (int i = 1; i <= pairs; i++) {
+		lua_geti(L, -1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		int top = lua_gettop(L);
+		lua_geti(L, top, 1);
+		lua_geti(L, top, 2);
+		int first = rules_cell(L, top + 1), second = rules_cell(L, top + 2);
+		lua_pop(L, 3);
+		if (!Rules_Link(rs, rel, first, second))
+			luaL_error(L, "rules: bad pair %d", i);
+	}
+	lua_pop(L, 1);
+}
+
+/* protected: (lightuserdata RuleSet, rules table) */
+static int compile_rules(lua_State *L) {
+	RuleSet *rs = lua_touserdata(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int cells[BOARD_SIZE_MAX];
+
+	lua_getfield(L, 2, "regions");
+	int regions = lua_istable(L, -1) ? (int) luaL_len(L, -1) : 0;
+	for (int i = 1; i <= regions; i++) {
+		lua_geti(L, -1, i);
+		int count = rules_cells(L, lua_gettop(L), cells);
+		lua_pop(L, 1);
+		if (!Rules_AddRegion(rs, cells, count))
+			luaL_error(L, "rules: bad region %d", i);
+	}
+	lua_pop(L, 1);
+
+	lua_getfield(L, 2, "relations");
+	int relations = lua_istable(L, -1) ? (int) luaL_len(L, -1) : 0;
+	for (int i = 1; i <= relations; i++) {
+		lua_geti(L, -1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		rules_relation(L, rs, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_getfield(L, 2, "cages");
+	int cages = lua_istable(L, -1) ? (int) luaL_len(L, -1) : 0;
+	for (int i = 1; i <= cages; i++) {
+		lua_geti(L, -1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		int top = lua_gettop(L);
+		lua_getfield(L, top, "sum");
+		int sum = (int) luaL_checkinteger(L, -1);
+		lua_pop(L, 1);
+		lua_getfield(L, top, "cells");
+		int count = rules_cells(L, top + 1, cells);
+		if (!Rules_AddCage(rs, cells, count, sum))
+			luaL_error(L, "rules: bad cage %d", i);
+		lua_pop(L, 2);
+	}
+	lua_pop(L, 1);
+	return 0;
+}
+
+/* run one mod file, it has to return its table of hooks */
+static bool load_mod(ModRuntime *rt, const char *path, const char *name) {
+	lua_State *L = rt->L;
+	Mod *m = &rt->mods[rt->count];
+	*m = (Mod) { 0 };
+	snprintf(m->name, sizeof(m->name), "%.*s", (int) (strlen(name) - 4), name);
+	m->strikes = MOD_STRIKES - 1; /* a failed load is final */
+
+	if (luaL_loadfilex(L, path, "t") != LUA_OK) {
+		fprintf(stderr, "mod %s: %s\n", m->name, lua_tostring(L, -1));
+		lua_pop(L, 1);
+		return false;
+	}
+	if (!mod_call(rt, m, 0, 1, MOD_LOAD_BUDGET_MS)) return false;
+	if (!lua_istable(L, -1)) {
+		fprintf(stderr, "mod %s: must return a table of hooks\n", m->name);
+		lua_pop(L, 1);
+		return false;
+	}
+
+	/* rules go into a copy, a mod that gets them wrong adds none */
+	lua_getfield(L, -1, "rules");
+	if (!lua_isnil(L, -1)) {
+		s_staged = g_rules;
+		lua_pushcfunction(L, compile_rules);
+		lua_pushlightuserdata(L, &s_staged);
+		lua_rotate(L, -3, -1);
+		if (!mod_call(rt, m, 2, 0, MOD_LOAD_BUDGET_MS)) {
+			lua_pop(L, 1);
+			return false;
+		}
+		g_rules = s_staged;
+	}
+	else
+		lua_pop(L, 1);
+
+	for (int h = 0; h < MOD_HOOK_COUNT; h++) {
+		m->hooks[h] = LUA_NOREF;
+		lua_getfield(L, -1, s_hookNames[h]);
+		if (!lua_isfunction(L, -1)) {
+			lua_pop(L, 1);
+			continue;
+		}
+		m->hooks[h] = luaL_ref(L, LUA_REGISTRYINDEX);
+		rt->hooked |= 1u << h;
+	}
+	lua_pop(L, 1);
+	m->strikes = 0;
+	rt->count++;
+	return true;
+}
+
+static int compare_names(const void *a, const void *b) {
+	return strcmp((const char *) a, (const char *) b);
+}
+
+bool Mod_Init(ModRuntime *rt, const char *directory) {
+	*rt = (ModRuntime) { 0 };
+	Rules_Clear(&g_rules);
+
+	/* in name order, so mods can count on who runs first */
+	char names[MOD_MAX][64];
+	int found = 0;
+	DIR *dir = opendir(directory);
+	if (!dir) return false;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL && found < MOD_MAX) {
+		const char *name = entry->d_name;
+		size_t len = strlen(name);
+		if (len <= 4 || len >= sizeof(names[0])) continue;
+		if (strcmp(name + len - 4, ".lua") != 0) continue;
+		memcpy(names[found++], name, len + 1);
+	}
+	closedir(dir);
+	if (found == 0) return false;
+	qsort(names, found, sizeof(names[0]), compare_names);
+
+	rt->L = lua_newstate(mod_alloc, rt);
+	if (!rt->L) return false;
+	*(ModRuntime **) lua_getextraspace(rt->L) = rt;
+	lua_sethook(rt->L, budget_hook, LUA_MASKCOUNT, MOD_HOOK_STEP);
+	open_sandbox(rt->L);
+
+	for (int i = 0; i < found; i++) {
+		char path[MAX_FILEPATH_LEN + sizeof(names[0])];
+		snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+		load_mod(rt, path, names[i]);
+	}
+	Rules_Finish(&g_rules);
+	rt->frameMs = 0;
+	return rt->count > 0;
+}
+
+void Mod_Shutdown(ModRuntime *rt) {
+	if (rt->L) lua_close(rt->L);
+	*rt = (ModRuntime) { 0 };
+	Rules_Clear(&g_rules);
+}
+
+void Mod_FrameBegin(ModRuntime *rt) {
+	rt->frameMs = 0;
+}
+
+void Mod_OnMove(ModRuntime *rt, const Board *b, int r, int c, int v, int old) {
+	if (!Mod_Hooked(rt, MOD_HOOK_ON_MOVE)) return;
+	rt->board = b;
+	rt->selRow = r;
+	rt->selCol = c;
+	for (int i = 0; i < rt->count; i++) {
+		Mod *m = &rt->mods[i];
+		if (!mod_hook(rt, m, MOD_HOOK_ON_MOVE)) continue;
+		lua_pushinteger(rt->L, r + 1);
+		lua_pushinteger(rt->L, c + 1);
+		lua_pushinteger(rt->L, v);
+		lua_pushinteger(rt->L, old);
+		mod_call(rt, m, 4, 0, frame_left(rt));
+	}
+	rt->board = NULL;
+}
+
+bool Mod_ValidateMove(ModRuntime *rt, const Board *b, int r, int c, int v) {
+	if (!Mod_Hooked(rt, MOD_HOOK_VALIDATE_MOVE)) return true;
+	rt->board = b;
+	rt->selRow = r;
+	rt->selCol = c;
+	bool allowed = true;
+	for (int i = 0; i < rt->count && allowed; i++) {
+		Mod *m = &rt->mods[i];
+		if (!mod_hook(rt, m, MOD_HOOK_VALIDATE_MOVE)) continue;
+		lua_pushinteger(rt->L, r + 1);
+		lua_pushinteger(rt->L, c + 1);
+		lua_pushinteger(rt->L, v);
+		if (!mod_call(rt, m, 3, 1, frame_left(rt))) continue;
+
+		/* only an explicit false refuses, a hook returning nothing allows */
+		allowed = !(lua_isboolean(rt->L, -1) && !lua_toboolean(rt->L, -1));
+		lua_pop(rt->L, 1);
+	}
+	rt->board = NULL;
+	return allowed;
+}
+
+void Mod_DrawOverlay(ModRuntime *rt, const Board *b, int selRow, int selCol) {
+	if (!Mod_Hooked(rt, MOD_HOOK_ON_DRAW_OVERLAY)) return;
+	/* out of budget, the last overlay stays up */
+	if (rt->frameMs >= MOD_FRAME_BUDGET_MS) {
+		PROFILE_COUNT(PROF_MOD_SKIPS);
+		return;
+	}
+
+	rt->board = b;
+	rt->selRow = selRow;
+	rt->selCol = selCol;
+	rt->overlayCount = 0;
+	for (int i = 0; i < rt->count; i++) {
+		Mod *m = &rt->mods[i];
+		if (!mod_hook(rt, m, MOD_HOOK_ON_DRAW_OVERLAY)) continue;
+		mod_call(rt, m, 0, 0, frame_left(rt));
+	}
+	rt->board = NULL;
+}
+
+bool Mod_OnGenerate(ModRuntime *rt, Board *b, const char *difficulty) {
+	if (!Mod_Hooked(rt, MOD_HOOK_ON_GENERATE)) return false;
+
+	int cells = BOARD_SIZE * BOARD_SIZE;
+	char grid[BOARD_CELLS_MAX + 1];
+	for (int i = 0; i < cells; i++) {
+		int v = Board_Value(b, i / BOARD_SIZE, i % BOARD_SIZE);
+		grid[i] = v ? (char) ('0' + v) : '.';
+	}
+	grid[cells] = '\0';
+
+	rt->board = b;
+	bool replaced = false;
+	for (int i = 0; i < rt->count; i++) {
+		Mod *m = &rt->mods[i];
+		if (!mod_hook(rt, m, MOD_HOOK_ON_GENERATE)) continue;
+		lua_pushstring(rt->L, grid);
+		lua_pushstring(rt->L, difficulty);
+		if (!mod_call(rt, m, 2, 1, frame_left(rt))) continue;
+
+		/* each mod sees what the one before it returned */
+		lua_State *L = rt->L;
+		size_t len = 0;
+		const char *s = NULL;
+		if (lua_type(L, -1) == LUA_TSTRING) s = lua_tolstring(L, -1, &len);
+		if (s && len == (size_t) cells) {
+			memcpy(grid, s, len);
+			Board_FromString(b, grid);
+			replaced = true;
+		}
+		else if (s)
+			fprintf(stderr,
+				"mod %s: on_generate grid is not %d cells\n",
+				m->name,
+				cells);
+		lua_pop(rt->L, 1);
+	}
+	rt->board = NULL;
+	return replaced;
+}
@@ -0,0 +1,59 @@
+/* src/profiler.c
+ * frame profiler
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <string.h>
+#include <time.h>
+
+#include "profiler.h"
+
+Profiler g_profiler;
+
+double Profiler_Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void Profiler_FrameBegin(void) {
+	memset(&g_profiler.current, 0, sizeof(g_profiler.current));
+	g_profiler.depth = 0;
+	g_profiler.frameStart = Profiler_Now();
+}
+
+void Profiler_FrameEnd(void) {
+	Profiler *p = &g_profiler;
+	p->current.frameMs = (float) ((Profiler_Now() - p->frameStart) * 1000.0);
+	p->frames[p->head] = p->current;
+	p->head = (p->head + 1) % PROFILER_HISTORY;
+	if (p->count < PROFILER_HISTORY) p->count++;
+}
+
+void Profiler_Begin(ProfilePhase phase) {
+	Profiler *p = &g_profiler;
+	p->phaseStart[phase] = Profiler_Now();
+	if (p->depth < PROFILER_DEPTH) p->open[p->depth] = phase;
+	p->depth++;
+}
+
+/* phases may run more than once a frame, their times add up. a phase begun
+ * inside another one is taken out of the outer phase's time, so the phases
+ * still stack up to the frame
+ */
+void Profiler_End(ProfilePhase phase) {
+	Profiler *p = &g_profiler;
+	double ms = (Profiler_Now() - p->phaseStart[phase]) * 1000.0;
+	p->current.phaseMs[phase] += (float) ms;
+
+	if (p->depth > 0) p->depth--;
+	if (p->depth > 0 && p->depth <= PROFILER_DEPTH)
+		p->current.phaseMs[p->open[p->depth - 1]] -= (float) ms;
+}
+
+const ProfileFrame *Profiler_Frame(int ago) {
+	const Profiler *p = &g_profiler;
+	if (ago < 0 || ago >= p->count) return NULL;
+	return &p->frames[(p->head - 1 - ago + PROFILER_HISTORY) % PROFILER_HISTORY];
+}
@@ -0,0 +1,202 @@
+/* src/puzzle_cache.c
+ * puzzles directory metadata index
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "puzzle_cache.h"
+#include "puzzle_import.h"
+
+#define PUZZLE_CACHE_HEADER "# sudoku puzzle index v1"
+#define PUZZLE_CACHE_FIELDS 7
+
+static unsigned int hash_name(const char *name) {
+	/* fnv-1a */
+	unsigned int h = 2166136261u;
+	for (; *name; name++)
+		h = (h ^ (unsigned char) *name) * 16777619u;
+	return h;
+}
+
+/* split one line into tab-separated fields in place */
+static int split_fields(char *line, char *fields[PUZZLE_CACHE_FIELDS]) {
+	int n = 0;
+	fields[n++] = line;
+	for (char *p = line; *p && n < PUZZLE_CACHE_FIELDS; p++) {
+		if (*p == '\t') {
+			*p = '\0';
+			fields[n++] = p + 1;
+		}
+	}
+	return n;
+}
+
+bool PuzzleCache_Load(PuzzleCache *cache, const char *path) {
+	memset(cache, 0, sizeof(*cache));
+
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len <= 0) {
+		fclose(f);
+		return false;
+	}
+
+	cache->data = malloc(len + 1);
+	if (!cache->data) {
+		fclose(f);
+		return false;
+	}
+	len = (long) fread(cache->data, 1, len, f);
+	cache->data[len] = '\0';
+	fclose(f);
+
+	/* header, then at most one record per remaining line */
+	size_t headerLen = strlen(PUZZLE_CACHE_HEADER);
+	if (strncmp(cache->data, PUZZLE_CACHE_HEADER, headerLen) != 0) {
+		PuzzleCache_Free(cache);
+		return false;
+	}
+
+	int lines = 0;
+	for (long i = 0; i < len; i++)
+		if (cache->data[i] == '\n') lines++;
+
+	cache->records = malloc((lines + 1) * sizeof(*cache->records));
+	cache->slotCount = 16;
+	while (cache->slotCount < 2 * lines)
+		cache->slotCount *= 2;
+	cache->slots = malloc(cache->slotCount * sizeof(*cache->slots));
+	if (!cache->records || !cache->slots) {
+		PuzzleCache_Free(cache);
+		return false;
+	}
+	memset(cache->slots, 0xff, cache->slotCount * sizeof(*cache->slots));
+
+	char *line = strchr(cache->data, '\n');
+	while (line && *++line) {
+		char *end = strchr(line, '\n');
+		if (end) *end = '\0';
+
+		char *fields[PUZZLE_CACHE_FIELDS];
+		if (split_fields(line, fields) == PUZZLE_CACHE_FIELDS) {
+			PuzzleCacheRecord *r = &cache->records[cache->count];
+			r->mtime = strtoll(fields[0], NULL, 10);
+			r->size = strtoll(fields[1], NULL, 10);
+			r->clues = atoi(fields[2]);
+			r->rating = atoi(fields[3]);
+			r->name = fields[4];
+			r->title = fields[5];
+			r->author = fields[6];
+
+			unsigned int slot = hash_name(r->name) & (cache->slotCount - 1);
+			while (cache->slots[slot] >= 0)
+				slot = (slot + 1) & (cache->slotCount - 1);
+			cache->slots[slot] = cache->count++;
+		}
+		line = end;
+	}
+	return true;
+}
+
+void PuzzleCache_Free(PuzzleCache *cache) {
+	free(cache->data);
+	free(cache->records);
+	free(cache->slots);
+	memset(cache, 0, sizeof(*cache));
+}
+
+const PuzzleCacheRecord *PuzzleCache_Find(const PuzzleCache *cache, const char *name) {
+	if (!cache->slotCount) return NULL;
+
+	unsigned int mask = cache->slotCount - 1;
+	for (unsigned int slot = hash_name(name) & mask; cache->slots[slot] >= 0;
+		slot = (slot + 1) & mask) {
+		const PuzzleCacheRecord *r = &cache->records[cache->slots[slot]];
+		if (strcmp(r->name, name) == 0) return r;
+	}
+	return NULL;
+}
+
+bool PuzzleCache_Resolve(const PuzzleCache *cache,
+	const char *directory,
+	const char *name,
+	char path[MAX_FILEPATH_LEN],
+	PuzzleFileEntry *e,
+	PuzzleMetadata *meta,
+	bool *reused) {
+	if (!PuzzleImport_HasExtension(name)) return false;
+
+	snprintf(path, MAX_FILEPATH_LEN, "%s/%s", directory, name);
+	struct stat st;
+	if (stat(path, &st) != 0 || S_ISDIR(st.st_mode)) return false;
+
+	*e = (PuzzleFileEntry) { .mtime = (long long) st.st_mtime,
+		.size = (long long) st.st_size };
+	const PuzzleCacheRecord *rec = PuzzleCache_Find(cache, name);
+	*reused = rec && rec->mtime == e->mtime && rec->size == e->size;
+	if (*reused) {
+		e->clues = rec->clues;
+		e->rating = rec->rating;
+		snprintf(meta->title, sizeof(meta->title), "%s", rec->title);
+		snprintf(meta->author, sizeof(meta->author), "%s", rec->author);
+		return true;
+	}
+
+	/* new or changed, only its header is read */
+	if (!Puzzle_ReadHeader(path, meta, &e->clues)) {
+		e->clues = -1;
+		snprintf(meta->title, sizeof(meta->title), "%s", name);
+	}
+	return true;
+}
+
+/* titles and authors are free text, keep them on one field */
+static void write_field(FILE *f, const char *s) {
+	for (; *s; s++)
+		fputc(*s == '\t' || *s == '\n' || *s == '\r' ? ' ' : *s, f);
+}
+
+bool PuzzleCache_Save(const PuzzleFileList *list, const char *path) {
+	char tmpPath[MAX_FILEPATH_LEN];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+	FILE *f = fopen(tmpPath, "wb");
+	if (!f) return false;
+
+	fprintf(f, "%s\n", PUZZLE_CACHE_HEADER);
+	for (int i = 0; i < list->count; i++) {
+		const PuzzleFileEntry *e = &list->entries[i];
+		const char *filepath = PuzzleFileList_Path(list, i);
+		const char *name = strrchr(filepath, '/');
+		name = name ? name + 1 : filepath;
+
+		fprintf(f,
+			"%lld\t%lld\t%d\t%d\t",
+			e->mtime,
+			e->size,
+			e->clues,
+			e->rating);
+		write_field(f, name);
+		fputc('\t', f);
+		write_field(f, PuzzleFileList_Title(list, i));
+		fputc('\t', f);
+		write_field(f, list->strings + e->author);
+		fputc('\n', f);
+	}
+
+	bool ok = fclose(f) == 0;
+#ifdef _WIN32
+	/* rename does not replace an existing file there */
+	if (ok) remove(path);
+#endif
+	if (ok) ok = rename(tmpPath, path) == 0;
+	if (!ok) remove(tmpPath);
+	return ok;
+}
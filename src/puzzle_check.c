@@ -0,0 +1,279 @@
+/* src/puzzle_check.c
+ * collection validation pipeline
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "puzzle_check.h"
+#include "generator.h"
+#include "profiler.h"
+
+static inline int box_of(int r, int c) {
+	return (r / SUBGRID) * SUBGRID + (c / SUBGRID);
+}
+
+/* singles only solver on a grid and its unit masks (bit 1 << v) */
+typedef struct Singles {
+	uint8_t grid[BOARD_CELLS_MAX];
+	uint16_t row[BOARD_SIZE_MAX], col[BOARD_SIZE_MAX], box[BOARD_SIZE_MAX];
+	uint16_t full;
+	int empty;
+} Singles;
+
+static uint16_t singles_candidates(const Singles *s, int r, int c) {
+	if (s->grid[r * BOARD_SIZE + c]) return 0;
+	return s->full & ~(s->row[r] | s->col[c] | s->box[box_of(r, c)]);
+}
+
+static void singles_place(Singles *s, int r, int c, int v) {
+	uint16_t bit = (uint16_t) (1u << v);
+	s->grid[r * BOARD_SIZE + c] = (uint8_t) v;
+	s->row[r] |= bit;
+	s->col[c] |= bit;
+	s->box[box_of(r, c)] |= bit;
+	s->empty--;
+}
+
+static bool naked_singles(Singles *s) {
+	bool placed = false;
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			uint16_t cand = singles_candidates(s, r, c);
+			if (cand && !(cand & (cand - 1))) {
+				singles_place(s, r, c, __builtin_ctz(cand));
+				placed = true;
+			}
+		}
+	return placed;
+}
+
+/* unit u of kind 0 = rows, 1 = columns, 2 = boxes, its k-th cell */
+static void unit_cell(int kind, int u, int k, int *r, int *c) {
+	if (kind == 0) {
+		*r = u;
+		*c = k;
+	}
+	else if (kind == 1) {
+		*r = k;
+		*c = u;
+	}
+	else {
+		*r = (u / SUBGRID) * SUBGRID + k / SUBGRID;
+		*c = (u % SUBGRID) * SUBGRID + k % SUBGRID;
+	}
+}
+
+static bool hidden_singles(Singles *s) {
+	bool placed = false;
+	for (int kind = 0; kind < 3; kind++)
+		for (int u = 0; u < BOARD_SIZE; u++) {
+			/* digits seen once, then digits seen more than once */
+			uint16_t once = 0, twice = 0;
+			for (int k = 0; k < BOARD_SIZE; k++) {
+				int r, c;
+				unit_cell(kind, u, k, &r, &c);
+				uint16_t cand = singles_candidates(s, r, c);
+				twice |= once & cand;
+				once |= cand;
+			}
+			uint16_t single = once & ~twice;
+			for (int k = 0; single && k < BOARD_SIZE; k++) {
+				int r, c;
+				unit_cell(kind, u, k, &r, &c);
+				uint16_t hit = singles_candidates(s, r, c) & single;
+				if (!hit) continue;
+				singles_place(s, r, c, __builtin_ctz(hit));
+				single &= (uint16_t) ~hit;
+				placed = true;
+			}
+		}
+	return placed;
+}
+
+/* the hardest kind of single a unique puzzle needs, if singles solve it */
+static PuzzleRating rate(const Board *b) {
+	Singles s = { .full = (uint16_t) (((1u << BOARD_SIZE) - 1) << 1),
+		.empty = BOARD_SIZE * BOARD_SIZE - b->filled };
+	memcpy(s.row, b->rowMask, sizeof(s.row));
+	memcpy(s.col, b->colMask, sizeof(s.col));
+	memcpy(s.box, b->boxMask, sizeof(s.box));
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++)
+			s.grid[r * BOARD_SIZE + c] = (uint8_t) Board_Value(b, r, c);
+
+	PuzzleRating rating = RATING_EASY;
+	while (s.empty > 0) {
+		if (naked_singles(&s)) continue;
+		if (!hidden_singles(&s)) return RATING_HARD;
+		rating = RATING_MEDIUM;
+	}
+	return rating;
+}
+
+/* every stage but dedup, for one line */
+static uint8_t check_puzzle(const char *line) {
+	Board b;
+	Board_FromString(&b, line);
+
+	BoardSet conflicts, noteConflicts[BOARD_SIZE_MAX];
+	Board_FindConflicts(&b, &conflicts, noteConflicts);
+	if (BoardSet_Any(conflicts)) return CHECK_DONE | CHECK_CONFLICT;
+
+	int solutions = Generator_CountSolutions(&b, 2);
+	if (solutions == 0) return CHECK_DONE | CHECK_UNSOLVABLE;
+	if (solutions > 1) return CHECK_DONE | CHECK_MULTIPLE;
+	return (uint8_t) (CHECK_DONE | rate(&b) << CHECK_RATING_SHIFT);
+}
+
+/* lines compare by their cells, . and 0 are both blank */
+static uint64_t line_hash(const char *line, int cells) {
+	uint64_t h = 14695981039346656037ull;
+	for (int i = 0; i < cells; i++) {
+		char ch = line[i] >= '1' && line[i] <= '9' ? line[i] : '0';
+		h = (h ^ (uint8_t) ch) * 1099511628211ull;
+	}
+	return h;
+}
+
+static bool same_givens(const char *a, const char *b, int cells) {
+	for (int i = 0; i < cells; i++) {
+		char x = a[i] >= '1' && a[i] <= '9' ? a[i] : '0';
+		char y = b[i] >= '1' && b[i] <= '9' ? b[i] : '0';
+		if (x != y) return false;
+	}
+	return true;
+}
+
+/* flag every puzzle whose givens appeared earlier, open addressing over
+ * puzzle numbers + 1 so 0 marks a free slot
+ */
+static void dedup(PuzzleCollection *c) {
+	int cells = BOARD_SIZE * BOARD_SIZE;
+	size_t size = 1024;
+	while (size < (size_t) c->count * 2)
+		size *= 2;
+	uint32_t *table = calloc(size, sizeof(*table));
+	if (!table) return;
+
+	for (int i = 0; i < c->count; i++) {
+		const char *line = PuzzleCollection_Line(c, i);
+		size_t slot = line_hash(line, cells) & (size - 1);
+		for (; table[slot]; slot = (slot + 1) & (size - 1)) {
+			int other = (int) table[slot] - 1;
+			const char *otherLine = PuzzleCollection_Line(c, other);
+			if (same_givens(line, otherLine, cells)) break;
+		}
+		uint8_t flag = CHECK_DUPLICATE;
+		if (table[slot])
+			__atomic_or_fetch(&c->checks[i], flag, __ATOMIC_RELAXED);
+		else
+			table[slot] = (uint32_t) i + 1;
+	}
+	free(table);
+}
+
+/* the stage that needs every puzzle, then the results go to the index */
+static void finish(PuzzleCheck *check) {
+	if (!__atomic_load_n(&check->cancel, __ATOMIC_ACQUIRE)) {
+		dedup(check->collection);
+		PuzzleCollection_SaveIndex(check->collection);
+		check->seconds = Profiler_Now() - check->started;
+	}
+	__atomic_store_n(&check->done, 1, __ATOMIC_RELEASE);
+}
+
+static void *check_worker(void *arg) {
+	PuzzleCheck *check = arg;
+	PuzzleCollection *c = check->collection;
+
+	const int chunk = PUZZLE_CHECK_CHUNK;
+	for (;;) {
+		if (__atomic_load_n(&check->cancel, __ATOMIC_ACQUIRE)) break;
+		int first = __atomic_fetch_add(&check->next, chunk, __ATOMIC_RELAXED);
+		if (first >= c->count) break;
+
+		/* cancel is seen per puzzle, Cancel waits on the render thread */
+		int end = first + chunk < c->count ? first + chunk : c->count;
+		int i = first;
+		for (; i < end; i++) {
+			if (__atomic_load_n(&check->cancel, __ATOMIC_ACQUIRE)) break;
+			uint8_t result = check_puzzle(PuzzleCollection_Line(c, i));
+			__atomic_store_n(&c->checks[i], result, __ATOMIC_RELAXED);
+		}
+		__atomic_add_fetch(&check->checked, i - first, __ATOMIC_RELAXED);
+	}
+
+	/* the last one out finishes */
+	if (__atomic_sub_fetch(&check->active, 1, __ATOMIC_ACQ_REL) == 0)
+		finish(check);
+	return NULL;
+}
+
+/* leave a core for the render loop */
+static int worker_count(void) {
+	long cpus = 2;
+#ifdef _SC_NPROCESSORS_ONLN
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (cpus < 2) return 1;
+	return cpus - 1 < PUZZLE_CHECK_THREADS_MAX ? (int) cpus - 1
+						   : PUZZLE_CHECK_THREADS_MAX;
+}
+
+void PuzzleCheck_Start(PuzzleCheck *check, PuzzleCollection *c) {
+	if (check->running) PuzzleCheck_Cancel(check);
+
+	*check = (PuzzleCheck) { .collection = c, .started = Profiler_Now() };
+	if (c->checked) {
+		check->checked = c->count;
+		return;
+	}
+
+	int n = worker_count();
+	check->active = n;
+	for (int i = 0; i < n; i++) {
+		if (pthread_create(&check->threads[i], NULL, check_worker, check) == 0) {
+			check->threadCount++;
+			continue;
+		}
+		/* run with the workers we got, or finish here if they already did.
+		 * with none nothing was checked, and the index must not say otherwise
+		 */
+		int left = __atomic_sub_fetch(&check->active, n - i, __ATOMIC_ACQ_REL);
+		if (left == 0 && i > 0) finish(check);
+		break;
+	}
+	check->running = check->threadCount > 0;
+}
+
+bool PuzzleCheck_Poll(PuzzleCheck *check) {
+	if (!check->running) return false;
+	if (!__atomic_load_n(&check->done, __ATOMIC_ACQUIRE)) return true;
+
+	for (int i = 0; i < check->threadCount; i++)
+		pthread_join(check->threads[i], NULL);
+	check->running = false;
+	return false;
+}
+
+void PuzzleCheck_Cancel(PuzzleCheck *check) {
+	if (!check->running) return;
+	__atomic_store_n(&check->cancel, 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < check->threadCount; i++)
+		pthread_join(check->threads[i], NULL);
+	check->running = false;
+}
+
+int PuzzleCheck_Progress(const PuzzleCheck *check) {
+	return __atomic_load_n(&check->checked, __ATOMIC_RELAXED);
+}
+
+double PuzzleCheck_Rate(const PuzzleCheck *check) {
+	double seconds
+		= check->running ? Profiler_Now() - check->started : check->seconds;
+	return seconds > 0 ? PuzzleCheck_Progress(check) / seconds : 0;
+}
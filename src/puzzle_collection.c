@@ -0,0 +1,244 @@
+/* src/puzzle_collection.c
+ * bulk one-puzzle-per-line collections
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "puzzle_collection.h"
+#include "rules.h"
+
+#define INDEX_MAGIC "SDKIDX2"
+
+/* smaller files are walked again on every open, a sidecar is not worth it */
+#define INDEX_MIN_SIZE (1 << 20)
+
+/* <file>.idx layout, native byte order since it never leaves the machine:
+ * this header, then count uint64 line offsets if stride is 0, then count
+ * check bytes if checked is set. the checks only hold under the rule set
+ * they were made with, older indexes wrote 0 there which is plain sudoku
+ */
+typedef struct IndexHeader {
+	char magic[8];
+	uint64_t size; /* of the collection when indexed */
+	int64_t mtime;
+	uint64_t stride;
+	uint32_t cells; /* BOARD_SIZE^2 the lines were checked against */
+	int32_t count;
+	uint32_t checked;
+	uint32_t rules; /* rules_key() the checks were made under */
+} IndexHeader;
+
+/* the variant rules in play folded to 32 bits, 0 for plain sudoku */
+static uint32_t rules_key(void) {
+	const RuleSet *rules = Rules_Active();
+	if (!rules) return 0;
+	uint32_t key = (uint32_t) (rules->hash ^ rules->hash >> 32);
+	return key ? key : 1;
+}
+
+static bool load_index(PuzzleCollection *c, const char *indexPath) {
+	FILE *f = fopen(indexPath, "rb");
+	if (!f) return false;
+
+	IndexHeader h;
+	bool ok = fread(&h, sizeof(h), 1, f) == 1
+		&& memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) == 0
+		&& h.size == (uint64_t) c->file.size && h.mtime == (int64_t) c->file.mtime
+		&& h.cells == (uint32_t) (BOARD_SIZE * BOARD_SIZE) && h.count > 0;
+	if (ok && h.stride == 0) {
+		c->offsets = malloc((size_t) h.count * sizeof(*c->offsets));
+		ok = c->offsets && fread(c->offsets, sizeof(*c->offsets), h.count, f)
+			== (size_t) h.count;
+	}
+	/* checks from other rules are dropped, the lines still count as indexed */
+	if (ok && h.checked && h.rules == rules_key()) {
+		c->checks = malloc((size_t) h.count);
+		ok = c->checks && fread(c->checks, 1, h.count, f) == (size_t) h.count;
+		c->checked = ok;
+	}
+	fclose(f);
+	if (!ok) {
+		free(c->offsets);
+		free(c->checks);
+		c->offsets = NULL;
+		c->checks = NULL;
+		c->checked = false;
+		return false;
+	}
+
+	c->count = h.count;
+	c->stride = h.stride;
+
+	/* the last line must still fit, the rest follow from the size match */
+	size_t cells = (size_t) (BOARD_SIZE * BOARD_SIZE);
+	const char *end = c->file.data + c->file.size;
+	if (PuzzleCollection_Line(c, c->count - 1) + cells > end) {
+		free(c->offsets);
+		free(c->checks);
+		c->offsets = NULL;
+		c->checks = NULL;
+		c->checked = false;
+		c->count = 0;
+		return false;
+	}
+	return true;
+}
+
+static bool add_offset(PuzzleCollection *c, int *capacity, uint64_t offset) {
+	if (c->count == *capacity) {
+		int cap = *capacity ? *capacity * 2 : 4096;
+		uint64_t *offsets = realloc(c->offsets, (size_t) cap * sizeof(*offsets));
+		if (!offsets) return false;
+		c->offsets = offsets;
+		*capacity = cap;
+	}
+	c->offsets[c->count++] = offset;
+	return true;
+}
+
+/* irregular after all, spell out the lines so far */
+static bool expand_stride(PuzzleCollection *c, int *capacity) {
+	int n = c->count;
+	uint64_t stride = c->stride;
+	c->count = 0;
+	c->stride = 0;
+	for (int i = 0; i < n; i++)
+		if (!add_offset(c, capacity, (uint64_t) i * stride)) return false;
+	return true;
+}
+
+/* one pass over the file. offsets are only stored once a line breaks the
+ * stride of the first one, so a uniform collection never allocates
+ */
+static bool build_index(PuzzleCollection *c) {
+	size_t cells = (size_t) (BOARD_SIZE * BOARD_SIZE);
+	const char *p = c->file.data, *end = c->file.data + c->file.size;
+	int capacity = 0;
+
+	while (p < end) {
+		const char *nl = memchr(p, '\n', (size_t) (end - p));
+		const char *next = nl ? nl + 1 : end;
+		size_t len = (size_t) ((nl ? nl : end) - p);
+		if (len > 0 && p[len - 1] == '\r') len--;
+
+		if (len >= cells && Puzzle_IsCellLine(p, cells)
+			&& (len == cells || isspace((unsigned char) p[cells]))) {
+			uint64_t offset = (uint64_t) (p - c->file.data);
+			if (c->count == 0 && offset == 0)
+				c->stride = (uint64_t) (next - p);
+
+			bool regular = offset == (uint64_t) c->count * c->stride;
+			if (c->stride && !regular && !expand_stride(c, &capacity))
+				return false;
+			if (c->stride)
+				c->count++;
+			else if (!add_offset(c, &capacity, offset))
+				return false;
+		}
+		p = next;
+	}
+	return c->count > 0;
+}
+
+static bool save_index(const PuzzleCollection *c, const char *indexPath) {
+	char tmpPath[MAX_FILEPATH_LEN + 8];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", indexPath);
+
+	FILE *f = fopen(tmpPath, "wb");
+	if (!f) return false;
+
+	IndexHeader h = { .size = (uint64_t) c->file.size,
+		.mtime = (int64_t) c->file.mtime,
+		.stride = c->stride,
+		.cells = (uint32_t) (BOARD_SIZE * BOARD_SIZE),
+		.count = c->count,
+		.checked = c->checked,
+		.rules = rules_key() };
+	memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	if (ok && c->stride == 0) {
+		size_t n = (size_t) c->count;
+		ok = fwrite(c->offsets, sizeof(*c->offsets), n, f) == n;
+	}
+	if (ok && c->checked) ok = fwrite(c->checks, 1, c->count, f) == (size_t) c->count;
+	ok = fclose(f) == 0 && ok;
+
+#ifdef _WIN32
+	/* rename does not replace an existing file there */
+	if (ok) remove(indexPath);
+#endif
+	/* an unwritable directory only costs the next open another pass */
+	if (ok && rename(tmpPath, indexPath) == 0) return true;
+	remove(tmpPath);
+	return false;
+}
+
+static void index_path(const PuzzleCollection *c, char *out, size_t size) {
+	snprintf(out, size, "%s%s", c->path, PUZZLE_COLLECTION_INDEX_EXT);
+}
+
+bool PuzzleCollection_Open(PuzzleCollection *c, const char *path) {
+	memset(c, 0, sizeof(*c));
+
+	if (!MappedFile_Open(&c->file, path)) return false;
+
+	snprintf(c->path, sizeof(c->path), "%s", path);
+	const char *name = strrchr(path, '/');
+	snprintf(c->name, sizeof(c->name), "%s", name ? name + 1 : path);
+
+	char indexPath[MAX_FILEPATH_LEN + sizeof(PUZZLE_COLLECTION_INDEX_EXT)];
+	index_path(c, indexPath, sizeof(indexPath));
+	bool indexed = load_index(c, indexPath);
+
+	if (!indexed && !build_index(c)) {
+		PuzzleCollection_Close(c);
+		return false;
+	}
+	if (!c->checks) c->checks = calloc((size_t) c->count, 1);
+	if (!c->checks) {
+		PuzzleCollection_Close(c);
+		return false;
+	}
+	if (!indexed && c->file.size >= INDEX_MIN_SIZE) save_index(c, indexPath);
+	return true;
+}
+
+bool PuzzleCollection_SaveIndex(PuzzleCollection *c) {
+	char indexPath[MAX_FILEPATH_LEN + sizeof(PUZZLE_COLLECTION_INDEX_EXT)];
+	index_path(c, indexPath, sizeof(indexPath));
+
+	/* worth keeping whatever the size, checking costs far more than indexing */
+	c->checked = true;
+	return save_index(c, indexPath);
+}
+
+void PuzzleCollection_Close(PuzzleCollection *c) {
+	MappedFile_Close(&c->file);
+	free(c->offsets);
+	free(c->checks);
+	memset(c, 0, sizeof(*c));
+}
+
+const char *PuzzleCollection_Line(const PuzzleCollection *c, int index) {
+	uint64_t offset = c->stride ? (uint64_t) index * c->stride : c->offsets[index];
+	return c->file.data + offset;
+}
+
+bool PuzzleCollection_Get(const PuzzleCollection *c, int index, Puzzle *puzzle) {
+	if (index < 0 || index >= c->count) return false;
+
+	memset(puzzle, 0, sizeof(*puzzle));
+	snprintf(puzzle->meta.title,
+		sizeof(puzzle->meta.title),
+		"%s #%d",
+		c->name,
+		index + 1);
+	strcpy(puzzle->meta.author, "unknown");
+
+	/* Board_FromString stops after BOARD_SIZE^2 cells, the line needs no end */
+	Board_FromString(&puzzle->board, PuzzleCollection_Line(c, index));
+	return true;
+}
@@ -0,0 +1,498 @@
+/* src/puzzle_import.c
+ * format detection and the built in importers
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "puzzle_import.h"
+
+StrView StrView_NextLine(StrView *rest) {
+	const char *nl = memchr(rest->s, '\n', rest->len);
+	size_t len = nl ? (size_t) (nl - rest->s) : rest->len;
+	StrView line = { rest->s, len };
+	if (len && line.s[len - 1] == '\r') line.len--;
+
+	size_t skip = nl ? len + 1 : len;
+	rest->s += skip;
+	rest->len -= skip;
+	return line;
+}
+
+StrView StrView_Trim(StrView v) {
+	while (v.len && isspace((unsigned char) v.s[0])) {
+		v.s++;
+		v.len--;
+	}
+	while (v.len && isspace((unsigned char) v.s[v.len - 1]))
+		v.len--;
+	return v;
+}
+
+bool StrView_StartsWith(StrView v, const char *prefix) {
+	size_t n = strlen(prefix);
+	return v.len >= n && memcmp(v.s, prefix, n) == 0;
+}
+
+/* offset of needle in v, v.len if it is not there */
+static size_t sv_find(StrView v, const char *needle) {
+	size_t n = strlen(needle);
+	for (size_t i = 0; i + n <= v.len;) {
+		const char *p = memchr(v.s + i, needle[0], v.len - i - n + 1);
+		if (!p) break;
+		i = (size_t) (p - v.s);
+		if (memcmp(p, needle, n) == 0) return i;
+		i++;
+	}
+	return v.len;
+}
+
+static StrView sv_skip(StrView v, size_t n) {
+	if (n > v.len) n = v.len;
+	return (StrView) { v.s + n, v.len - n };
+}
+
+/* first line that is not blank, trimmed */
+static StrView first_line(StrView text) {
+	while (text.len) {
+		StrView line = StrView_Trim(StrView_NextLine(&text));
+		if (line.len) return line;
+	}
+	return (StrView) { text.s, 0 };
+}
+
+static void copy_field(char *dst, size_t size, StrView v) {
+	v = StrView_Trim(v);
+	size_t n = v.len < size - 1 ? v.len : size - 1;
+	memcpy(dst, v.s, n);
+	dst[n] = '\0';
+}
+
+static void puzzle_init(Puzzle *p) {
+	memset(p, 0, sizeof(*p));
+	strcpy(p->meta.title, "untitled");
+	strcpy(p->meta.author, "unknown");
+}
+
+static int cell_count(void) {
+	return BOARD_SIZE * BOARD_SIZE;
+}
+
+/* a whole board on one line, as bulk collections store them */
+static bool is_board_line(StrView line) {
+	size_t cells = (size_t) cell_count();
+	return line.len >= cells && Puzzle_IsCellLine(line.s, cells)
+		&& (line.len == cells || isspace((unsigned char) line.s[cells]));
+}
+
+/* the first BOARD_SIZE chars of s as givens, anything but 1-9 is a blank */
+static void set_row(Board *b, int r, const char *s) {
+	for (int c = 0; c < BOARD_SIZE; c++) {
+		char ch = s[c];
+		int v = (ch >= '1' && ch <= '9') ? ch - '0' : 0;
+		Board_Set(b, r, c, v, true);
+	}
+}
+
+/* native: title/author lines in any order, the board as rows or one line */
+
+static bool take_meta(StrView line, const char *key, char *value, size_t size) {
+	if (!StrView_StartsWith(line, key)) return false;
+	line = sv_skip(line, strlen(key));
+	if (line.len && line.s[0] == ':') line = sv_skip(line, 1);
+	copy_field(value, size, line);
+	return true;
+}
+
+static int native_detect(StrView text) {
+	(void) text;
+	return 10; /* the fallback */
+}
+
+static int native_parse(StrView text, PuzzleImportFn emit, void *user) {
+	Puzzle p;
+	puzzle_init(&p);
+	int row = 0;
+
+	while (text.len) {
+		StrView line = StrView_Trim(StrView_NextLine(&text));
+		if (!line.len) continue;
+
+		if (take_meta(line, "title", p.meta.title, MAX_PUZZLE_TITLE)) continue;
+		if (take_meta(line, "author", p.meta.author, MAX_PUZZLE_AUTHOR)) continue;
+
+		/* a one-line board fills every row at once */
+		if (row == 0 && is_board_line(line)) {
+			Board_FromString(&p.board, line.s);
+			row = BOARD_SIZE;
+		}
+		else if (line.len >= (size_t) BOARD_SIZE && row < BOARD_SIZE)
+			set_row(&p.board, row++, line.s);
+	}
+
+	if (row != BOARD_SIZE) return 0;
+	emit(&p, user);
+	return 1;
+}
+
+/* sdk: #A author, #D description (used as the title), other # fields are
+ * skipped. the rows may sit under [Puzzle], and a [State] section after them
+ * holds the digits entered so far
+ */
+
+static int sdk_detect(StrView text) {
+	StrView line = first_line(text);
+	if (StrView_StartsWith(line, "[Puzzle]")) return 60;
+	if (line.len >= 2 && line.s[0] == '#' && isalpha((unsigned char) line.s[1]))
+		return 60;
+	return 0;
+}
+
+static int sdk_parse(StrView text, PuzzleImportFn emit, void *user) {
+	Puzzle p;
+	puzzle_init(&p);
+	int row = 0, stateRow = 0;
+	bool state = false;
+
+	while (text.len) {
+		StrView line = StrView_Trim(StrView_NextLine(&text));
+		if (!line.len) continue;
+
+		if (line.s[0] == '#') {
+			if (line.len < 2) continue;
+			StrView value = sv_skip(line, 2);
+			if (line.s[1] == 'A')
+				copy_field(p.meta.author, MAX_PUZZLE_AUTHOR, value);
+			else if (line.s[1] == 'D')
+				copy_field(p.meta.title, MAX_PUZZLE_TITLE, value);
+			continue;
+		}
+		if (line.s[0] == '[') {
+			state = StrView_StartsWith(line, "[State]");
+			continue;
+		}
+		if (line.len < (size_t) BOARD_SIZE) continue;
+
+		if (!state && row == 0 && is_board_line(line)) {
+			Board_FromString(&p.board, line.s);
+			row = BOARD_SIZE;
+		}
+		else if (!state && row < BOARD_SIZE)
+			set_row(&p.board, row++, line.s);
+		else if (state && stateRow < BOARD_SIZE) {
+			for (int c = 0; c < BOARD_SIZE; c++) {
+				char ch = line.s[c];
+				if (ch < '1' || ch > '9') continue;
+				if (Board_IsGiven(&p.board, stateRow, c)) continue;
+				Board_Set(&p.board, stateRow, c, ch - '0', false);
+			}
+			stateRow++;
+		}
+	}
+
+	if (row != BOARD_SIZE) return 0;
+	emit(&p, user);
+	return 1;
+}
+
+/* sdm: every line holding a whole board is a puzzle, the rest is skipped */
+
+static int sdm_detect(StrView text) {
+	return is_board_line(first_line(text)) ? 70 : 0;
+}
+
+static int sdm_parse(StrView text, PuzzleImportFn emit, void *user) {
+	Puzzle p;
+	puzzle_init(&p);
+	int n = 0;
+
+	while (text.len) {
+		StrView line = StrView_Trim(StrView_NextLine(&text));
+		if (!is_board_line(line)) continue;
+
+		Board_FromString(&p.board, line.s);
+		n++;
+		if (!emit(&p, user)) break;
+	}
+	return n;
+}
+
+/* ss: grids drawn with | between boxes and *, -, + borders. a row is either
+ * BOARD_SIZE cell chars ("..7|...|3..") or BOARD_SIZE whitespace separated
+ * cells ("| 1479 3  28 |..."), where one digit is a value and several are
+ * pencil marks. the first grid is the givens, later ones the current state
+ */
+
+typedef struct SsRow {
+	uint8_t value[BOARD_SIZE_MAX];
+	uint16_t notes[BOARD_SIZE_MAX]; /* bit 1<<v, as Board_SetNotes takes */
+} SsRow;
+
+static bool ss_cell(StrView token, uint8_t *value, uint16_t *notes) {
+	*value = 0;
+	*notes = 0;
+	for (size_t i = 0; i < token.len; i++) {
+		char ch = token.s[i];
+		if (ch >= '1' && ch <= '9')
+			*notes |= (uint16_t) (1u << (ch - '0'));
+		else if (ch != '.' && ch != '0')
+			return false;
+	}
+	if (token.len == 1 && *notes) {
+		*value = (uint8_t) (token.s[0] - '0');
+		*notes = 0;
+	}
+	return true;
+}
+
+static bool ss_separator(char ch) {
+	return ch == '|' || isspace((unsigned char) ch);
+}
+
+/* the next token of line from *i on, empty at the end */
+static StrView ss_token(StrView line, size_t *i) {
+	while (*i < line.len && ss_separator(line.s[*i]))
+		(*i)++;
+	size_t start = *i;
+	while (*i < line.len && !ss_separator(line.s[*i]))
+		(*i)++;
+	return (StrView) { line.s + start, *i - start };
+}
+
+static bool ss_row(StrView line, SsRow *row) {
+	int tokens = 0;
+	size_t chars = 0;
+	for (size_t i = 0;;) {
+		StrView token = ss_token(line, &i);
+		if (!token.len) break;
+		tokens++;
+		chars += token.len;
+	}
+
+	/* one token per cell */
+	if (tokens == BOARD_SIZE) {
+		size_t i = 0;
+		for (int c = 0; c < BOARD_SIZE; c++)
+			if (!ss_cell(ss_token(line, &i), &row->value[c], &row->notes[c]))
+				return false;
+		return true;
+	}
+
+	/* one char per cell, spaces and | only group them */
+	if (chars != (size_t) BOARD_SIZE) return false;
+	int c = 0;
+	for (size_t i = 0; i < line.len; i++) {
+		if (ss_separator(line.s[i])) continue;
+		StrView cell = { line.s + i, 1 };
+		if (!ss_cell(cell, &row->value[c], &row->notes[c])) return false;
+		c++;
+	}
+	return true;
+}
+
+static bool ss_border(StrView line) {
+	for (size_t i = 0; i < line.len; i++)
+		if (!strchr("*-+| \t", line.s[i])) return false;
+	return true;
+}
+
+static int ss_detect(StrView text) {
+	StrView line = first_line(text);
+	if (StrView_StartsWith(line, "*-")) return 80;
+
+	SsRow row;
+	if (memchr(line.s, '|', line.len) && ss_row(line, &row)) return 80;
+	return 0;
+}
+
+static int ss_parse(StrView text, PuzzleImportFn emit, void *user) {
+	Puzzle p;
+	puzzle_init(&p);
+	int rows = 0; /* across all grids */
+
+	while (text.len) {
+		StrView line = StrView_Trim(StrView_NextLine(&text));
+		SsRow row;
+		if (!line.len || ss_border(line) || !ss_row(line, &row)) continue;
+
+		int r = rows % BOARD_SIZE;
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			if (rows < BOARD_SIZE) {
+				Board_Set(&p.board, r, c, row.value[c], true);
+				continue;
+			}
+			if (Board_IsGiven(&p.board, r, c)) continue;
+			Board_Set(&p.board, r, c, row.value[c], false);
+			Board_SetNotes(&p.board, r, c, row.notes[c]);
+		}
+		rows++;
+	}
+
+	if (rows < BOARD_SIZE) return 0;
+	emit(&p, user);
+	return 1;
+}
+
+/* opensudoku: <name>/<author> elements or <folder name="..."> name the
+ * puzzles, each <game data="..."/> is one. games are titled "<name> #n"
+ */
+
+static StrView xml_attribute(StrView tag, const char *name) {
+	char key[32];
+	snprintf(key, sizeof(key), " %s=\"", name);
+	size_t at = sv_find(tag, key);
+	if (at == tag.len) return (StrView) { tag.s, 0 };
+
+	StrView value = sv_skip(tag, at + strlen(key));
+	const char *end = memchr(value.s, '"', value.len);
+	value.len = end ? (size_t) (end - value.s) : 0;
+	return value;
+}
+
+/* copy_field for xml text, with the predefined entities decoded */
+static void xml_copy(char *dst, size_t size, StrView v) {
+	static const char *const entities[][2] = { { "&amp;", "&" }, { "&lt;", "<" },
+		{ "&gt;", ">" }, { "&quot;", "\"" }, { "&apos;", "'" } };
+	v = StrView_Trim(v);
+	size_t n = 0;
+	while (v.len && n + 1 < size) {
+		size_t k = 0, count = sizeof(entities) / sizeof(entities[0]);
+		while (k < count && !StrView_StartsWith(v, entities[k][0]))
+			k++;
+		if (k < count) {
+			dst[n++] = entities[k][1][0];
+			v = sv_skip(v, strlen(entities[k][0]));
+		}
+		else {
+			dst[n++] = v.s[0];
+			v = sv_skip(v, 1);
+		}
+	}
+	dst[n] = '\0';
+}
+
+static int xml_detect(StrView text) {
+	return sv_find(text, "<opensudoku") < text.len ? 100 : 0;
+}
+
+static int xml_parse(StrView text, PuzzleImportFn emit, void *user) {
+	char name[MAX_PUZZLE_TITLE - 16] = "opensudoku";
+	char author[MAX_PUZZLE_AUTHOR] = "unknown";
+	size_t cells = (size_t) cell_count();
+	int n = 0;
+
+	for (;;) {
+		const char *open = memchr(text.s, '<', text.len);
+		if (!open) break;
+		text = sv_skip(text, (size_t) (open - text.s) + 1);
+		const char *close = memchr(text.s, '>', text.len);
+		if (!close) break;
+		StrView tag = { text.s, (size_t) (close - text.s) };
+		text = sv_skip(text, tag.len + 1);
+
+		/* element text runs up to the next tag */
+		const char *next = memchr(text.s, '<', text.len);
+		StrView body = { text.s, next ? (size_t) (next - text.s) : text.len };
+
+		if (StrView_StartsWith(tag, "name"))
+			xml_copy(name, sizeof(name), body);
+		else if (StrView_StartsWith(tag, "author"))
+			xml_copy(author, sizeof(author), body);
+		else if (StrView_StartsWith(tag, "folder ")) {
+			StrView folder = xml_attribute(tag, "name");
+			if (folder.len) xml_copy(name, sizeof(name), folder);
+		}
+		else if (StrView_StartsWith(tag, "game ")) {
+			StrView data = xml_attribute(tag, "data");
+			if (data.len < cells || !Puzzle_IsCellLine(data.s, cells))
+				continue;
+
+			Puzzle p;
+			puzzle_init(&p);
+			snprintf(p.meta.title,
+				sizeof(p.meta.title),
+				"%s #%d",
+				name,
+				n + 1);
+			snprintf(p.meta.author, sizeof(p.meta.author), "%s", author);
+			Board_FromString(&p.board, data.s);
+			n++;
+			if (!emit(&p, user)) break;
+		}
+	}
+	return n;
+}
+
+static const PuzzleImporter builtins[] = {
+	{ "opensudoku", ".opensudoku .xml", xml_detect, xml_parse },
+	{ "ss", ".ss", ss_detect, ss_parse },
+	{ "sdm", ".sdm", sdm_detect, sdm_parse },
+	{ "sdk", ".sdk", sdk_detect, sdk_parse },
+	{ "native", ".txt", native_detect, native_parse },
+};
+
+static const PuzzleImporter *registered[PUZZLE_IMPORTERS_MAX];
+static int registeredCount;
+
+bool PuzzleImport_Register(const PuzzleImporter *importer) {
+	if (registeredCount == PUZZLE_IMPORTERS_MAX) return false;
+	registered[registeredCount++] = importer;
+	return true;
+}
+
+/* registered importers come first so they win ties */
+static const PuzzleImporter *importer_at(int i) {
+	return i < registeredCount ? registered[i] : &builtins[i - registeredCount];
+}
+
+static int importer_count(void) {
+	return registeredCount + (int) (sizeof(builtins) / sizeof(builtins[0]));
+}
+
+const PuzzleImporter *PuzzleImport_Detect(StrView text) {
+	StrView probe = { text.s, text.len < PUZZLE_IMPORT_PROBE ? text.len
+								 : PUZZLE_IMPORT_PROBE };
+	const PuzzleImporter *best = NULL;
+	int bestScore = 0;
+	for (int i = 0; i < importer_count(); i++) {
+		const PuzzleImporter *imp = importer_at(i);
+		int score = imp->detect(probe);
+		if (score > bestScore) {
+			best = imp;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+bool PuzzleImport_HasExtension(const char *name) {
+	const char *dot = strrchr(name, '.');
+	if (!dot) return false;
+	size_t len = strlen(dot);
+
+	for (int i = 0; i < importer_count(); i++) {
+		const char *ext = importer_at(i)->extensions;
+		while (ext && *ext) {
+			size_t n = strcspn(ext, " ");
+			if (n == len && memcmp(ext, dot, n) == 0) return true;
+			ext += n;
+			ext += strspn(ext, " ");
+		}
+	}
+	return false;
+}
+
+int PuzzleImport_Parse(StrView text, PuzzleImportFn emit, void *user) {
+	const PuzzleImporter *imp = PuzzleImport_Detect(text);
+	return imp ? imp->parse(text, emit, user) : 0;
+}
+
+static bool take_first(const Puzzle *puzzle, void *user) {
+	*(Puzzle *) user = *puzzle;
+	return false;
+}
+
+bool PuzzleImport_First(StrView text, Puzzle *puzzle) {
+	return PuzzleImport_Parse(text, take_first, puzzle) > 0;
+}
@@ -1,191 +1,626 @@
 /* src/puzzle_loader.c
- * load and parse the puzzle file format (ex. lol.txt)
+ * load puzzle files through the importers, and the puzzle file list
  */
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <dirent.h>
-#include <sys/stat.h>
 
 #include "puzzle_loader.h"
+#include "mapped_file.h"
+#include "puzzle_cache.h"
+#include "puzzle_import.h"
+#include "puzzle_record.h"
 
-/* trim whitespace */
-static void trim(char *str) {
-	if (!str || !*str) return;
+#define SWAR_ONES 0x0101010101010101ull
+#define SWAR_HIGH 0x8080808080808080ull
 
-	/* leading */
-	char *start = str;
-	while (*start && isspace((unsigned char) *start))
-		start++;
+/* high bit of every byte of w in [lo, hi], for lo, hi < 0x80. no byte borrows
+ * from its neighbour: (b | 0x80) - lo and (hi | 0x80) - (b & 0x7f) never go
+ * negative, and bytes >= 0x80 are masked out by ~w
+ */
+static uint64_t swar_in_range(uint64_t w, unsigned lo, unsigned hi) {
+	uint64_t ge = (w | SWAR_HIGH) - SWAR_ONES * lo;
+	uint64_t le = SWAR_ONES * (hi | 0x80) - (w & ~SWAR_HIGH);
+	return ge & le & ~w & SWAR_HIGH;
+}
 
-	/* trailing */
-	char *end = start + strlen(start) - 1;
-	while (end > start && isspace((unsigned char) *end))
-		end--;
-	*(end + 1) = '\0';
+bool Puzzle_IsCellLine(const char *line, size_t n) {
+	/* eight cells per step */
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, line + i, sizeof(w));
+		uint64_t ok = swar_in_range(w, '0', '9') | swar_in_range(w, '.', '.');
+		if (ok != SWAR_HIGH) return false;
+	}
+	for (; i < n; i++)
+		if (!((line[i] >= '0' && line[i] <= '9') || line[i] == '.')) return false;
+	return true;
+}
 
-	if (start != str) memmove(str, start, strlen(start) + 1);
+bool Puzzle_LoadFromString(Puzzle *puzzle, const char *data) {
+	if (!puzzle || !data) return false;
+	return PuzzleImport_First((StrView) { data, strlen(data) }, puzzle);
 }
 
-/* metadata line parser */
-static bool parse_metadata_line(
-	const char *line, const char *key, char *value, size_t value_size) {
-	size_t key_len = strlen(key);
+bool Puzzle_LoadFromFile(Puzzle *puzzle, const char *filepath) {
+	if (!puzzle || !filepath) return false;
 
-	/* check for line starting with key */
-	if (strncmp(line, key, key_len) != 0) return false;
+	MappedFile file;
+	if (!MappedFile_Open(&file, filepath)) return false;
+	bool ok = PuzzleImport_First((StrView) { file.data, file.size }, puzzle);
+	MappedFile_Close(&file);
+	return ok;
+}
 
-	/* skip key and colon */
-	const char *val_start = line + key_len;
-	if (*val_start == ':') val_start++;
+/* copy str into the arena, returns its offset or UINT32_MAX if out of memory */
+static uint32_t list_intern(PuzzleFileList *list, const char *str, bool lower) {
+	size_t len = strlen(str) + 1;
+	if (list->stringsLen + len > list->stringsCap) {
+		size_t cap = list->stringsCap ? list->stringsCap * 2 : 16384;
+		while (cap < list->stringsLen + len)
+			cap *= 2;
+		char *strings = realloc(list->strings, cap);
+		if (!strings) return UINT32_MAX;
+		list->strings = strings;
+		list->stringsCap = cap;
+	}
 
-	while (*val_start && isspace((unsigned char) *val_start))
-		val_start++;
+	uint32_t offset = (uint32_t) list->stringsLen;
+	char *dst = list->strings + offset;
+	for (size_t i = 0; i < len; i++)
+		dst[i] = lower ? (char) tolower((unsigned char) str[i]) : str[i];
+	list->stringsLen += len;
+	return offset;
+}
 
-	/* ingest value */
-	strncpy(value, val_start, value_size - 1);
-	value[value_size - 1] = '\0';
-	trim(value);
+bool PuzzleFileList_Add(PuzzleFileList *list,
+	const char *path,
+	const char *title,
+	const char *author,
+	PuzzleFileEntry e) {
+	if (list->count == list->capacity) {
+		int cap = list->capacity ? list->capacity * 2 : 256;
+		PuzzleFileEntry *entries = realloc(list->entries, cap * sizeof(*entries));
+		if (!entries) return false;
+		list->entries = entries;
+		list->capacity = cap;
+	}
 
+	e.path = list_intern(list, path, false);
+	e.title = list_intern(list, title, false);
+	e.key = list_intern(list, title, true);
+	e.author = list_intern(list, author, false);
+	if (e.path == UINT32_MAX || e.title == UINT32_MAX || e.key == UINT32_MAX
+		|| e.author == UINT32_MAX)
+		return false;
+	list->entries[list->count++] = e;
 	return true;
 }
 
-bool Puzzle_LoadFromString(Puzzle *puzzle, const char *data) {
-	if (!puzzle || !data) return false;
+void PuzzleFileList_Clear(PuzzleFileList *list) {
+	/* keep the buffers, drop the contents */
+	list->count = 0;
+	list->stringsLen = 0;
+	list->indexed = 0;
+	list->filterStart = 0;
+	list->filterCount = 0;
+	list->pathHashed = 0;
+	if (list->pathSlots)
+		memset(list->pathSlots, 0, list->pathCapacity * sizeof(*list->pathSlots));
+}
 
-	/* init puzzle */
-	memset(puzzle, 0, sizeof(Puzzle));
-	strcpy(puzzle->meta.title, "untitled");
-	strcpy(puzzle->meta.author, "unknown");
+/* equal titles are ordered by path offset, which moves with an entry when
+ * PuzzleFileList_Remove renumbers it
+ */
+static int compare_index(
+	const PuzzleFileList *list, PuzzleIndexEntry a, PuzzleIndexEntry b) {
+	int cmp = strcmp(list->strings + a.key, list->strings + b.key);
+	if (cmp) return cmp;
+	uint32_t pa = list->entries[a.entry].path, pb = list->entries[b.entry].path;
+	return (pa > pb) - (pa < pb);
+}
 
-	char buffer[256];
-	const char *line_start = data;
-	const char *line_end;
-	int board_row = 0;
-
-	while (*line_start) {
-		/* find end of line */
-		line_end = line_start;
-		while (*line_end && *line_end != '\n' && *line_end != '\r')
-			line_end++;
-
-		/* ingest line */
-		size_t line_len = line_end - line_start;
-		if (line_len >= sizeof(buffer)) line_len = sizeof(buffer) - 1;
-		memcpy(buffer, line_start, line_len);
-		buffer[line_len] = '\0';
-		trim(buffer);
-
-		/* skipping empty lines */
-		if (buffer[0] != '\0') {
-			/* check for metadata lines */
-			if (parse_metadata_line(
-				    buffer, "title", puzzle->meta.title, MAX_PUZZLE_TITLE)) {
-				/* title parsed successfully */
-			}
-			else if (parse_metadata_line(buffer,
-					 "author",
-					 puzzle->meta.author,
-					 MAX_PUZZLE_AUTHOR)) {
-				/* author parsed successfully */
-			}
-			/* otherwise try to parse as board row */
-			else if (strlen(buffer) >= (size_t) BOARD_SIZE
-				&& board_row < BOARD_SIZE) {
-				for (int c = 0; c < BOARD_SIZE; c++) {
-					char ch = buffer[c];
-					if (ch >= '1' && ch <= '9') {
-						puzzle->board.cells[board_row][c].value
-							= (uint8_t) (ch - '0');
-						puzzle->board.cells[board_row][c].given
-							= true;
-					}
-					else {
-						puzzle->board.cells[board_row][c].value
-							= 0;
-						puzzle->board.cells[board_row][c].given
-							= false;
-					}
-				}
-				board_row++;
-			}
+/* merge the sorted runs a[0..na) and b[0..nb) into out */
+static void index_merge(const PuzzleFileList *list,
+	const PuzzleIndexEntry *a,
+	int na,
+	const PuzzleIndexEntry *b,
+	int nb,
+	PuzzleIndexEntry *out) {
+	int i = 0, j = 0;
+	while (i < na && j < nb)
+		*out++ = compare_index(list, a[i], b[j]) <= 0 ? a[i++] : b[j++];
+	while (i < na)
+		*out++ = a[i++];
+	while (j < nb)
+		*out++ = b[j++];
+}
+
+/* bottom-up merge sort, qsort has no way to pass the arena to the compare */
+static void index_sort(
+	const PuzzleFileList *list, PuzzleIndexEntry *idx, PuzzleIndexEntry *tmp, int n) {
+	PuzzleIndexEntry *src = idx, *dst = tmp;
+	for (int width = 1; width < n; width *= 2) {
+		for (int lo = 0; lo < n; lo += 2 * width) {
+			int mid = lo + width < n ? lo + width : n;
+			int hi = lo + 2 * width < n ? lo + 2 * width : n;
+			index_merge(
+				list, src + lo, mid - lo, src + mid, hi - mid, dst + lo);
 		}
+		PuzzleIndexEntry *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != idx) memcpy(idx, src, n * sizeof(*idx));
+}
 
-		line_start = line_end;
-		if (*line_start == '\r') line_start++;
-		if (*line_start == '\n') line_start++;
+bool PuzzleFileList_UpdateIndex(PuzzleFileList *list) {
+	int first = list->indexed, n = list->count;
+	if (first == n && list->index) return true;
+
+	size_t bytes = (n ? n : 1) * sizeof(*list->index);
+	PuzzleIndexEntry *index = realloc(list->index, bytes);
+	if (!index) return false;
+	list->index = index;
+	PuzzleIndexEntry *tmp = malloc(bytes);
+	if (!tmp) return false;
+
+	/* sort the new entries on their own, then merge them into the old run */
+	for (int i = first; i < n; i++) {
+		index[i].key = list->entries[i].key;
+		index[i].entry = i;
 	}
+	index_sort(list, index + first, tmp, n - first);
+	index_merge(list, index, first, index + first, n - first, tmp);
 
-	if (board_row != BOARD_SIZE) return false;
+	free(list->index);
+	list->index = tmp;
+	list->indexed = n;
+	return true;
+}
+
+/* row of entry in the index, -1 if it is not indexed */
+static int index_find(const PuzzleFileList *list, int entry) {
+	PuzzleIndexEntry target = { list->entries[entry].key, entry };
+	int lo = 0, hi = list->indexed;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (compare_index(list, list->index[mid], target) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < list->indexed && list->index[lo].entry == entry ? lo : -1;
+}
+
+/* fnv-1a */
+static uint32_t path_hash(const char *path) {
+	uint32_t h = 2166136261u;
+	for (; *path; path++)
+		h = (h ^ (uint8_t) *path) * 16777619u;
+	return h;
+}
 
+/* slot holding path, or the empty one it would go in */
+static int path_slot(const PuzzleFileList *list, const char *path) {
+	int mask = list->pathCapacity - 1;
+	for (int i = (int) (path_hash(path) & mask);; i = (i + 1) & mask) {
+		int entry = list->pathSlots[i] - 1;
+		if (entry < 0 || strcmp(PuzzleFileList_Path(list, entry), path) == 0)
+			return i;
+	}
+}
+
+static void path_reset(PuzzleFileList *list) {
+	free(list->pathSlots);
+	list->pathSlots = NULL;
+	list->pathCapacity = 0;
+	list->pathHashed = 0;
+}
+
+/* hash the entries added since the last call, the table stays at most half
+ * full and is rebuilt whole when it grows
+ */
+static bool path_update(PuzzleFileList *list) {
+	int n = list->count;
+	if (n * 2 >= list->pathCapacity) {
+		int cap = list->pathCapacity ? list->pathCapacity : 512;
+		while (n * 2 >= cap)
+			cap *= 2;
+		int *slots = calloc(cap, sizeof(*slots));
+		if (!slots) return false;
+		free(list->pathSlots);
+		list->pathSlots = slots;
+		list->pathCapacity = cap;
+		list->pathHashed = 0;
+	}
+	for (; list->pathHashed < n; list->pathHashed++) {
+		int entry = list->pathHashed;
+		const char *path = PuzzleFileList_Path(list, entry);
+		list->pathSlots[path_slot(list, path)] = entry + 1;
+	}
 	return true;
 }
 
-bool Puzzle_LoadFromFile(Puzzle *puzzle, const char *filepath) {
-	if (!puzzle || !filepath) return false;
+/* empty slot i, moving later entries of its probe run back into the hole */
+static void path_delete(PuzzleFileList *list, int i) {
+	int mask = list->pathCapacity - 1;
+	for (int j = (i + 1) & mask; list->pathSlots[j]; j = (j + 1) & mask) {
+		const char *path = PuzzleFileList_Path(list, list->pathSlots[j] - 1);
+		int home = (int) (path_hash(path) & mask);
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			list->pathSlots[i] = list->pathSlots[j];
+			i = j;
+		}
+	}
+	list->pathSlots[i] = 0;
+}
 
-	FILE *f = fopen(filepath, "r");
-	if (!f) return false;
+int PuzzleFileList_Find(PuzzleFileList *list, const char *path) {
+	if (path_update(list)) return list->pathSlots[path_slot(list, path)] - 1;
 
-	char buffer[4096];
-	size_t total_read = 0;
-	size_t bytes_read;
+	/* out of memory for the table */
+	for (int i = 0; i < list->count; i++)
+		if (strcmp(PuzzleFileList_Path(list, i), path) == 0) return i;
+	return -1;
+}
 
-	while ((bytes_read = fread(
-			buffer + total_read, 1, sizeof(buffer) - total_read - 1, f))
-		> 0) {
-		total_read += bytes_read;
-		if (total_read >= sizeof(buffer) - 1) break;
+void PuzzleFileList_Remove(PuzzleFileList *list, int entry) {
+	if (!PuzzleFileList_UpdateIndex(list)) return;
+
+	int row = index_find(list, entry);
+	if (row < 0) return;
+	memmove(list->index + row,
+		list->index + row + 1,
+		(list->indexed - row - 1) * sizeof(*list->index));
+	list->indexed--;
+
+	bool hashed = path_update(list);
+	if (hashed)
+		path_delete(list, path_slot(list, PuzzleFileList_Path(list, entry)));
+	else
+		path_reset(list);
+
+	/* the last entry fills the hole, its strings stay where they are */
+	int last = --list->count;
+	if (entry != last) {
+		int lastRow = index_find(list, last);
+		list->entries[entry] = list->entries[last];
+		if (lastRow >= 0) list->index[lastRow].entry = entry;
+		if (hashed) {
+			const char *path = PuzzleFileList_Path(list, entry);
+			list->pathSlots[path_slot(list, path)] = entry + 1;
+		}
+	}
+	if (hashed) list->pathHashed = list->count;
+	if (list->filterStart + list->filterCount > list->indexed) {
+		list->filterStart = 0;
+		list->filterCount = list->indexed;
 	}
-	buffer[total_read] = '\0';
+}
 
-	fclose(f);
+const char *PuzzleFileList_Path(const PuzzleFileList *list, int entry) {
+	return list->strings + list->entries[entry].path;
+}
 
-	return Puzzle_LoadFromString(puzzle, buffer);
+const char *PuzzleFileList_Title(const PuzzleFileList *list, int entry) {
+	return list->strings + list->entries[entry].title;
+}
+
+/* first index row whose key, cut to n chars, compares >= (or > if upper) prefix */
+static int index_bound(
+	const PuzzleFileList *list, const char *prefix, size_t n, bool upper) {
+	int lo = 0, hi = list->indexed;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		int cmp = strncmp(list->strings + list->index[mid].key, prefix, n);
+		if (cmp < 0 || (upper && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int PuzzleFileList_Filter(PuzzleFileList *list, const char *prefix) {
+	char key[MAX_PUZZLE_TITLE];
+	size_t n = 0;
+	for (; prefix[n] && n < sizeof(key) - 1; n++)
+		key[n] = (char) tolower((unsigned char) prefix[n]);
+	key[n] = '\0';
+
+	if (!list->index || n == 0) {
+		list->filterStart = 0;
+		list->filterCount = list->index ? list->indexed : 0;
+		return list->filterCount;
+	}
+
+	list->filterStart = index_bound(list, key, n, false);
+	list->filterCount = index_bound(list, key, n, true) - list->filterStart;
+	return list->filterCount;
+}
+
+int PuzzleFileList_FilteredEntry(const PuzzleFileList *list, int row) {
+	return list->index[list->filterStart + row].entry;
+}
+
+void PuzzleFileList_Free(PuzzleFileList *list) {
+	free(list->entries);
+	free(list->strings);
+	free(list->index);
+	path_reset(list);
+	memset(list, 0, sizeof(*list));
+}
+
+bool Puzzle_ReadHeader(const char *filepath, PuzzleMetadata *meta, int *clues) {
+	strcpy(meta->title, "untitled");
+	strcpy(meta->author, "unknown");
+	*clues = 0;
+
+	/* the file is mapped, only the pages up to the first puzzle are read */
+	Puzzle puzzle;
+	if (!Puzzle_LoadFromFile(&puzzle, filepath)) return false;
+	*meta = puzzle.meta;
+	*clues = BoardSet_Count(puzzle.board.given);
+	return true;
 }
 
 int PuzzleFileList_ScanDirectory(PuzzleFileList *list, const char *directory) {
 	if (!list || !directory) return 0;
-
-	list->count = 0;
+	PuzzleFileList_Clear(list);
 
 	DIR *dir = opendir(directory);
 	if (!dir) return 0;
 
-	struct dirent *entry;
-	while ((entry = readdir(dir)) != NULL && list->count < MAX_PUZZLE_FILES) {
-		size_t len = strlen(entry->d_name);
-		if (len < 4 || strcmp(entry->d_name + len - 4, ".txt") != 0) continue;
+	char indexPath[MAX_FILEPATH_LEN];
+	snprintf(indexPath, sizeof(indexPath), "%s/%s", directory, PUZZLE_CACHE_FILE);
+	PuzzleCache cache;
+	PuzzleCache_Load(&cache, indexPath);
+	int reused = 0;
+	bool dirty = false;
 
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
 		char fullpath[MAX_FILEPATH_LEN];
-		snprintf(fullpath, sizeof(fullpath), "%s/%s", directory, entry->d_name);
-		struct stat st;
-		if (stat(fullpath, &st) == 0 && S_ISDIR(st.st_mode)) continue;
-
-		snprintf(list->filepaths[list->count],
-			MAX_FILEPATH_LEN,
-			"%s/%s",
-			directory,
-			entry->d_name);
-
-		Puzzle puzzle;
-		if (Puzzle_LoadFromFile(&puzzle, list->filepaths[list->count])) {
-			snprintf(list->titles[list->count],
-				MAX_PUZZLE_TITLE,
-				"%s",
-				puzzle.meta.title);
-		}
-		else {
-			snprintf(list->titles[list->count],
-				MAX_PUZZLE_TITLE,
-				"%s",
-				entry->d_name);
-		}
-
-		list->count++;
+		PuzzleFileEntry e;
+		PuzzleMetadata meta;
+		bool hit;
+		const char *name = entry->d_name;
+		if (!PuzzleCache_Resolve(
+				&cache, directory, name, fullpath, &e, &meta, &hit))
+			continue;
+		if (hit)
+			reused++;
+		else
+			dirty = true;
+		if (!PuzzleFileList_Add(list, fullpath, meta.title, meta.author, e))
+			break;
 	}
 
 	closedir(dir);
+
+	/* files removed since the index was written also make it stale */
+	if (dirty || reused != cache.count) PuzzleCache_Save(list, indexPath);
+	PuzzleCache_Free(&cache);
+
+	PuzzleFileList_UpdateIndex(list);
+	PuzzleFileList_Filter(list, "");
 	return list->count;
 }
+
+static void put_string(uint8_t **p, const char *s) {
+	size_t len = strlen(s);
+	if (len > 255) len = 255;
+	*(*p)++ = (uint8_t) len;
+	memcpy(*p, s, len);
+	*p += len;
+}
+
+size_t Puzzle_ToRecord(const Puzzle *puzzle, const Board *solution, uint8_t *out) {
+	const Board *b = &puzzle->board;
+	int n = BOARD_SIZE, cells = n * n;
+
+	/* the board flattened to record order, row-major without the padding */
+	uint8_t givens[BOARD_CELLS_MAX], isClue[BOARD_CELLS_MAX], clue[BOARD_CELLS_MAX];
+	uint8_t values[BOARD_CELLS_MAX], colors[BOARD_CELLS_MAX];
+	int clues = 0;
+	uint8_t flags = 0;
+	for (int r = 0; r < n; r++) {
+		for (int c = 0; c < n; c++) {
+			int i = r * n + c, v = Board_Value(b, r, c);
+			bool given = Board_IsGiven(b, r, c);
+			givens[i] = given ? (uint8_t) v : 0;
+			isClue[i] = given;
+			if (given) clue[clues++] = (uint8_t) v;
+			values[i] = given ? 0 : (uint8_t) v;
+			colors[i] = (uint8_t) Board_Color(b, r, c);
+			if (values[i]) flags |= RECORD_VALUES;
+			if (colors[i]) flags |= RECORD_COLORS;
+		}
+	}
+	for (int v = 1; v <= n; v++)
+		if (BoardSet_Any(b->notes[v - 1])) flags |= RECORD_NOTES;
+	if (solution) flags |= RECORD_SOLUTION;
+	if (strcmp(puzzle->meta.title, "untitled") != 0
+		|| strcmp(puzzle->meta.author, "unknown") != 0)
+		flags |= RECORD_META;
+
+	int sparseBytes = RECORD_MASK_BYTES(cells) + RECORD_NIBBLE_BYTES(clues);
+	if (sparseBytes < RECORD_NIBBLE_BYTES(cells)) flags |= RECORD_SPARSE;
+
+	uint8_t *p = out;
+	*p++ = PUZZLE_RECORD_MAGIC;
+	*p++ = PUZZLE_RECORD_VERSION;
+	*p++ = (uint8_t) n;
+	*p++ = flags;
+
+	if (flags & RECORD_SPARSE) {
+		Record_PackBits(isClue, cells, p);
+		p += RECORD_MASK_BYTES(cells);
+		Record_PackNibbles(clue, clues, p);
+		p += RECORD_NIBBLE_BYTES(clues);
+	}
+	else {
+		Record_PackNibbles(givens, cells, p);
+		p += RECORD_NIBBLE_BYTES(cells);
+	}
+	if (flags & RECORD_SOLUTION) {
+		uint8_t digits[BOARD_CELLS_MAX];
+		for (int r = 0, i = 0; r < n; r++)
+			for (int c = 0; c < n; c++, i++)
+				digits[i] = (uint8_t) Board_Value(solution, r, c);
+		Record_PackNibbles(digits, cells, p);
+		p += RECORD_NIBBLE_BYTES(cells);
+	}
+	if (flags & RECORD_VALUES) {
+		Record_PackNibbles(values, cells, p);
+		p += RECORD_NIBBLE_BYTES(cells);
+	}
+	if (flags & RECORD_NOTES) {
+		for (int v = 1; v <= n; v++) {
+			uint8_t has[BOARD_CELLS_MAX];
+			BoardSet notes = b->notes[v - 1];
+			for (int r = 0, i = 0; r < n; r++)
+				for (int c = 0; c < n; c++, i++)
+					has[i] = BoardSet_Test(notes, BOARD_CELL(r, c));
+			Record_PackBits(has, cells, p);
+			p += RECORD_MASK_BYTES(cells);
+		}
+	}
+	if (flags & RECORD_COLORS) {
+		Record_PackNibbles(colors, cells, p);
+		p += RECORD_NIBBLE_BYTES(cells);
+	}
+	if (flags & RECORD_META) {
+		put_string(&p, puzzle->meta.title);
+		put_string(&p, puzzle->meta.author);
+	}
+
+	uint32_t sum = Record_Checksum(out, (size_t) (p - out));
+	for (int i = 0; i < 4; i++)
+		*p++ = (uint8_t) (sum >> (8 * i));
+	return (size_t) (p - out);
+}
+
+/* next len bytes of the record, NULL if it is shorter than that */
+static const uint8_t *take(const uint8_t **p, const uint8_t *end, size_t len) {
+	if ((size_t) (end - *p) < len) return NULL;
+	const uint8_t *at = *p;
+	*p += len;
+	return at;
+}
+
+/* nibble section of one digit per cell, NULL if short or a digit is too big */
+static const uint8_t *take_digits(
+	const uint8_t **p, const uint8_t *end, int count, int max, uint8_t *digits) {
+	const uint8_t *at = take(p, end, RECORD_NIBBLE_BYTES(count));
+	if (!at) return NULL;
+	Record_UnpackNibbles(at, count, digits);
+	for (int i = 0; i < count; i++)
+		if (digits[i] > max) return NULL;
+	return at;
+}
+
+static bool take_string(const uint8_t **p, const uint8_t *end, char *dst, size_t size) {
+	const uint8_t *len = take(p, end, 1);
+	const uint8_t *s = len ? take(p, end, *len) : NULL;
+	if (!s) return false;
+	size_t n = *len < size - 1 ? *len : size - 1;
+	memcpy(dst, s, n);
+	dst[n] = '\0';
+	return true;
+}
+
+size_t Puzzle_FromRecord(
+	Puzzle *puzzle, Board *solution, const uint8_t *data, size_t len) {
+	const uint8_t *p = data, *end = data + len;
+	const uint8_t *head = take(&p, end, 4);
+	int n = BOARD_SIZE, cells = n * n;
+	if (!head || head[0] != PUZZLE_RECORD_MAGIC || head[1] != PUZZLE_RECORD_VERSION
+		|| head[2] != n)
+		return 0;
+	uint8_t flags = head[3];
+
+	memset(puzzle, 0, sizeof(*puzzle));
+	strcpy(puzzle->meta.title, "untitled");
+	strcpy(puzzle->meta.author, "unknown");
+	Board *b = &puzzle->board;
+
+	uint8_t givens[BOARD_CELLS_MAX];
+	if (flags & RECORD_SPARSE) {
+		uint8_t isClue[BOARD_CELLS_MAX], clue[BOARD_CELLS_MAX];
+		const uint8_t *mask = take(&p, end, RECORD_MASK_BYTES(cells));
+		if (!mask) return 0;
+		Record_UnpackBits(mask, cells, isClue);
+		int clues = 0;
+		for (int i = 0; i < cells; i++)
+			clues += isClue[i];
+		if (!take_digits(&p, end, clues, n, clue)) return 0;
+		for (int i = 0, k = 0; i < cells; i++)
+			givens[i] = isClue[i] ? clue[k++] : 0;
+	}
+	else if (!take_digits(&p, end, cells, n, givens))
+		return 0;
+	for (int r = 0, i = 0; r < n; r++)
+		for (int c = 0; c < n; c++, i++)
+			if (givens[i]) Board_Set(b, r, c, givens[i], true);
+
+	if (flags & RECORD_SOLUTION) {
+		uint8_t digits[BOARD_CELLS_MAX];
+		if (!take_digits(&p, end, cells, n, digits)) return 0;
+		if (solution) {
+			Board_Clear(solution);
+			for (int r = 0, i = 0; r < n; r++)
+				for (int c = 0; c < n; c++, i++)
+					Board_Set(solution, r, c, digits[i], true);
+		}
+	}
+	if (flags & RECORD_VALUES) {
+		uint8_t values[BOARD_CELLS_MAX];
+		if (!take_digits(&p, end, cells, n, values)) return 0;
+		for (int r = 0, i = 0; r < n; r++)
+			for (int c = 0; c < n; c++, i++)
+				if (values[i] && !givens[i])
+					Board_Set(b, r, c, values[i], false);
+	}
+	if (flags & RECORD_NOTES) {
+		for (int v = 1; v <= n; v++) {
+			uint8_t has[BOARD_CELLS_MAX];
+			const uint8_t *mask = take(&p, end, RECORD_MASK_BYTES(cells));
+			if (!mask) return 0;
+			Record_UnpackBits(mask, cells, has);
+			BoardSet notes = { 0, 0 };
+			for (int r = 0, i = 0; r < n; r++) {
+				for (int c = 0; c < n; c++, i++) {
+					BoardSet bit = BoardSet_Bit(BOARD_CELL(r, c));
+					if (has[i]) notes = BoardSet_Or(notes, bit);
+				}
+			}
+			b->notes[v - 1] = notes;
+		}
+	}
+	if (flags & RECORD_COLORS) {
+		uint8_t colors[BOARD_CELLS_MAX];
+		if (!take_digits(&p, end, cells, CELL_COLOR_COUNT - 1, colors)) return 0;
+		for (int r = 0, i = 0; r < n; r++)
+			for (int c = 0; c < n; c++, i++)
+				Board_SetColor(b, r, c, colors[i]);
+	}
+	PuzzleMetadata *meta = &puzzle->meta;
+	if ((flags & RECORD_META)
+		&& (!take_string(&p, end, meta->title, sizeof(meta->title))
+			|| !take_string(&p, end, meta->author, sizeof(meta->author))))
+		return 0;
+
+	size_t body = (size_t) (p - data);
+	const uint8_t *sum = take(&p, end, 4);
+	if (!sum) return 0;
+	uint32_t expected = (uint32_t) sum[0] | (uint32_t) sum[1] << 8
+		| (uint32_t) sum[2] << 16 | (uint32_t) sum[3] << 24;
+	if (Record_Checksum(data, body) != expected) return 0;
+	return (size_t) (p - data);
+}
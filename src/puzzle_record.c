@@ -0,0 +1,108 @@
+/* src/puzzle_record.c
+ * nibble and bit codecs for puzzle records
+ */
+
+#include "puzzle_record.h"
+
+/* byte-wise loads and stores keep the packing independent of host order,
+ * compilers fold them into single moves on little-endian targets
+ */
+static uint64_t load_le64(const uint8_t *p) {
+	uint64_t v = 0;
+	for (int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static void store_le64(uint8_t *p, uint64_t v) {
+	for (int i = 0; i < 8; i++)
+		p[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint32_t load_le32(const uint8_t *p) {
+	return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16
+		| (uint32_t) p[3] << 24;
+}
+
+static void store_le32(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; i++)
+		p[i] = (uint8_t) (v >> (8 * i));
+}
+
+/* eight cells in, four packed bytes out: fold each odd byte into the high
+ * half of the even one below it, then squeeze the even bytes together
+ */
+static uint32_t pack8(uint64_t w) {
+	w &= 0x0F0F0F0F0F0F0F0Full;
+	w = (w | (w >> 4)) & 0x00FF00FF00FF00FFull;
+	w = (w | (w >> 8)) & 0x0000FFFF0000FFFFull;
+	return (uint32_t) (w | (w >> 16));
+}
+
+static uint64_t unpack8(uint32_t v) {
+	uint64_t w = v;
+	w = (w | (w << 16)) & 0x0000FFFF0000FFFFull;
+	w = (w | (w << 8)) & 0x00FF00FF00FF00FFull;
+	return (w | (w << 4)) & 0x0F0F0F0F0F0F0F0Full;
+}
+
+void Record_PackNibbles(const uint8_t *cells, int n, uint8_t *out) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		store_le32(out + i / 2, pack8(load_le64(cells + i)));
+	for (; i < n; i += 2) {
+		uint8_t hi = i + 1 < n ? cells[i + 1] : 0;
+		out[i / 2] = (uint8_t) ((cells[i] & 0x0F) | (hi & 0x0F) << 4);
+	}
+}
+
+void Record_UnpackNibbles(const uint8_t *in, int n, uint8_t *cells) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		store_le64(cells + i, unpack8(load_le32(in + i / 2)));
+	for (; i < n; i++)
+		cells[i] = (uint8_t) (i & 1 ? in[i / 2] >> 4 : in[i / 2] & 0x0F);
+}
+
+/* eight 0/1 bytes to one byte, the multiply gathers the flag at bit 8i into
+ * bit 56 + i of the product
+ */
+static uint8_t bits_pack8(uint64_t w) {
+	w &= 0x0101010101010101ull;
+	return (uint8_t) ((w * 0x0102040810204080ull) >> 56);
+}
+
+/* one byte to eight 0/1 bytes: copy it into every byte, keep bit i of byte i,
+ * then turn any nonzero byte into 1 (+0x7f sets bit 7 without a carry)
+ */
+static uint64_t bits_unpack8(uint8_t v) {
+	uint64_t w = (v * 0x0101010101010101ull) & 0x8040201008040201ull;
+	return ((w + 0x7F7F7F7F7F7F7F7Full) >> 7) & 0x0101010101010101ull;
+}
+
+void Record_PackBits(const uint8_t *flags, int n, uint8_t *out) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		out[i / 8] = bits_pack8(load_le64(flags + i));
+	if (i < n) {
+		out[i / 8] = 0;
+		for (; i < n; i++)
+			out[i / 8] |= (uint8_t) ((flags[i] & 1) << (i % 8));
+	}
+}
+
+void Record_UnpackBits(const uint8_t *in, int n, uint8_t *flags) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		store_le64(flags + i, bits_unpack8(in[i / 8]));
+	for (; i < n; i++)
+		flags[i] = (in[i / 8] >> (i % 8)) & 1;
+}
+
+uint32_t Record_Checksum(const uint8_t *data, size_t len) {
+	/* fnv-1a */
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ data[i]) * 16777619u;
+	return h;
+}
@@ -0,0 +1,195 @@
+/* src/puzzle_scan.c
+ * background puzzles directory scan
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "puzzle_scan.h"
+#include "puzzle_cache.h"
+#include "profiler.h"
+
+struct PuzzleScanJob {
+	pthread_mutex_t lock;
+	int refs; /* guarded by lock, the worker and the menu hold one each */
+	char directory[MAX_FILEPATH_LEN];
+
+	PuzzleFileList found; /* worker only, everything scanned so far */
+	int handed; /* entries of found already copied to pending */
+	PuzzleFileList pending; /* guarded by lock, taken by PuzzleScan_Poll */
+
+	int cancel; /* set by the main thread, checked per directory entry */
+	int done; /* set by the worker after its last batch */
+};
+
+/* one index write at a time, a cancelled worker may still be finishing while
+ * a new one scans the same directory
+ */
+static pthread_mutex_t s_saveLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void job_release(PuzzleScanJob *job) {
+	pthread_mutex_lock(&job->lock);
+	bool last = --job->refs == 0;
+	pthread_mutex_unlock(&job->lock);
+	if (!last) return;
+
+	pthread_mutex_destroy(&job->lock);
+	PuzzleFileList_Free(&job->found);
+	PuzzleFileList_Free(&job->pending);
+	free(job);
+}
+
+/* copy entries[first..] of src to the end of dst */
+static bool copy_entries(PuzzleFileList *dst, const PuzzleFileList *src, int first) {
+	for (int i = first; i < src->count; i++) {
+		const PuzzleFileEntry *e = &src->entries[i];
+		if (!PuzzleFileList_Add(dst,
+				src->strings + e->path,
+				src->strings + e->title,
+				src->strings + e->author,
+				*e))
+			return false;
+	}
+	return true;
+}
+
+static void hand_over(PuzzleScanJob *job) {
+	pthread_mutex_lock(&job->lock);
+	copy_entries(&job->pending, &job->found, job->handed);
+	pthread_mutex_unlock(&job->lock);
+	job->handed = job->found.count;
+}
+
+static void *scan_worker(void *arg) {
+	PuzzleScanJob *job = arg;
+
+	DIR *dir = opendir(job->directory);
+	if (!dir) {
+		__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+		job_release(job);
+		return NULL;
+	}
+
+	char indexPath[MAX_FILEPATH_LEN + sizeof(PUZZLE_CACHE_FILE)];
+	snprintf(indexPath,
+		sizeof(indexPath),
+		"%s/%s",
+		job->directory,
+		PUZZLE_CACHE_FILE);
+	PuzzleCache cache;
+	PuzzleCache_Load(&cache, indexPath);
+	int reused = 0;
+	bool dirty = false, complete = true;
+	double lastHandOver = Profiler_Now();
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (__atomic_load_n(&job->cancel, __ATOMIC_ACQUIRE)) {
+			complete = false;
+			break;
+		}
+
+		char fullpath[MAX_FILEPATH_LEN];
+		PuzzleFileEntry e;
+		PuzzleMetadata meta;
+		bool hit;
+		const char *name = entry->d_name;
+		if (!PuzzleCache_Resolve(
+				&cache, job->directory, name, fullpath, &e, &meta, &hit))
+			continue;
+		if (hit)
+			reused++;
+		else
+			dirty = true;
+		PuzzleFileList *found = &job->found;
+		if (!PuzzleFileList_Add(found, fullpath, meta.title, meta.author, e)) {
+			complete = false;
+			break;
+		}
+
+		/* small batches keep the lock rare, the interval keeps slow disks live */
+		double now = Profiler_Now();
+		if (job->found.count - job->handed >= PUZZLE_SCAN_BATCH
+			|| now - lastHandOver >= PUZZLE_SCAN_INTERVAL) {
+			hand_over(job);
+			lastHandOver = now;
+		}
+	}
+	closedir(dir);
+	hand_over(job);
+
+	/* a partial scan would drop the records it never reached */
+	if (complete && (dirty || reused != cache.count)) {
+		pthread_mutex_lock(&s_saveLock);
+		if (!__atomic_load_n(&job->cancel, __ATOMIC_ACQUIRE))
+			PuzzleCache_Save(&job->found, indexPath);
+		pthread_mutex_unlock(&s_saveLock);
+	}
+	PuzzleCache_Free(&cache);
+
+	__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+	job_release(job);
+	return NULL;
+}
+
+static void scan_finish(PuzzleScan *scan) {
+	job_release(scan->job);
+	scan->job = NULL;
+	scan->running = false;
+}
+
+void PuzzleScan_Start(PuzzleScan *scan, PuzzleFileList *list, const char *directory) {
+	if (scan->running) PuzzleScan_Cancel(scan);
+
+	*scan = (PuzzleScan) { 0 };
+	PuzzleFileList_Clear(list);
+	PuzzleFileList_UpdateIndex(list);
+	PuzzleFileList_Filter(list, "");
+
+	PuzzleScanJob *job = calloc(1, sizeof(*job));
+	if (!job || pthread_mutex_init(&job->lock, NULL) != 0) {
+		free(job);
+		PuzzleFileList_ScanDirectory(list, directory);
+		return;
+	}
+	snprintf(job->directory, sizeof(job->directory), "%s", directory);
+	job->refs = 2;
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, scan_worker, job) != 0) {
+		pthread_mutex_destroy(&job->lock);
+		free(job);
+		PuzzleFileList_ScanDirectory(list, directory);
+		return;
+	}
+	pthread_detach(thread);
+	scan->job = job;
+	scan->running = true;
+}
+
+int PuzzleScan_Poll(PuzzleScan *scan, PuzzleFileList *list) {
+	if (!scan->running) return 0;
+	PuzzleScanJob *job = scan->job;
+
+	/* read before taking the batch, the worker hands its last one over first */
+	bool done = __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+
+	int before = list->count;
+	pthread_mutex_lock(&job->lock);
+	copy_entries(list, &job->pending, 0);
+	PuzzleFileList_Clear(&job->pending);
+	pthread_mutex_unlock(&job->lock);
+	PuzzleFileList_UpdateIndex(list);
+
+	if (done) scan_finish(scan);
+	return list->count - before;
+}
+
+void PuzzleScan_Cancel(PuzzleScan *scan) {
+	if (!scan->running) return;
+	__atomic_store_n(&scan->job->cancel, 1, __ATOMIC_RELEASE);
+	scan_finish(scan);
+}
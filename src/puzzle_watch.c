@@ -0,0 +1,237 @@
+/* src/puzzle_watch.c
+ * inotify watch on the puzzles directory
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "puzzle_watch.h"
+#include "puzzle_cache.h"
+
+#ifdef __linux__
+
+struct PuzzleWatchJob {
+	pthread_mutex_t lock;
+	int refs; /* guarded by lock, the worker and the menu hold one each */
+	int fd; /* inotify */
+	int wake[2]; /* a pipe, written to stop the worker */
+	char directory[MAX_FILEPATH_LEN];
+
+	/* guarded by lock, the latest change per path: files to (re)add with
+	 * their headers read, and files gone
+	 */
+	PuzzleFileList updated;
+	PuzzleFileList removed;
+
+	int stop; /* set by the main thread */
+	int lost; /* set by the worker, changes were dropped */
+};
+
+static void job_release(PuzzleWatchJob *job) {
+	pthread_mutex_lock(&job->lock);
+	bool last = --job->refs == 0;
+	pthread_mutex_unlock(&job->lock);
+	if (!last) return;
+
+	close(job->fd);
+	close(job->wake[0]);
+	close(job->wake[1]);
+	pthread_mutex_destroy(&job->lock);
+	PuzzleFileList_Free(&job->updated);
+	PuzzleFileList_Free(&job->removed);
+	free(job);
+}
+
+/* drop path from a pending list, true if it was there */
+static bool forget(PuzzleFileList *pending, const char *path) {
+	int old = PuzzleFileList_Find(pending, path);
+	if (old < 0) return false;
+	PuzzleFileList_Remove(pending, old);
+	return true;
+}
+
+/* a file finished writing or was moved in, read its header off the lock */
+static void update_file(PuzzleWatchJob *job, const char *name) {
+	/* an empty cache, the point is to read what changed */
+	PuzzleCache none = { 0 };
+	char path[MAX_FILEPATH_LEN];
+	PuzzleFileEntry e;
+	PuzzleMetadata meta;
+	bool reused;
+	if (!PuzzleCache_Resolve(&none, job->directory, name, path, &e, &meta, &reused))
+		return;
+
+	pthread_mutex_lock(&job->lock);
+	forget(&job->removed, path);
+	forget(&job->updated, path);
+	PuzzleFileList_Add(&job->updated, path, meta.title, meta.author, e);
+	pthread_mutex_unlock(&job->lock);
+}
+
+static void remove_file(PuzzleWatchJob *job, const char *name) {
+	char path[MAX_FILEPATH_LEN + 256];
+	snprintf(path, sizeof(path), "%s/%s", job->directory, name);
+	PuzzleFileEntry none = { 0 };
+
+	pthread_mutex_lock(&job->lock);
+	forget(&job->updated, path);
+	if (PuzzleFileList_Find(&job->removed, path) < 0)
+		PuzzleFileList_Add(&job->removed, path, "", "", none);
+	pthread_mutex_unlock(&job->lock);
+}
+
+/* apply one buffer of events, false if the watch is no good any more */
+static bool read_events(PuzzleWatchJob *job, const char *buffer, ssize_t len) {
+	bool lost = false;
+	for (const char *p = buffer; p < buffer + len;) {
+		const struct inotify_event *ev = (const struct inotify_event *) p;
+		p += sizeof(*ev) + ev->len;
+
+		/* the watch itself ended or events were dropped */
+		if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED)) lost = true;
+		if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) lost = true;
+		if (!ev->len || (ev->mask & IN_ISDIR)) continue;
+
+		if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+			remove_file(job, ev->name);
+		else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			update_file(job, ev->name);
+	}
+	return !lost;
+}
+
+static void *watch_worker(void *arg) {
+	PuzzleWatchJob *job = arg;
+	char buffer[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	bool ok = true;
+
+	while (ok && !__atomic_load_n(&job->stop, __ATOMIC_ACQUIRE)) {
+		struct pollfd fds[2] = { { .fd = job->fd, .events = POLLIN },
+			{ .fd = job->wake[0], .events = POLLIN } };
+		if (poll(fds, 2, -1) < 0) {
+			ok = errno == EINTR;
+			continue;
+		}
+		if (!(fds[0].revents & POLLIN)) continue;
+
+		ssize_t len = read(job->fd, buffer, sizeof(buffer));
+		if (len > 0)
+			ok = read_events(job, buffer, len);
+		else
+			ok = len < 0 && (errno == EAGAIN || errno == EINTR);
+	}
+
+	if (!ok) __atomic_store_n(&job->lost, 1, __ATOMIC_RELEASE);
+	job_release(job);
+	return NULL;
+}
+
+bool PuzzleWatch_Start(PuzzleWatch *w, const char *directory) {
+	*w = (PuzzleWatch) { 0 };
+	PuzzleWatchJob *job = calloc(1, sizeof(*job));
+	if (!job) return false;
+	snprintf(job->directory, sizeof(job->directory), "%s", directory);
+	job->refs = 2;
+
+	/* close_write rather than create, a file being copied in is not ready yet */
+	uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM
+		| IN_DELETE_SELF | IN_MOVE_SELF;
+	job->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	bool ok = job->fd >= 0 && inotify_add_watch(job->fd, directory, mask) >= 0;
+	bool piped = ok && pipe(job->wake) == 0;
+	bool locked = piped && pthread_mutex_init(&job->lock, NULL) == 0;
+
+	pthread_t thread;
+	if (locked && pthread_create(&thread, NULL, watch_worker, job) == 0) {
+		pthread_detach(thread);
+		w->job = job;
+		w->active = true;
+		return true;
+	}
+
+	if (locked) pthread_mutex_destroy(&job->lock);
+	if (piped) {
+		close(job->wake[0]);
+		close(job->wake[1]);
+	}
+	if (job->fd >= 0) close(job->fd);
+	free(job);
+	return false;
+}
+
+void PuzzleWatch_Stop(PuzzleWatch *w) {
+	if (!w->active) return;
+	PuzzleWatchJob *job = w->job;
+	__atomic_store_n(&job->stop, 1, __ATOMIC_RELEASE);
+	ssize_t woken = write(job->wake[1], "", 1);
+	(void) woken;
+	job_release(job);
+	w->job = NULL;
+	w->active = false;
+}
+
+int PuzzleWatch_Poll(PuzzleWatch *w, PuzzleFileList *list) {
+	if (!w->active) return 0;
+	PuzzleWatchJob *job = w->job;
+	if (__atomic_load_n(&job->lost, __ATOMIC_ACQUIRE)) {
+		PuzzleWatch_Stop(w);
+		return -1;
+	}
+
+	/* the headers are read already, this is hash lookups and copies. every
+	 * stale entry goes first so the index is merged once, by the adds
+	 */
+	int changed = 0;
+	pthread_mutex_lock(&job->lock);
+	for (int i = 0; i < job->removed.count; i++)
+		changed += forget(list, PuzzleFileList_Path(&job->removed, i));
+	for (int i = 0; i < job->updated.count; i++)
+		forget(list, PuzzleFileList_Path(&job->updated, i));
+	for (int i = 0; i < job->updated.count; i++) {
+		const PuzzleFileList *u = &job->updated;
+		const PuzzleFileEntry *e = &u->entries[i];
+		changed += PuzzleFileList_Add(list,
+			u->strings + e->path,
+			u->strings + e->title,
+			u->strings + e->author,
+			*e);
+	}
+	PuzzleFileList_Clear(&job->removed);
+	PuzzleFileList_Clear(&job->updated);
+	pthread_mutex_unlock(&job->lock);
+
+	if (changed) PuzzleFileList_UpdateIndex(list);
+	return changed;
+}
+
+#else
+
+bool PuzzleWatch_Start(PuzzleWatch *w, const char *directory) {
+	(void) directory;
+	w->active = false;
+	return false;
+}
+
+void PuzzleWatch_Stop(PuzzleWatch *w) {
+	w->active = false;
+}
+
+int PuzzleWatch_Poll(PuzzleWatch *w, PuzzleFileList *list) {
+	(void) w;
+	(void) list;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,533 @@
+/* src/replay.c
+ * replay recording, files and seekable playback
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "puzzle_record.h"
+#include "replay.h"
+
+#define REPLAY_MAGIC "SDKRPL1"
+#define REPLAY_VERSION 1
+#define KEY_PAUSED 1u
+#define KEY_AUTO_NOTES 2u
+
+/* native byte order like the puzzle indexes: this header, the keyframes,
+ * the keyframe records, then the events
+ */
+typedef struct ReplayHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t boardSize;
+	uint32_t eventCount;
+	uint32_t keyCount;
+	uint64_t recordBytes;
+	char title[MAX_PUZZLE_TITLE];
+} ReplayHeader;
+
+void Replay_Free(Replay *r) {
+	free(r->events);
+	free(r->keys);
+	free(r->records);
+	*r = (Replay) { 0 };
+}
+
+/* events */
+
+static uint32_t encode(ReplayEventKind kind, int cell, int arg, uint32_t delta) {
+	return (uint32_t) kind | (uint32_t) cell << 4 | (uint32_t) (arg & 0xF) << 11
+		| delta << 15;
+}
+
+static uint32_t encode_cell(const Board *b, int cell) {
+	int r = cell / BOARD_SIZE_MAX, c = cell % BOARD_SIZE_MAX;
+	return (uint32_t) REPLAY_CELL | (uint32_t) cell << 4
+		| (uint32_t) Board_Value(b, r, c) << 11
+		| (uint32_t) Board_Color(b, r, c) << 15
+		| (uint32_t) (Board_GetNotes(b, r, c) >> 1) << 19;
+}
+
+/* ms the event moves the clock on by */
+static uint32_t delta_of(uint32_t event) {
+	switch (Replay_Kind(event)) {
+	case REPLAY_CELL:
+		return 0;
+	case REPLAY_WAIT:
+		return event >> 4;
+	default:
+		return event >> 15;
+	}
+}
+
+uint32_t Replay_Duration(const Replay *r) {
+	uint32_t ms = 0;
+	for (int i = 0; i < r->eventCount; i++)
+		ms += delta_of(r->events[i]);
+	return ms;
+}
+
+/* whether event fits the board it is for, as one read from a file may not */
+static bool valid_event(uint32_t event) {
+	int cell = Replay_Cell(event), arg = Replay_Arg(event);
+	int r = cell / BOARD_SIZE_MAX, c = cell % BOARD_SIZE_MAX;
+	bool onBoard = r < BOARD_SIZE && c < BOARD_SIZE;
+	switch (Replay_Kind(event)) {
+	case REPLAY_DIGIT:
+	case REPLAY_NOTE:
+		return onBoard && arg >= 1 && arg <= BOARD_SIZE;
+	case REPLAY_COLOR:
+		return onBoard && arg < CELL_COLOR_COUNT;
+	case REPLAY_CLEAR:
+	case REPLAY_SELECT:
+	case REPLAY_UNDO:
+	case REPLAY_REDO:
+		return onBoard;
+	case REPLAY_PAUSE:
+		return cell == 0 && arg <= 1;
+	case REPLAY_AUTO_NOTES:
+		return onBoard && arg <= 1;
+	case REPLAY_CELL:
+		/* the notes bits run to the top, so this also keeps 28-31 clear */
+		return onBoard && arg <= BOARD_SIZE
+			&& ((event >> 15) & 0xF) < CELL_COLOR_COUNT
+			&& event >> 19 < 1u << BOARD_SIZE;
+	case REPLAY_WAIT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* clear (r, c) as Game_ClearCell does */
+static void clear_cell(ReplayState *s, int r, int c) {
+	int old = Board_Value(&s->board, r, c);
+	Board_Set(&s->board, r, c, 0, false);
+	Board_SetNotes(&s->board, r, c, 0);
+	if (s->autoNotes && old) Board_RestoreCandidates(&s->board, r, c, old);
+}
+
+void Replay_Apply(ReplayState *s, uint32_t event) {
+	Board *b = &s->board;
+	ReplayEventKind kind = Replay_Kind(event);
+	int cell = Replay_Cell(event), arg = Replay_Arg(event);
+	int r = cell / BOARD_SIZE_MAX, c = cell % BOARD_SIZE_MAX;
+	s->ms += delta_of(event);
+
+	/* every move happens at the selected cell */
+	bool move = kind == REPLAY_DIGIT || kind == REPLAY_CLEAR || kind == REPLAY_NOTE
+		|| kind == REPLAY_COLOR;
+	if (move || kind == REPLAY_SELECT) {
+		s->selRow = r;
+		s->selCol = c;
+	}
+	bool given = Board_IsGiven(b, r, c);
+	int old = Board_Value(b, r, c);
+
+	switch (kind) {
+	case REPLAY_DIGIT:
+		if (given) break;
+		if (s->autoNotes && old && old != arg) clear_cell(s, r, c);
+		Board_Set(b, r, c, arg, false);
+		Board_SetNotes(b, r, c, 0);
+		Board_ClearNotesAffectedBy(b, r, c, arg);
+		break;
+	case REPLAY_CLEAR:
+		if (!given) clear_cell(s, r, c);
+		break;
+	case REPLAY_NOTE:
+		if (!given) Board_ToggleNote(b, r, c, arg);
+		break;
+	case REPLAY_COLOR:
+		Board_SetColor(b, r, c, arg);
+		break;
+	case REPLAY_PAUSE:
+		s->paused = arg;
+		break;
+	case REPLAY_AUTO_NOTES:
+		s->autoNotes = arg;
+		if (arg) Board_FillCandidates(b);
+		break;
+	case REPLAY_CELL:
+		if (!given) Board_Set(b, r, c, arg, false);
+		Board_SetColor(b, r, c, (int) ((event >> 15) & 0xF));
+		Board_SetNotes(b, r, c, (uint16_t) (((event >> 19) & 0x1FF) << 1));
+		break;
+	default:
+		/* undo and redo come with their cells, the rest only carry time */
+		break;
+	}
+}
+
+/* recording */
+
+static bool push_event(Replay *r, uint32_t event) {
+	if (r->eventCount == r->eventCapacity) {
+		int cap = r->eventCapacity ? r->eventCapacity * 2 : 1024;
+		uint32_t *events = realloc(r->events, cap * sizeof(*events));
+		if (!events) return false;
+		r->events = events;
+		r->eventCapacity = cap;
+	}
+	r->events[r->eventCount++] = event;
+	return true;
+}
+
+static bool push_keyframe(Replay *r, const ReplayState *s) {
+	if (r->keyCount == r->keyCapacity) {
+		int cap = r->keyCapacity ? r->keyCapacity * 2 : 64;
+		ReplayKeyframe *keys = realloc(r->keys, cap * sizeof(*keys));
+		if (!keys) return false;
+		r->keys = keys;
+		r->keyCapacity = cap;
+	}
+	if (r->recordBytes + PUZZLE_RECORD_MAX > r->recordCapacity) {
+		size_t cap = r->recordCapacity ? r->recordCapacity * 2 : 16384;
+		uint8_t *records = realloc(r->records, cap);
+		if (!records) return false;
+		r->records = records;
+		r->recordCapacity = cap;
+	}
+
+	/* no meta, the title is the replay's */
+	Puzzle p = { .meta = { "untitled", "unknown" }, .board = s->board };
+	size_t size = Puzzle_ToRecord(&p, NULL, r->records + r->recordBytes);
+	r->keys[r->keyCount++] = (ReplayKeyframe) { .event = (uint32_t) r->eventCount,
+		.ms = s->ms,
+		.record = (uint32_t) r->recordBytes,
+		.selRow = (uint8_t) s->selRow,
+		.selCol = (uint8_t) s->selCol,
+		.flags = (uint8_t) ((s->paused ? KEY_PAUSED : 0)
+			| (s->autoNotes ? KEY_AUTO_NOTES : 0)) };
+	r->recordBytes += size;
+	return true;
+}
+
+/* ms on the recording's clock, which only moves in whole ms */
+static uint32_t clock_of(const ReplayRecorder *rec, double now) {
+	double ms = floor((now - rec->startTime) * 1000.0);
+	return ms < rec->last.ms ? rec->last.ms : (uint32_t) ms;
+}
+
+/* append an event and apply it to rec->last, the delta is filled in here */
+static void record(ReplayRecorder *rec, uint32_t event, double now) {
+	Replay *r = &rec->replay;
+	if (Replay_Kind(event) != REPLAY_CELL) {
+		uint32_t delta = clock_of(rec, now) - rec->last.ms;
+		if (delta > REPLAY_DELTA_MAX) {
+			uint32_t wait = (uint32_t) REPLAY_WAIT | delta << 4;
+			if (!push_event(r, wait)) return;
+			Replay_Apply(&rec->last, wait);
+			rec->sinceKey++;
+			delta = 0;
+		}
+		event |= delta << 15;
+	}
+	if (!push_event(r, event)) return;
+	Replay_Apply(&rec->last, event);
+	rec->sinceKey++;
+}
+
+/* after a move's cells are in, so a keyframe never splits one */
+static void maybe_keyframe(ReplayRecorder *rec) {
+	if (rec->sinceKey < REPLAY_KEYFRAME_EVENTS) return;
+	if (push_keyframe(&rec->replay, &rec->last)) rec->sinceKey = 0;
+}
+
+void ReplayRecorder_Begin(
+	ReplayRecorder *rec, const ReplayState *start, const char *title, double now) {
+	Replay_Free(&rec->replay);
+	snprintf(rec->replay.title, sizeof(rec->replay.title), "%s", title);
+	rec->last = *start;
+	rec->last.ms = 0;
+	rec->startTime = now;
+	rec->sinceKey = 0;
+	rec->recording = push_keyframe(&rec->replay, &rec->last);
+}
+
+void ReplayRecorder_Move(ReplayRecorder *rec,
+	ReplayEventKind kind,
+	int r,
+	int c,
+	int arg,
+	const Board *after,
+	double now) {
+	if (!rec->recording) return;
+	record(rec, encode(kind, BOARD_CELL(r, c), arg, 0), now);
+
+	/* whatever replaying the move got wrong, cell by cell */
+	Board *b = &rec->last.board;
+	for (int rr = 0; rr < BOARD_SIZE; rr++)
+		for (int cc = 0; cc < BOARD_SIZE; cc++) {
+			int i = BOARD_CELL(rr, cc);
+			uint32_t want = encode_cell(after, i);
+			if (want != encode_cell(b, i)) record(rec, want, now);
+		}
+	maybe_keyframe(rec);
+}
+
+void ReplayRecorder_Poll(
+	ReplayRecorder *rec, int selRow, int selCol, bool paused, double now) {
+	if (!rec->recording) return;
+	ReplayState *s = &rec->last;
+	if (selRow != s->selRow || selCol != s->selCol)
+		record(rec, encode(REPLAY_SELECT, BOARD_CELL(selRow, selCol), 0, 0), now);
+	if (paused != s->paused) record(rec, encode(REPLAY_PAUSE, 0, paused, 0), now);
+	maybe_keyframe(rec);
+}
+
+/* the directory replays go to, made on first use */
+static bool make_directory(const char *directory) {
+	struct stat st;
+	if (stat(directory, &st) == 0) return S_ISDIR(st.st_mode);
+#ifdef _WIN32
+	return _mkdir(directory) == 0;
+#else
+	return mkdir(directory, 0755) == 0;
+#endif
+}
+
+void ReplayRecorder_End(ReplayRecorder *rec, const char *directory) {
+	if (!rec->recording) return;
+	rec->recording = false;
+
+	/* a replay of looking at the board is not worth keeping */
+	bool played = false;
+	for (int i = 0; i < rec->replay.eventCount && !played; i++) {
+		ReplayEventKind kind = Replay_Kind(rec->replay.events[i]);
+		played = kind != REPLAY_SELECT && kind != REPLAY_PAUSE;
+		played = played && kind != REPLAY_WAIT;
+	}
+	if (played && !Replay_Verify(&rec->replay)) {
+		/* Replay_Load would turn it down, and the recorder is what is wrong */
+		fprintf(stderr, "replay: recording does not play back, not kept\n");
+	} else if (played && !make_directory(directory)) {
+		fprintf(stderr, "replay: cannot create %s\n", directory);
+	} else if (played) {
+		char name[32], path[MAX_FILEPATH_LEN];
+		time_t t = time(NULL);
+		strftime(name, sizeof(name), "%Y%m%d-%H%M%S", localtime(&t));
+		snprintf(path, sizeof(path), "%s/replay-%s.rpl", directory, name);
+		if (!Replay_Save(&rec->replay, path))
+			fprintf(stderr, "replay: cannot write %s\n", path);
+	}
+	Replay_Free(&rec->replay);
+}
+
+/* files */
+
+/* newest first, the recorder's names sort by time */
+static int compare_names(const void *a, const void *b) {
+	return strcmp((const char *) b, (const char *) a);
+}
+
+int Replay_List(const char *directory, char (*names)[REPLAY_NAME_MAX], int max) {
+	DIR *dir = opendir(directory);
+	if (!dir) return 0;
+
+	int found = 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL && max > 0) {
+		const char *name = entry->d_name;
+		size_t len = strlen(name);
+		if (len <= 4 || len >= REPLAY_NAME_MAX) continue;
+		if (strcmp(name + len - 4, ".rpl") != 0) continue;
+
+		int slot = found;
+		if (found == max) {
+			/* full, the oldest name makes room for a newer one */
+			slot = 0;
+			for (int i = 1; i < found; i++)
+				if (strcmp(names[i], names[slot]) < 0) slot = i;
+			if (strcmp(name, names[slot]) <= 0) continue;
+		}
+		else {
+			found++;
+		}
+		memcpy(names[slot], name, len + 1);
+	}
+	closedir(dir);
+	qsort(names, found, sizeof(names[0]), compare_names);
+	return found;
+}
+
+static bool write_all(FILE *f, const void *data, size_t size, size_t count) {
+	return count == 0 || fwrite(data, size, count, f) == count;
+}
+
+bool Replay_Save(const Replay *r, const char *path) {
+	ReplayHeader h = { .version = REPLAY_VERSION,
+		.boardSize = BOARD_SIZE,
+		.eventCount = (uint32_t) r->eventCount,
+		.keyCount = (uint32_t) r->keyCount,
+		.recordBytes = r->recordBytes };
+	memcpy(h.magic, REPLAY_MAGIC, sizeof(h.magic));
+	memcpy(h.title, r->title, sizeof(h.title));
+
+	FILE *f = fopen(path, "wb");
+	if (!f) return false;
+	bool ok = write_all(f, &h, sizeof(h), 1);
+	ok = ok && write_all(f, r->keys, sizeof(*r->keys), (size_t) r->keyCount);
+	ok = ok && write_all(f, r->records, 1, r->recordBytes);
+	ok = ok && write_all(f, r->events, sizeof(*r->events), (size_t) r->eventCount);
+	ok = fclose(f) == 0 && ok;
+	if (!ok) remove(path);
+	return ok;
+}
+
+static bool read_all(FILE *f, void *data, size_t size, size_t count) {
+	return count == 0 || fread(data, size, count, f) == count;
+}
+
+bool Replay_Load(Replay *r, const char *path) {
+	*r = (Replay) { 0 };
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+
+	ReplayHeader h;
+	bool ok = fread(&h, sizeof(h), 1, f) == 1;
+	ok = ok && memcmp(h.magic, REPLAY_MAGIC, sizeof(h.magic)) == 0;
+	ok = ok && h.version == REPLAY_VERSION && h.boardSize == (uint32_t) BOARD_SIZE;
+	ok = ok && h.keyCount > 0 && h.eventCount < (1u << 28) && h.keyCount < (1u << 24);
+	ok = ok && h.recordBytes < ((uint64_t) h.keyCount * PUZZLE_RECORD_MAX);
+	if (ok) {
+		/* + 1 so an empty section still gets a pointer */
+		r->keys = malloc(h.keyCount * sizeof(*r->keys));
+		r->records = malloc(h.recordBytes + 1);
+		r->events = malloc((h.eventCount + 1) * sizeof(*r->events));
+		ok = r->keys && r->records && r->events;
+	}
+	ok = ok && read_all(f, r->keys, sizeof(*r->keys), h.keyCount);
+	ok = ok && read_all(f, r->records, 1, h.recordBytes);
+	ok = ok && read_all(f, r->events, sizeof(*r->events), h.eventCount);
+	fclose(f);
+
+	/* keyframes have to point inside the replay and on the board, in order */
+	for (uint32_t i = 0; ok && i < h.keyCount; i++) {
+		const ReplayKeyframe *k = &r->keys[i];
+		const ReplayKeyframe *prev = i ? &r->keys[i - 1] : NULL;
+		ok = k->event <= h.eventCount && k->record < h.recordBytes
+			&& k->selRow < BOARD_SIZE && k->selCol < BOARD_SIZE
+			&& (!prev || (k->event >= prev->event && k->ms >= prev->ms));
+	}
+	for (uint32_t i = 0; ok && i < h.eventCount; i++)
+		ok = valid_event(r->events[i]);
+
+	if (ok) {
+		r->eventCount = r->eventCapacity = (int) h.eventCount;
+		r->keyCount = r->keyCapacity = (int) h.keyCount;
+		r->recordBytes = r->recordCapacity = (size_t) h.recordBytes;
+		ok = Replay_Verify(r);
+	}
+	if (!ok) {
+		Replay_Free(r);
+		return false;
+	}
+
+	memcpy(r->title, h.title, sizeof(r->title));
+	r->title[sizeof(r->title) - 1] = '\0';
+	return true;
+}
+
+/* playback */
+
+void ReplayPlayer_Init(ReplayPlayer *p, const Replay *r) {
+	*p = (ReplayPlayer) { .replay = r, .speed = REPLAY_SPEED_MIN };
+	ReplayPlayer_Seek(p, 0);
+}
+
+void ReplayPlayer_SetSpeed(ReplayPlayer *p, double speed) {
+	if (speed < REPLAY_SPEED_MIN) speed = REPLAY_SPEED_MIN;
+	if (speed > REPLAY_SPEED_MAX) speed = REPLAY_SPEED_MAX;
+	p->speed = speed;
+}
+
+/* apply events up to and including those at ms */
+static void play_until(ReplayPlayer *p, double ms) {
+	const Replay *r = p->replay;
+	while (p->next < r->eventCount) {
+		uint32_t event = r->events[p->next];
+		if (p->state.ms + delta_of(event) > ms) break;
+		Replay_Apply(&p->state, event);
+		p->next++;
+	}
+	p->position = ms;
+}
+
+/* the state at keyframe i, false if its board does not decode */
+static bool start_at(ReplayPlayer *p, int i) {
+	const Replay *r = p->replay;
+	const ReplayKeyframe *k = &r->keys[i];
+	Puzzle puzzle;
+	size_t len = r->recordBytes - k->record;
+	if (!Puzzle_FromRecord(&puzzle, NULL, r->records + k->record, len)) return false;
+	p->state = (ReplayState) { .board = puzzle.board,
+		.selRow = k->selRow,
+		.selCol = k->selCol,
+		.paused = k->flags & KEY_PAUSED,
+		.autoNotes = k->flags & KEY_AUTO_NOTES,
+		.ms = k->ms };
+	p->next = (int) k->event;
+	p->position = k->ms;
+	return true;
+}
+
+bool ReplayPlayer_Seek(ReplayPlayer *p, uint32_t ms) {
+	const Replay *r = p->replay;
+	if (r->keyCount == 0) return false;
+
+	/* the last keyframe at or before ms */
+	int lo = 0, hi = r->keyCount - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (r->keys[mid].ms <= ms)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	if (!start_at(p, lo)) return false;
+	play_until(p, ms);
+	return true;
+}
+
+void ReplayPlayer_Advance(ReplayPlayer *p, double seconds) {
+	play_until(p, p->position + seconds * 1000.0 * p->speed);
+}
+
+static bool same_state(const ReplayState *a, const ReplayState *b) {
+	if (a->selRow != b->selRow || a->selCol != b->selCol || a->paused != b->paused
+		|| a->autoNotes != b->autoNotes || a->ms != b->ms)
+		return false;
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			int i = BOARD_CELL(r, c);
+			bool given = Board_IsGiven(&a->board, r, c);
+			if (encode_cell(&a->board, i) != encode_cell(&b->board, i)
+				|| given != Board_IsGiven(&b->board, r, c))
+				return false;
+		}
+	return true;
+}
+
+bool Replay_Verify(const Replay *r) {
+	ReplayPlayer linear = { .replay = r }, seek = { .replay = r };
+	if (r->keyCount == 0 || !start_at(&linear, 0)) return false;
+	for (int i = 0; i < r->keyCount; i++) {
+		uint32_t ms = r->keys[i].ms;
+		play_until(&linear, ms);
+		if (!ReplayPlayer_Seek(&seek, ms)) return false;
+		if (seek.next != linear.next || !same_state(&seek.state, &linear.state))
+			return false;
+	}
+	return true;
+}
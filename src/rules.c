@@ -0,0 +1,191 @@
+/* src/rules.c
+ * compiled variant constraints
+ */
+
+#include <string.h>
+
+#include "rules.h"
+
+RuleSet g_rules;
+
+static bool cell_ok(int cell) {
+	int r = cell / BOARD_SIZE_MAX, c = cell % BOARD_SIZE_MAX;
+	return cell >= 0 && r < BOARD_SIZE && c < BOARD_SIZE;
+}
+
+/* the cells as a set, false if one is off the board or listed twice */
+static bool cell_set(const int *cells, int count, BoardSet *set) {
+	*set = (BoardSet) { 0, 0 };
+	for (int i = 0; i < count; i++) {
+		if (!cell_ok(cells[i]) || BoardSet_Test(*set, cells[i])) return false;
+		*set = BoardSet_Or(*set, BoardSet_Bit(cells[i]));
+	}
+	return true;
+}
+
+void Rules_Clear(RuleSet *rs) {
+	memset(rs, 0, sizeof(*rs));
+	memset(rs->cageOf, -1, sizeof(rs->cageOf));
+}
+
+bool Rules_AddRegion(RuleSet *rs, const int *cells, int count) {
+	if (rs->regionCount >= RULES_REGIONS_MAX || count < 2 || count > BOARD_SIZE)
+		return false;
+	BoardSet set;
+	if (!cell_set(cells, count, &set)) return false;
+
+	for (int i = 0; i < count; i++)
+		rs->regionsOf[cells[i]] |= 1u << rs->regionCount;
+	rs->regions[rs->regionCount++] = set;
+	return true;
+}
+
+int Rules_AddRelation(RuleSet *rs, const uint16_t forbid[BOARD_SIZE_MAX + 1]) {
+	if (rs->relationCount + 2 > RULES_RELATIONS_MAX) return -1;
+	int id = rs->relationCount;
+	rs->relationCount += 2;
+
+	/* the same relation seen from the second cell: w there rules out v here */
+	uint16_t *fwd = rs->forbid[id], *back = rs->forbid[id + 1];
+	for (int v = 1; v <= BOARD_SIZE; v++) {
+		fwd[v] = forbid[v] & (uint16_t) ((1u << BOARD_SIZE) - 1);
+		for (int w = 1; w <= BOARD_SIZE; w++)
+			if (fwd[v] & (1u << (w - 1)))
+				back[w] |= (uint16_t) (1u << (v - 1));
+	}
+	return id;
+}
+
+static void add_link(RuleSet *rs, int owner, int other, int relation) {
+	rs->links[rs->linkCount++] = (RuleLink) { .cell = (uint8_t) owner,
+		.row = (uint8_t) (other / BOARD_SIZE_MAX),
+		.col = (uint8_t) (other % BOARD_SIZE_MAX),
+		.relation = (uint8_t) relation };
+}
+
+bool Rules_Link(RuleSet *rs, int relation, int first, int second) {
+	if (relation < 0 || relation + 1 >= rs->relationCount) return false;
+	if (!cell_ok(first) || !cell_ok(second) || first == second) return false;
+	if (rs->linkCount + 2 > RULES_LINKS_MAX) return false;
+
+	add_link(rs, second, first, relation);
+	add_link(rs, first, second, relation + 1);
+	return true;
+}
+
+bool Rules_AddCage(RuleSet *rs, const int *cells, int count, int sum) {
+	if (rs->cageCount >= RULES_CAGES_MAX || count < 1 || count > BOARD_SIZE)
+		return false;
+	if (sum < 1 || sum > RULES_SUM_MAX) return false;
+	BoardSet set;
+	if (!cell_set(cells, count, &set)) return false;
+	for (int i = 0; i < count; i++)
+		if (rs->cageOf[cells[i]] >= 0) return false;
+
+	for (int i = 0; i < count; i++)
+		rs->cageOf[cells[i]] = (int8_t) rs->cageCount;
+	rs->cages[rs->cageCount++] = (RuleCage) { set, sum, count };
+	return true;
+}
+
+/* fnv-1a */
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+	const uint8_t *p = data;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+void Rules_Finish(RuleSet *rs) {
+	/* counting sort of the links by owner */
+	RuleLink sorted[RULES_LINKS_MAX];
+	memset(rs->linkStart, 0, sizeof(rs->linkStart));
+	for (int i = 0; i < rs->linkCount; i++)
+		rs->linkStart[rs->links[i].cell + 1]++;
+	for (int i = 0; i < BOARD_CELLS_MAX; i++)
+		rs->linkStart[i + 1] += rs->linkStart[i];
+	uint16_t next[BOARD_CELLS_MAX];
+	memcpy(next, rs->linkStart, sizeof(next));
+	for (int i = 0; i < rs->linkCount; i++)
+		sorted[next[rs->links[i].cell]++] = rs->links[i];
+	memcpy(rs->links, sorted, rs->linkCount * sizeof(*sorted));
+
+	for (int i = 0; i < BOARD_CELLS_MAX; i++) {
+		BoardSet peers = { 0, 0 };
+		for (uint32_t regs = rs->regionsOf[i]; regs; regs &= regs - 1)
+			peers = BoardSet_Or(peers, rs->regions[__builtin_ctz(regs)]);
+		rs->regionPeers[i] = BoardSet_AndNot(peers, BoardSet_Bit(i));
+	}
+
+	memset(rs->combos, 0, sizeof(rs->combos));
+	for (unsigned set = 0; set < 1u << BOARD_SIZE; set++) {
+		int sum = 0;
+		for (int v = 1; v <= BOARD_SIZE; v++)
+			if (set & (1u << (v - 1))) sum += v;
+		rs->combos[__builtin_popcount(set)][sum] |= (uint16_t) set;
+	}
+
+	bool any = rs->regionCount || rs->linkCount || rs->cageCount;
+	rs->size = any ? BOARD_SIZE : 0;
+
+	uint64_t h = 14695981039346656037ull;
+	h = hash_bytes(h, &rs->size, sizeof(rs->size));
+	h = hash_bytes(h, rs->regions, rs->regionCount * sizeof(*rs->regions));
+	h = hash_bytes(h, rs->forbid, rs->relationCount * sizeof(*rs->forbid));
+	h = hash_bytes(h, rs->links, rs->linkCount * sizeof(*rs->links));
+	h = hash_bytes(h, rs->cages, rs->cageCount * sizeof(*rs->cages));
+	rs->hash = h;
+}
+
+BoardSet Rules_Peers(const RuleSet *rs, int cell) {
+	BoardSet peers = rs->regionPeers[cell];
+	for (int k = rs->linkStart[cell]; k < rs->linkStart[cell + 1]; k++) {
+		const RuleLink *l = &rs->links[k];
+		peers = BoardSet_Or(peers, BoardSet_Bit(BOARD_CELL(l->row, l->col)));
+	}
+	if (rs->cageOf[cell] >= 0) {
+		BoardSet cage = rs->cages[rs->cageOf[cell]].cells;
+		peers = BoardSet_Or(peers, BoardSet_AndNot(cage, BoardSet_Bit(cell)));
+	}
+	return peers;
+}
+
+bool Rules_Allows(const RuleSet *rs, const Board *b, int r, int c, int v) {
+	int cell = BOARD_CELL(r, c);
+	uint16_t bit = (uint16_t) (1u << (v - 1));
+
+	if (BoardSet_Any(BoardSet_And(b->digits[v - 1], rs->regionPeers[cell])))
+		return false;
+
+	for (int k = rs->linkStart[cell]; k < rs->linkStart[cell + 1]; k++) {
+		const RuleLink *l = &rs->links[k];
+		int w = b->value[BOARD_CELL(l->row, l->col)];
+		if (w && (rs->forbid[l->relation][w] & bit)) return false;
+	}
+
+	if (rs->cageOf[cell] < 0) return true;
+	const RuleCage *cage = &rs->cages[rs->cageOf[cell]];
+	BoardSet others = BoardSet_AndNot(cage->cells, BoardSet_Bit(cell));
+	if (BoardSet_Any(BoardSet_And(b->digits[v - 1], others))) return false;
+
+	int left = cage->sum - v, empty = 0;
+	int i;
+	while ((i = BoardSet_Pop(&others)) >= 0) {
+		if (b->value[i])
+			left -= b->value[i];
+		else
+			empty++;
+	}
+	if (left < 0) return false;
+	return empty ? left <= RULES_SUM_MAX && rs->combos[empty][left] : left == 0;
+}
+
+void Rules_FindConflicts(const RuleSet *rs, const Board *b, BoardSet *conflicts) {
+	for (int r = 0; r < BOARD_SIZE; r++)
+		for (int c = 0; c < BOARD_SIZE; c++) {
+			int v = Board_Value(b, r, c);
+			if (!v || Rules_Allows(rs, b, r, c, v)) continue;
+			BoardSet bit = BoardSet_Bit(BOARD_CELL(r, c));
+			*conflicts = BoardSet_Or(*conflicts, bit);
+		}
+}
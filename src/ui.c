@@ -2,70 +2,16 @@
  * ui handlers
  */
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "raylib.h"
 
 #include "ui.h"
 #include "puzzle_loader.h"
-
-/* caching color values */
-typedef struct ThemeColors {
-	Color bg;
-	Color grid;
-	Color gridBold;
-	Color cellBg;
-	Color cellSel;
-	Color digitGiven;
-	Color digitUser;
-	Color accent;
-	Color text;
-	Color bad;
-	Color highlightRowCol;
-	Color highlightDigit;
-	Color topbarBg;
-	Color topbarText;
-	Color menuText;
-	Color menuSel;
-	Color menuSelBg;
-	Color cellColors[CELL_COLOR_COUNT];
-} ThemeColors;
-
-/* a bit forward thinking: conversion of a theme to cached color
- * TODO: themeing as a user customization :)
- */
-static ThemeColors CacheThemeColors(const Theme *theme) {
-	ThemeColors colors = { .bg = ColorFromUInt(theme->bg),
-		.grid = ColorFromUInt(theme->grid),
-		.gridBold = ColorFromUInt(theme->gridBold),
-		.cellBg = ColorFromUInt(theme->cellBg),
-		.cellSel = ColorFromUInt(theme->cellSel),
-		.digitGiven = ColorFromUInt(theme->digitGiven),
-		.digitUser = ColorFromUInt(theme->digitUser),
-		.accent = ColorFromUInt(theme->accent),
-		.text = ColorFromUInt(theme->text),
-		.bad = ColorFromUInt(theme->bad),
-		.highlightRowCol = ColorFromUInt(theme->highlightRowCol),
-		.highlightDigit = ColorFromUInt(theme->highlightDigit),
-		.topbarBg = ColorFromUInt(theme->topbarBg),
-		.topbarText = ColorFromUInt(theme->topbarText),
-		.menuText = ColorFromUInt(theme->menuText),
-		.menuSel = ColorFromUInt(theme->menuSel),
-		.menuSelBg = ColorFromUInt(theme->menuSelBg) };
-	for (int i = 0; i < CELL_COLOR_COUNT; i++) {
-		colors.cellColors[i] = ColorFromUInt(theme->cellColors[i]);
-	}
-	return colors;
-}
-
-/* get board pos and size */
-static Rectangle BoardRect(void) {
-	Rectangle rect = {
-		BOARD_PAD, TOPBAR_H + BOARD_PAD, TILE_PIX * BOARD_SIZE, TILE_PIX * BOARD_SIZE
-	};
-	return rect;
-}
+#include "profiler.h"
 
 /* uint to raylib color conversion */
 Color ColorFromUInt(unsigned int c) {
@@ -89,6 +35,11 @@ Theme Theme_Default(void) {
 		.bad = COLOR_BAD,
 		.highlightRowCol = COLOR_HIGHLIGHT_ROW_COL,
 		.highlightDigit = COLOR_HIGHLIGHT_DIGIT,
+		.topbarBg = COLOR_TOPBAR_BG,
+		.topbarText = COLOR_TOPBAR_TEXT,
+		.menuText = COLOR_MENU_TEXT,
+		.menuSel = COLOR_MENU_SEL,
+		.menuSelBg = COLOR_MENU_SEL_BG,
 		.cellColors = { 0, // CELL_COLOR_NONE
 			COLOR_PALETTE_RED,
 			COLOR_PALETTE_ORANGE,
@@ -122,12 +73,113 @@ static void DrawGridLines(Rectangle boardRect, const ThemeColors *colors) {
 	}
 }
 
+/* digits 1-9 pre-rasterized in white at the digit and note font sizes, drawn
+ * tinted straight from one texture so a whole board is a single batch of
+ * quads. glyphs are rendered at their final pixel size, so nothing is scaled
+ * at draw time. with FONT_PATH set they come from that font's outlines, sharp
+ * at any size, otherwise from the built-in bitmap font scaled up
+ */
+typedef struct GlyphAtlas {
+	Texture2D texture;
+	Rectangle digit[10]; /* [v] at FONT_SIZE_DIGIT, [0] unused */
+	Rectangle note[10]; /* [v] at FONT_SIZE_NOTE */
+	int digitSize, noteSize;
+	char path[sizeof(g_config.font_path)];
+	bool valid;
+} GlyphAtlas;
+
+static GlyphAtlas s_glyphs;
+
+#define GLYPH_ATLAS_PAD 2
+
+/* FONT_PATH rasterized at size for just the digits, false if there is none
+ * or it does not load
+ */
+static bool GlyphAtlas_LoadFont(Font *font, int size) {
+	if (!FONT_PATH[0]) return false;
+	if (FileExists(FONT_PATH)) {
+		int digits[9];
+		for (int v = 1; v <= 9; v++)
+			digits[v - 1] = '0' + v;
+		*font = LoadFontEx(FONT_PATH, size, digits, 9);
+		if (IsFontValid(*font)) return true;
+	}
+	fprintf(stderr, "warning: cannot load font '%s', using the default\n", FONT_PATH);
+	return false;
+}
+
+/* (re)build the atlas if the font or its sizes changed, true if it was
+ * rebuilt
+ */
+static bool GlyphAtlas_Refresh(GlyphAtlas *atlas) {
+	if (atlas->valid && atlas->digitSize == FONT_SIZE_DIGIT
+		&& atlas->noteSize == FONT_SIZE_NOTE
+		&& strcmp(atlas->path, FONT_PATH) == 0)
+		return false;
+	if (atlas->valid) UnloadTexture(atlas->texture);
+
+	/* digits on the first row, notes on the second */
+	Image glyphs[2][10];
+	int sizes[2] = { FONT_SIZE_DIGIT, FONT_SIZE_NOTE };
+	int width = 0;
+	bool outlines = false;
+	for (int row = 0; row < 2; row++) {
+		Font font;
+		bool loaded = GlyphAtlas_LoadFont(&font, sizes[row]);
+		int rowWidth = GLYPH_ATLAS_PAD;
+		for (int v = 1; v <= 9; v++) {
+			char text[2] = { '0' + v, '\0' };
+			glyphs[row][v] = loaded
+				? ImageTextEx(font, text, (float) sizes[row], 0, WHITE)
+				: ImageText(text, sizes[row], WHITE);
+			rowWidth += glyphs[row][v].width + GLYPH_ATLAS_PAD;
+		}
+		if (rowWidth > width) width = rowWidth;
+		if (loaded) UnloadFont(font);
+		outlines = outlines || loaded;
+	}
+
+	int height = sizes[0] + sizes[1] + 3 * GLYPH_ATLAS_PAD;
+	Image image = GenImageColor(width, height, BLANK);
+	int y = GLYPH_ATLAS_PAD;
+	for (int row = 0; row < 2; row++) {
+		Rectangle *rects = row == 0 ? atlas->digit : atlas->note;
+		int x = GLYPH_ATLAS_PAD;
+		for (int v = 1; v <= 9; v++) {
+			Image glyph = glyphs[row][v];
+			Rectangle src = { 0, 0, glyph.width, glyph.height };
+			rects[v] = (Rectangle) { x, y, glyph.width, glyph.height };
+			ImageDraw(&image, glyph, src, rects[v], WHITE);
+			UnloadImage(glyph);
+			x += glyph.width + GLYPH_ATLAS_PAD;
+		}
+		y += sizes[row] + GLYPH_ATLAS_PAD;
+	}
+
+	/* a real font comes out antialiased, the bitmap one should stay crisp */
+	atlas->texture = LoadTextureFromImage(image);
+	int filter = outlines ? TEXTURE_FILTER_BILINEAR : TEXTURE_FILTER_POINT;
+	SetTextureFilter(atlas->texture, filter);
+	UnloadImage(image);
+
+	atlas->digitSize = FONT_SIZE_DIGIT;
+	atlas->noteSize = FONT_SIZE_NOTE;
+	snprintf(atlas->path, sizeof(atlas->path), "%s", FONT_PATH);
+	atlas->valid = true;
+	return true;
+}
+
+static void DrawGlyph(Rectangle glyph, int x, int y, Color color) {
+	PROFILE_COUNT(PROF_DRAWS);
+	DrawTextureRec(s_glyphs.texture, glyph, (Vector2) { x, y }, color);
+}
+
 /* draw notes in a cell */
 static void DrawCellNotes(Rectangle cell,
 	unsigned int notes,
 	int row,
 	int col,
-	const Game *g,
+	const BoardView *v,
 	const ThemeColors *colors) {
 	/* pre-compute note cell size */
 	const int noteCellSize = TILE_PIX / NOTE_GRID_SIZE;
@@ -143,49 +195,48 @@ static void DrawCellNotes(Rectangle cell,
 			int y = cell.y + NOTE_PADDING_Y + noteRow * noteCellSize;
 
 			/* check note validity */
-			Color noteColor = Board_IsValidMove(&g->board, row, col, noteNum)
-				? colors->text
-				: colors->bad;
+			bool noteBad = BoardSet_Test(
+				v->noteConflicts[noteNum - 1], BOARD_CELL(row, col));
+			Color noteColor = noteBad ? colors->bad : colors->text;
 
-			char noteText[2] = { '0' + noteNum, '\0' };
-			DrawText(noteText, x, y, FONT_SIZE_NOTE, noteColor);
+			DrawGlyph(s_glyphs.note[noteNum], x, y, noteColor);
 		}
 	}
 }
 
 /* draw contents in a cell */
-static void DrawCellContent(Rectangle cell,
-	const Cell *cellData,
-	int row,
-	int col,
-	const Game *g,
-	const ThemeColors *colors) {
-	if (cellData->value) {
+static void DrawCellContent(
+	Rectangle cell, int row, int col, const BoardView *v, const ThemeColors *colors) {
+	int value = Board_Value(v->board, row, col);
+	if (value) {
 		/* draw the digit */
-		char digitText[2] = { '0' + cellData->value, '\0' };
-		int textWidth = MeasureText(digitText, FONT_SIZE_DIGIT);
-		Color digitColor = cellData->given ? colors->digitGiven : colors->digitUser;
+		Rectangle glyph = s_glyphs.digit[value];
+		Color digitColor = Board_IsGiven(v->board, row, col)
+			? colors->digitGiven
+			: colors->digitUser;
 
 		/* highlight conflicts if enabled */
-		if (g->highlightConflicts
-			&& !Board_IsValidMove(&g->board, row, col, cellData->value)) {
+		if (v->highlightConflicts
+			&& BoardSet_Test(*v->conflicts, BOARD_CELL(row, col))) {
 			digitColor = colors->bad;
 		}
 
 		/* center the digit in the cell */
-		int x = cell.x + (TILE_PIX - textWidth) / 2;
+		int x = cell.x + (TILE_PIX - (int) glyph.width) / 2;
 		int y = cell.y + (TILE_PIX - FONT_SIZE_DIGIT) / 2;
-		DrawText(digitText, x, y, FONT_SIZE_DIGIT, digitColor);
+		DrawGlyph(glyph, x, y, digitColor);
 	}
-	else if (cellData->notes) {
+	else {
 		/* draw notes in the cell */
-		DrawCellNotes(cell, cellData->notes, row, col, g, colors);
+		unsigned int notes = Board_GetNotes(v->board, row, col);
+		if (notes) DrawCellNotes(cell, notes, row, col, v, colors);
 	}
 }
 
 /* draw the top bar with title, timer, and mode indicator */
 void UI_DrawTopBar(const Game *g) {
-	DrawRectangle(0, 0, WINDOW_W, TOPBAR_H, ColorFromUInt(COLOR_TOPBAR_BG));
+	const ThemeColors *colors = &g_layout.colors;
+	DrawRectangle(0, 0, WINDOW_W, TOPBAR_H, colors->topbarBg);
 
 	static char defaultTitle[128];
 	const char *title;
@@ -200,7 +251,7 @@ void UI_DrawTopBar(const Game *g) {
 		TOPBAR_PADDING,
 		TOPBAR_PADDING,
 		FONT_SIZE_TOPBAR,
-		ColorFromUInt(COLOR_TOPBAR_TEXT));
+		colors->topbarText);
 
 	if (g->screen == SCREEN_PLAY) {
 		/* draw timer in the center */
@@ -209,63 +260,190 @@ void UI_DrawTopBar(const Game *g) {
 		char timerText[16];
 		snprintf(timerText, sizeof(timerText), "%02d:%02d", minutes, seconds);
 
-		int timerWidth = MeasureText(timerText, FONT_SIZE_TOPBAR);
+		int timerWidth = Layout_TextWidth(timerText, FONT_SIZE_TOPBAR);
 		int timerX = WINDOW_W / 2 - timerWidth / 2;
-		Color timerColor = g->paused ? ColorFromUInt(COLOR_ACCENT)
-					     : ColorFromUInt(COLOR_TOPBAR_TEXT);
+		Color timerColor = g->paused ? colors->accent : colors->topbarText;
 		DrawText(timerText, timerX, TOPBAR_PADDING, FONT_SIZE_TOPBAR, timerColor);
 
 		/* draw pause/play button */
 		const char *pauseText = g->paused ? ">" : "||";
-		int pauseWidth = MeasureText(pauseText, FONT_SIZE_TOPBAR);
+		int pauseWidth = Layout_TextWidth(pauseText, FONT_SIZE_TOPBAR);
 		int pauseX = timerX - pauseWidth - TOPBAR_PADDING;
 
-		Color pauseColor = g->paused ? ColorFromUInt(COLOR_ACCENT)
-					     : ColorFromUInt(COLOR_TOPBAR_TEXT);
+		Color pauseColor = g->paused ? colors->accent : colors->topbarText;
 		DrawText(pauseText, pauseX, TOPBAR_PADDING, FONT_SIZE_TOPBAR, pauseColor);
 
 		/* draw mode indicator on the right */
 		const char *modeText = g->inputMode == INPUT_MODE_INSERT
 			? "mode: INSERT"
 			: "mode: NOTES";
-		int modeWidth = MeasureText(modeText, FONT_SIZE_TOPBAR);
+		int modeWidth = Layout_TextWidth(modeText, FONT_SIZE_TOPBAR);
 		int modeX = WINDOW_W - modeWidth - TOPBAR_PADDING;
 
-		Color modeColor = g->inputMode == INPUT_MODE_INSERT
-			? ColorFromUInt(COLOR_TOPBAR_TEXT)
-			: ColorFromUInt(COLOR_ACCENT);
+		Color modeColor = g->inputMode == INPUT_MODE_INSERT ? colors->topbarText
+								    : colors->accent;
 		DrawText(modeText, modeX, TOPBAR_PADDING, FONT_SIZE_TOPBAR, modeColor);
 	}
 }
 
-/* draw the sudoku board with grid, cells, digits, and notes */
-void UI_DrawBoard(const Game *g) {
-	Rectangle boardRect = BoardRect();
+/* the static board layers are rendered into two textures and only redrawn
+ * when the view's board or version moves on (or the layout generation or theme
+ * changes). the base layer (cell background, cell colors, grid) goes under the
+ * per-frame highlights and the content layer (digits, notes) over them,
+ * keeping the original draw order
+ */
+typedef struct BoardCache {
+	RenderTexture2D base;
+	RenderTexture2D content;
+	bool valid;
+	const Board *board; /* the game's or a replay's */
+	unsigned int version;
+	unsigned layoutGeneration; /* line widths, note padding and grid */
+	int tilePix, margin;
+	bool highlightConflicts;
+	Theme theme;
+} BoardCache;
+
+static BoardCache s_boardCache;
+
+/* texture-local board rect, inset so the outer grid lines are not clipped */
+static Rectangle CacheBoardRect(int margin) {
+	int size = TILE_PIX * BOARD_SIZE;
+	return (Rectangle) { margin, margin, size, size };
+}
+
+static bool BoardCache_IsStale(const BoardCache *cache, const BoardView *v) {
+	return !cache->valid || cache->board != v->board || cache->version != v->version
+		|| cache->layoutGeneration != g_layout.generation
+		|| cache->tilePix != TILE_PIX || cache->margin != GRID_LINE_THICK_B
+		|| cache->highlightConflicts != v->highlightConflicts
+		|| memcmp(&cache->theme, v->theme, sizeof(Theme)) != 0;
+}
+
+static void BoardCache_Render(
+	BoardCache *cache, const BoardView *v, const ThemeColors *colors) {
+	PROFILE_COUNT(PROF_BOARD_RENDERS);
+	int margin = GRID_LINE_THICK_B;
+	int size = TILE_PIX * BOARD_SIZE + 2 * margin;
+
+	if (!cache->valid || cache->base.texture.width != size) {
+		if (cache->valid) {
+			UnloadRenderTexture(cache->base);
+			UnloadRenderTexture(cache->content);
+		}
+		cache->base = LoadRenderTexture(size, size);
+		cache->content = LoadRenderTexture(size, size);
+	}
+
+	Rectangle boardRect = CacheBoardRect(margin);
+
+	BeginTextureMode(cache->base);
+	ClearBackground(BLANK);
+	DrawRectangleRec(boardRect, colors->cellBg);
+	DrawGridLines(boardRect, colors);
+	for (int row = 0; row < BOARD_SIZE; row++) {
+		for (int col = 0; col < BOARD_SIZE; col++) {
+			/* draw cell color if set */
+			int cellColor = Board_Color(v->board, row, col);
+			if (cellColor > 0 && cellColor < CELL_COLOR_COUNT) {
+				Rectangle cell = { boardRect.x + col * TILE_PIX,
+					boardRect.y + row * TILE_PIX,
+					TILE_PIX,
+					TILE_PIX };
+				DrawRectangleRec(cell, colors->cellColors[cellColor]);
+			}
+		}
+	}
+	EndTextureMode();
+
+	BeginTextureMode(cache->content);
+	ClearBackground(BLANK);
+	for (int row = 0; row < BOARD_SIZE; row++) {
+		for (int col = 0; col < BOARD_SIZE; col++) {
+			Rectangle cell = { boardRect.x + col * TILE_PIX,
+				boardRect.y + row * TILE_PIX,
+				TILE_PIX,
+				TILE_PIX };
+			DrawCellContent(cell, row, col, v, colors);
+		}
+	}
+	EndTextureMode();
+
+	cache->valid = true;
+	cache->board = v->board;
+	cache->version = v->version;
+	cache->layoutGeneration = g_layout.generation;
+	cache->tilePix = TILE_PIX;
+	cache->margin = margin;
+	cache->highlightConflicts = v->highlightConflicts;
+	cache->theme = *v->theme;
+}
 
-	ThemeColors colors = CacheThemeColors(&g->theme);
+/* render textures are stored bottom-up, flip them while drawing */
+static void DrawCacheLayer(RenderTexture2D layer, Rectangle boardRect, int margin) {
+	PROFILE_COUNT(PROF_DRAWS);
+	Rectangle src = { 0, 0, layer.texture.width, -layer.texture.height };
+	Vector2 pos = { boardRect.x - margin, boardRect.y - margin };
+	DrawTextureRec(layer.texture, src, pos, WHITE);
+}
+
+/* replay what the mods' on_draw_overlay hooks recorded, relative to the board */
+static void DrawModOverlay(const ModRuntime *mods, Rectangle boardRect) {
+	for (int i = 0; i < mods->overlayCount; i++) {
+		const ModDrawCmd *cmd = &mods->overlay[i];
+		Color color = ColorFromUInt(cmd->color);
+		int x = boardRect.x + cmd->x, y = boardRect.y + cmd->y;
+		switch (cmd->kind) {
+		case MOD_DRAW_RECT:
+			DrawRectangle(x, y, cmd->w, cmd->h, color);
+			break;
+		case MOD_DRAW_CELL:
+			if (cmd->x < 0 || cmd->x >= BOARD_SIZE || cmd->y < 0
+				|| cmd->y >= BOARD_SIZE)
+				continue;
+			DrawRectangle(boardRect.x + cmd->x * TILE_PIX,
+				boardRect.y + cmd->y * TILE_PIX,
+				TILE_PIX,
+				TILE_PIX,
+				color);
+			break;
+		case MOD_DRAW_TEXT:
+			DrawText(cmd->text, x, y, cmd->size, color);
+			break;
+		}
+		PROFILE_COUNT(PROF_DRAWS);
+	}
+}
+
+/* draw a board with grid, cells, digits, and notes */
+static void DrawBoardView(const BoardView *v) {
+	Rectangle boardRect = g_layout.board;
+	const ThemeColors *colors = &g_layout.colors;
 
 	/* draw pause overlay if paused */
-	if (g->paused) {
+	if (v->paused) {
 		Color overlayColor = Fade(BLACK, 0.5f);
 		DrawRectangleRec(boardRect, overlayColor);
 
 		const char *pauseMsg = "paused";
-		int textWidth = MeasureText(pauseMsg, FONT_SIZE_TITLE);
+		int textWidth = Layout_TextWidth(pauseMsg, FONT_SIZE_TITLE);
 		int textX = boardRect.x + boardRect.width / 2 - textWidth / 2;
 		int textY = boardRect.y + boardRect.height / 2 - FONT_SIZE_TITLE / 2;
 		DrawText(pauseMsg, textX, textY, FONT_SIZE_TITLE, WHITE);
 		return; /* don't draw the actual board when paused */
 	}
 
-	DrawRectangleRec(boardRect, colors.cellBg);
+	BoardCache *cache = &s_boardCache;
+	bool glyphsRebuilt = GlyphAtlas_Refresh(&s_glyphs);
+	if (glyphsRebuilt || BoardCache_IsStale(cache, v))
+		BoardCache_Render(cache, v, colors);
 
-	DrawGridLines(boardRect, &colors);
+	DrawCacheLayer(cache->base, boardRect, cache->margin);
 
 	/* get the value of the selected cell for digit highlighting */
-	const Cell *selectedCell = &g->board.cells[g->selRow][g->selCol];
-	int selectedDigit = selectedCell->value;
+	int selectedDigit = Board_Value(v->board, v->selRow, v->selCol);
 
-	/* draw cells, selection, and content */
+	/* dynamic layer: selection and highlights */
 	for (int row = 0; row < BOARD_SIZE; row++) {
 		for (int col = 0; col < BOARD_SIZE; col++) {
 			Rectangle cell = { boardRect.x + col * TILE_PIX,
@@ -273,77 +451,94 @@ void UI_DrawBoard(const Game *g) {
 				TILE_PIX,
 				TILE_PIX };
 
-			const Cell *cellData = &g->board.cells[row][col];
-
-			/* draw cell color if set */
-			if (cellData->color > 0 && cellData->color < CELL_COLOR_COUNT) {
-				DrawRectangleRec(cell, colors.cellColors[cellData->color]);
-			}
+			int cellValue = Board_Value(v->board, row, col);
 
 			/*  highlight row and column of selected cell */
-			if (g->selRow == row || g->selCol == col) {
-				DrawRectangleRec(cell, colors.highlightRowCol);
+			if (v->selRow == row || v->selCol == col) {
+				DrawRectangleRec(cell, colors->highlightRowCol);
+				PROFILE_COUNT(PROF_DRAWS);
 			}
 
 			/*  highlight cells with matching digit */
-			if (selectedDigit != 0 && cellData->value == selectedDigit) {
-				DrawRectangleRec(cell, colors.highlightDigit);
+			if (selectedDigit != 0 && cellValue == selectedDigit) {
+				DrawRectangleRec(cell, colors->highlightDigit);
+				PROFILE_COUNT(PROF_DRAWS);
 			}
 
 			/* highlight selected cell */
-			if (g->selRow == row && g->selCol == col) {
-				DrawRectangleRec(cell, colors.cellSel);
+			if (v->selRow == row && v->selCol == col) {
+				DrawRectangleRec(cell, colors->cellSel);
+				PROFILE_COUNT(PROF_DRAWS);
 			}
-
-			DrawCellContent(cell, cellData, row, col, g, &colors);
 		}
 	}
 
+	DrawCacheLayer(cache->content, boardRect, cache->margin);
+	if (v->mods) DrawModOverlay(v->mods, boardRect);
+}
+
+void UI_DrawBoard(const Game *g) {
+	PROFILE_BEGIN(PROF_BOARD);
+	BoardView view = { .board = &g->board,
+		.selRow = g->selRow,
+		.selCol = g->selCol,
+		.paused = g->paused,
+		.highlightConflicts = g->highlightConflicts,
+		.conflicts = &g->conflicts,
+		.noteConflicts = g->noteConflicts,
+		.version = g->boardVersion,
+		.theme = &g->theme,
+		.mods = &g->mods };
+	DrawBoardView(&view);
+	PROFILE_END(PROF_BOARD);
+	if (g->paused) return; /* the sidebar goes with the board */
+
 	/* draw sidebar (shares color cache) */
-	UI_DrawSidebar(g, &colors);
+	PROFILE_BEGIN(PROF_SIDEBAR);
+	UI_DrawSidebar(g, &g_layout.colors);
+	PROFILE_END(PROF_SIDEBAR);
+}
+
+void UI_Shutdown(void) {
+	if (s_glyphs.valid) {
+		UnloadTexture(s_glyphs.texture);
+		s_glyphs.valid = false;
+	}
+	if (s_boardCache.valid) {
+		UnloadRenderTexture(s_boardCache.base);
+		UnloadRenderTexture(s_boardCache.content);
+		s_boardCache.valid = false;
+	}
 }
 
 /* draw the sidebar with controls and status */
 void UI_DrawSidebar(const Game *g, const ThemeColors *colors) {
-	int x = BOARD_PAD + TILE_PIX * BOARD_SIZE + SIDEBAR_MARGIN;
-	int y = TOPBAR_H + BOARD_PAD;
+	const Layout *l = &g_layout;
+	int x = l->sidebarX;
 
-	DrawText("controls:", x, y, FONT_SIZE_LARGE, colors->text);
-	y += CONTROLS_SECTION_SPACING;
+	DrawText("controls:", x, l->controlsHeadingY, FONT_SIZE_LARGE, colors->text);
 
 	/*  draw control instructions */
-	DrawText("arrows: move", x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_LINE_SPACING;
-
-	const char *digitAction = g->inputMode == INPUT_MODE_INSERT
-		? "1-9: set digit"
-		: "1-9: toggle note";
-	DrawText(digitAction, x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_LINE_SPACING;
-
-	DrawText("0 / backspace: clear", x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_LINE_SPACING;
-
-	DrawText("n: toggle mode", x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_LINE_SPACING;
-
-	DrawText("h: highlight conflicts", x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_LINE_SPACING;
-
-	DrawText("esc: menu", x, y, FONT_SIZE_NORMAL, colors->text);
-	y += CONTROLS_SECTION_SPACING + 8;
+	const char *controls[LAYOUT_CONTROL_LINES] = {
+		"arrows: move",
+		g->inputMode == INPUT_MODE_INSERT ? "1-9: set digit" : "1-9: toggle note",
+		"0 / backspace: clear",
+		"n: toggle mode",
+		"h: highlight conflicts",
+		"ctrl+z / ctrl+y: undo/redo",
+		g->autoNotes ? "a: auto notes (on)" : "a: auto notes (off)",
+		"esc: menu",
+	};
+	for (int i = 0; i < LAYOUT_CONTROL_LINES; i++) {
+		int y = l->controlLineY[i];
+		DrawText(controls[i], x, y, FONT_SIZE_NORMAL, colors->text);
+	}
 
 	/* draw color keypad */
-	DrawText("color palette:", x, y, FONT_SIZE_LARGE, colors->text);
-	y += CONTROLS_SECTION_SPACING;
+	DrawText("color palette:", x, l->paletteHeadingY, FONT_SIZE_LARGE, colors->text);
 
 	for (int i = 1; i < CELL_COLOR_COUNT; i++) {
-		int row = (i - 1) / COLOR_KEYPAD_COLS;
-		int col = (i - 1) % COLOR_KEYPAD_COLS;
-		int px = x + col * (COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING);
-		int py = y + row * (COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING);
-
-		Rectangle colorRect = { px, py, COLOR_KEYPAD_SIZE, COLOR_KEYPAD_SIZE };
+		Rectangle colorRect = l->colorKeys[i];
 		DrawRectangleRec(colorRect, colors->cellColors[i]);
 		DrawRectangleLinesEx(colorRect, 2, colors->grid);
 
@@ -353,41 +548,132 @@ void UI_DrawSidebar(const Game *g, const ThemeColors *colors) {
 		}
 	}
 
-	y += ((CELL_COLOR_COUNT - 2) / COLOR_KEYPAD_COLS + 1)
-		* (COLOR_KEYPAD_SIZE + COLOR_KEYPAD_SPACING);
-	y += CONTROLS_SECTION_SPACING;
-
 	/* reserve space for second keypad */
-	DrawText("numbers: (wip)", x, y, FONT_SIZE_NORMAL, ColorAlpha(colors->text, 0.5f));
+	DrawText("numbers: (wip)",
+		x,
+		l->numbersY,
+		FONT_SIZE_NORMAL,
+		ColorAlpha(colors->text, 0.5f));
 
 	if (Board_IsComplete(&g->board)) {
-		y += CONTROLS_SECTION_SPACING;
-		DrawText("solved!", x, y, FONT_SIZE_HEADING, colors->accent);
+		DrawText("solved!", x, l->solvedY, FONT_SIZE_HEADING, colors->accent);
 	}
 }
 
+#ifdef PROFILER_ENABLED
+/* f3 overlay: per-phase timings, counters and a stacked frame-time history */
+#define PROFILER_PANEL_W 300
+#define PROFILER_GRAPH_H 60
+#define PROFILER_GRAPH_MS 33.3f /* graph height in ms, two 60 fps frames */
+
+void UI_DrawProfiler(void) {
+	static const char *phaseNames[PROF_PHASE_COUNT]
+		= { "input", "timer", "board", "sidebar", "present", "mods" };
+	static const char *counterNames[PROF_COUNTER_COUNT] = { "board draws",
+		"board renders",
+		"valid move checks",
+		"mod hook calls",
+		"mod hooks skipped" };
+	const Color phaseColors[PROF_PHASE_COUNT]
+		= { SKYBLUE, ORANGE, LIME, VIOLET, GRAY, GOLD };
+
+	const ProfileFrame *last = Profiler_Frame(0);
+	if (!last) return;
+
+	/* averages over the whole history */
+	ProfileFrame avg = { 0 };
+	for (int i = 0; i < g_profiler.count; i++) {
+		const ProfileFrame *f = Profiler_Frame(i);
+		avg.frameMs += f->frameMs / g_profiler.count;
+		for (int p = 0; p < PROF_PHASE_COUNT; p++)
+			avg.phaseMs[p] += f->phaseMs[p] / g_profiler.count;
+	}
+
+	int lineH = FONT_SIZE_SMALL + 2;
+	int panelH = (PROF_PHASE_COUNT + PROF_COUNTER_COUNT + 2) * lineH
+		+ PROFILER_GRAPH_H + 16;
+	int x = WINDOW_W - PROFILER_PANEL_W - 8, y = TOPBAR_H + 8;
+	DrawRectangle(x, y, PROFILER_PANEL_W, panelH, Fade(BLACK, 0.75f));
+	x += 8;
+	y += 4;
+
+	char line[64];
+	float fps = avg.frameMs > 0.0f ? 1000.0f / avg.frameMs : 0.0f;
+	snprintf(line,
+		sizeof(line),
+		"frame %.2f ms  avg %.2f  (%.0f fps)",
+		last->frameMs,
+		avg.frameMs,
+		fps);
+	DrawText(line, x, y, FONT_SIZE_SMALL, WHITE);
+	y += lineH;
+
+	for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+		DrawRectangle(x, y + 3, 10, 10, phaseColors[p]);
+		snprintf(line,
+			sizeof(line),
+			"%-8s %6.3f ms  avg %6.3f",
+			phaseNames[p],
+			last->phaseMs[p],
+			avg.phaseMs[p]);
+		DrawText(line, x + 16, y, FONT_SIZE_SMALL, WHITE);
+		y += lineH;
+	}
+
+	for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+		unsigned int value = last->counters[c];
+		snprintf(line, sizeof(line), "%s: %u", counterNames[c], value);
+		DrawText(line, x, y, FONT_SIZE_SMALL, LIGHTGRAY);
+		y += lineH;
+	}
+
+	/* history, newest on the right, each bar stacked by phase */
+	y += 4;
+	int graphBottom = y + PROFILER_GRAPH_H;
+	int barW = (PROFILER_PANEL_W - 16) / PROFILER_HISTORY;
+	if (barW < 1) barW = 1;
+	float pxPerMs = PROFILER_GRAPH_H / PROFILER_GRAPH_MS;
+	for (int i = 0; i < g_profiler.count; i++) {
+		const ProfileFrame *f = Profiler_Frame(i);
+		int bx = x + (PROFILER_HISTORY - 1 - i) * barW;
+		int top = graphBottom;
+		for (int p = 0; p < PROF_PHASE_COUNT && top > y; p++) {
+			int h = (int) (f->phaseMs[p] * pxPerMs + 0.5f);
+			if (top - h < y) h = top - y;
+			top -= h;
+			DrawRectangle(bx, top, barW, h, phaseColors[p]);
+		}
+	}
+
+	/* 60 fps budget line */
+	int budgetY = graphBottom - (int) (16.7f * pxPerMs);
+	DrawLine(x, budgetY, x + PROFILER_HISTORY * barW, budgetY, RED);
+}
+#endif
+
 void UI_DrawCenteredText(const char *text, int y) {
-	int textWidth = MeasureText(text, FONT_SIZE_TITLE);
-	DrawText(text, (WINDOW_W - textWidth) / 2, y, FONT_SIZE_TITLE, ColorFromUInt(COLOR_TEXT));
+	int textWidth = Layout_TextWidth(text, FONT_SIZE_TITLE);
+	int x = (WINDOW_W - textWidth) / 2;
+	DrawText(text, x, y, FONT_SIZE_TITLE, g_layout.colors.text);
 }
 
 int UI_Menu(const char *const *items, int count, int *selected) {
 	int sel = *selected;
+	const ThemeColors *colors = &g_layout.colors;
 
 	for (int i = 0; i < count; i++) {
-		int textWidth = MeasureText(items[i], FONT_SIZE_MENU);
+		int textWidth = Layout_TextWidth(items[i], FONT_SIZE_MENU);
 		int y = MENU_START_Y + i * MENU_ITEM_SPACING;
 		int x = (WINDOW_W - textWidth) / 2;
 
-		Color textColor = (i == sel) ? ColorFromUInt(COLOR_MENU_SEL)
-					     : ColorFromUInt(COLOR_MENU_TEXT);
+		Color textColor = (i == sel) ? colors->menuSel : colors->menuText;
 
 		if (i == sel) {
 			DrawRectangle(x - MENU_PADDING_X,
 				y - MENU_PADDING_Y,
 				textWidth + 2 * MENU_PADDING_X,
 				FONT_SIZE_MENU + 2 * MENU_PADDING_Y,
-				ColorFromUInt(COLOR_MENU_SEL_BG));
+				colors->menuSelBg);
 		}
 
 		DrawText(items[i], x, y, FONT_SIZE_MENU, textColor);
@@ -404,7 +690,7 @@ int UI_Menu(const char *const *items, int count, int *selected) {
 }
 
 void UI_DrawDifficultyMenu(Game *g) {
-	UI_DrawCenteredText("Select Difficulty", 120);
+	UI_DrawCenteredText("Select Difficulty", LAYOUT_TITLE_Y);
 
 	const char *difficulties[] = { "easy", "medium", "hard", "master", "expert" };
 
@@ -413,6 +699,8 @@ void UI_DrawDifficultyMenu(Game *g) {
 	if (hit >= 0) {
 		g->selectedDifficulty = (Difficulty) hit;
 		Board_GenerateRandom(&g->board, g->selectedDifficulty);
+		Mod_OnGenerate(&g->mods, &g->board, difficulties[hit]);
+		Game_OnNewPuzzle(g);
 
 		snprintf(g->puzzleTitle,
 			MAX_PUZZLE_TITLE_GAME,
@@ -433,52 +721,470 @@ void UI_DrawDifficultyMenu(Game *g) {
 	}
 }
 
+static bool KeyPressedOrRepeat(int key) {
+	return IsKeyPressed(key) || IsKeyPressedRepeat(key);
+}
+
+/* type-to-filter: printable characters extend the text, backspace trims it.
+ * digitsOnly limits it to 0-9
+ */
+static bool UpdateTypedText(char *text, size_t size, bool digitsOnly) {
+	size_t len = strlen(text);
+	bool changed = false;
+
+	int ch;
+	while ((ch = GetCharPressed()) > 0) {
+		if (ch < 32 || ch > 126 || len + 1 >= size) continue;
+		if (digitsOnly && (ch < '0' || ch > '9')) continue;
+		text[len++] = (char) ch;
+		changed = true;
+	}
+	if (len > 0 && KeyPressedOrRepeat(KEY_BACKSPACE)) {
+		len--;
+		changed = true;
+	}
+	text[len] = '\0';
+	return changed;
+}
+
+/* three-quarter ring turning once a second, shown while a scan runs */
+static void DrawSpinner(int cx, int cy, Color color) {
+	float start = (float) fmod(GetTime() * 360.0, 360.0);
+	Vector2 center = { (float) cx, (float) cy };
+	DrawRing(center, 5.0f, 8.0f, start, start + 270.0f, 24, color);
+}
+
+/* keys, wheel and clicks over a virtual list of rows, shared by the file and
+ * collection views. keeps *sel in range and in view, returns the row picked
+ * with enter or a click, -1 if none
+ */
+static int BrowserNavigate(int rows, int *selection, int *scrollRow) {
+	const Layout *l = &g_layout;
+	int page = l->browserRows;
+	int sel = *selection;
+	if (KeyPressedOrRepeat(KEY_UP)) sel--;
+	if (KeyPressedOrRepeat(KEY_DOWN)) sel++;
+	if (KeyPressedOrRepeat(KEY_PAGE_UP)) sel -= page;
+	if (KeyPressedOrRepeat(KEY_PAGE_DOWN)) sel += page;
+	if (IsKeyPressed(KEY_HOME)) sel = 0;
+	if (IsKeyPressed(KEY_END)) sel = rows - 1;
+
+	int scroll = *scrollRow - (int) GetMouseWheelMove() * 3;
+	int hit = -1;
+	if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+		Vector2 mouse = GetMousePosition();
+		int row = Layout_BrowserRowAt(l, (int) mouse.x, (int) mouse.y);
+		if (row >= 0 && scroll + row < rows) hit = sel = scroll + row;
+	}
+
+	/* clamp, then keep the selection in view */
+	if (sel > rows - 1) sel = rows - 1;
+	if (sel < 0) sel = 0;
+	if (sel < scroll) scroll = sel;
+	if (sel >= scroll + page) scroll = sel - page + 1;
+	if (scroll > rows - page) scroll = rows - page;
+	if (scroll < 0) scroll = 0;
+	*selection = sel;
+	*scrollRow = scroll;
+
+	if (IsKeyPressed(KEY_ENTER)) hit = sel;
+	return hit >= 0 && hit < rows ? hit : -1;
+}
+
+/* one visible row, i counted from the top of the view */
+static void DrawBrowserRow(int i, const char *text, bool selected) {
+	const Layout *l = &g_layout;
+	const ThemeColors *colors = &l->colors;
+	Rectangle view = l->browserList;
+	int y = view.y + i * l->browserRowH;
+
+	Color textColor = colors->menuText;
+	if (selected) {
+		Rectangle rowRect = { view.x, y, view.width, l->browserRowH };
+		DrawRectangleRec(rowRect, colors->menuSelBg);
+		textColor = colors->menuSel;
+	}
+	DrawText(text,
+		view.x + MENU_PADDING_X,
+		y + MENU_PADDING_Y,
+		FONT_SIZE_NORMAL,
+		textColor);
+}
+
+/* scrollbar sized to the visible share of the list */
+static void DrawBrowserScrollbar(int rows, int scroll) {
+	const Layout *l = &g_layout;
+	int page = l->browserRows;
+	if (rows <= page) return;
+
+	Rectangle view = l->browserList;
+	int barH = (int) (view.height * page / rows);
+	if (barH < 8) barH = 8;
+	int barY = view.y + (int) ((view.height - barH) * scroll / (rows - page));
+	DrawRectangle(view.x + view.width - 4, barY, 4, barH, l->colors.accent);
+}
+
+/* verdict of the collection check for one puzzle, false while it is unchecked.
+ * *bad is set if the puzzle cannot be played as intended
+ */
+static bool CheckBadge(uint8_t check, char *text, size_t size, bool *bad) {
+	static const char *const ratings[] = { "", "easy", "medium", "hard" };
+	if (!(check & CHECK_DONE)) return false;
+
+	const char *verdict = ratings[CHECK_RATING(check)];
+	if (check & CHECK_CONFLICT)
+		verdict = "conflict";
+	else if (check & CHECK_UNSOLVABLE)
+		verdict = "no solution";
+	else if (check & CHECK_MULTIPLE)
+		verdict = "2+ solutions";
+	*bad = (check & (CHECK_CONFLICT | CHECK_UNSOLVABLE | CHECK_MULTIPLE)) != 0;
+
+	snprintf(text,
+		size,
+		"%s%s",
+		verdict,
+		check & CHECK_DUPLICATE ? ", duplicate" : "");
+	return true;
+}
+
+/* the puzzles of an open collection, rows come straight from the mapped file
+ * so even millions of lines cost nothing until they scroll into view
+ */
+static void DrawCollectionMenu(Game *g) {
+	const Layout *l = &g_layout;
+	const PuzzleCollection *c = &g->collection;
+
+	/* typing a number jumps to that puzzle */
+	if (UpdateTypedText(g->collectionJump, sizeof(g->collectionJump), true)
+		&& g->collectionJump[0])
+		g->collectionSelection = atoi(g->collectionJump) - 1;
+
+	int hit = BrowserNavigate(
+		c->count, &g->collectionSelection, &g->collectionScroll);
+	int sel = g->collectionSelection, scroll = g->collectionScroll;
+
+	/* check progress and throughput, the badges fill in as it goes */
+	PuzzleCheck *check = &g->collectionCheck;
+	char progress[64] = "";
+	if (PuzzleCheck_Poll(check))
+		snprintf(progress,
+			sizeof(progress),
+			"   checking %d%%, %.0f/s",
+			(int) (100.0 * PuzzleCheck_Progress(check) / c->count),
+			PuzzleCheck_Rate(check));
+	else if (PuzzleCheck_Rate(check) > 0)
+		snprintf(progress,
+			sizeof(progress),
+			"   checked at %.0f/s",
+			PuzzleCheck_Rate(check));
+
+	char status[MAX_PUZZLE_TITLE + 112];
+	snprintf(status,
+		sizeof(status),
+		"%s   go to: %s_   (%d puzzles)%s",
+		c->name,
+		g->collectionJump,
+		c->count,
+		progress);
+	int statusY = l->browserFilterY;
+	DrawText(status, l->browserList.x, statusY, FONT_SIZE_NORMAL, l->colors.text);
+
+	int cells = BOARD_SIZE * BOARD_SIZE;
+	for (int i = 0; i < l->browserRows && scroll + i < c->count; i++) {
+		const char *line = PuzzleCollection_Line(c, scroll + i);
+		int clues = 0;
+		for (int k = 0; k < cells; k++)
+			clues += line[k] >= '1' && line[k] <= '9';
+
+		char text[48];
+		snprintf(text, sizeof(text), "#%d   %d clues", scroll + i + 1, clues);
+		DrawBrowserRow(i, text, scroll + i == sel);
+
+		char badge[32];
+		bool bad = false;
+		uint8_t *result = &c->checks[scroll + i];
+		uint8_t checked = __atomic_load_n(result, __ATOMIC_RELAXED);
+		if (!CheckBadge(checked, badge, sizeof(badge), &bad)) continue;
+		int badgeX = l->browserList.x + l->browserList.width - MENU_PADDING_X
+			- MeasureText(badge, FONT_SIZE_NORMAL);
+		DrawText(badge,
+			badgeX,
+			l->browserList.y + i * l->browserRowH + MENU_PADDING_Y,
+			FONT_SIZE_NORMAL,
+			bad ? l->colors.bad : l->colors.accent);
+	}
+	DrawBrowserScrollbar(c->count, scroll);
+
+	Puzzle puzzle;
+	if (hit >= 0 && PuzzleCollection_Get(c, hit, &puzzle))
+		Game_LoadPuzzle(g, &puzzle);
+}
+
 void UI_DrawLoadPuzzleMenu(Game *g) {
+	const Layout *l = &g_layout;
+	const ThemeColors *colors = &l->colors;
+	PuzzleFileList *list = &g->puzzleList;
+
+	/* the watch is started first so nothing written during the scan is missed,
+	 * its events wait in the kernel until the scan is done
+	 */
 	if (!g->puzzleListInitialized) {
-		PuzzleFileList_ScanDirectory(&g->puzzleList, "puzzles");
+		PuzzleWatch_Stop(&g->puzzleWatch);
+		PuzzleWatch_Start(&g->puzzleWatch, "puzzles");
+		PuzzleScan_Start(&g->puzzleScan, list, "puzzles");
+		PuzzleFileList_Filter(list, g->puzzleFilter);
+		g->loadPuzzleSelection = 0;
+		g->loadPuzzleScroll = 0;
 		g->puzzleListInitialized = true;
 	}
 
-	UI_DrawCenteredText("load puzzle", 120);
+	/* entries the scan found since last frame; rows keep their position, the
+	 * selection may move onto a title sorted in above it
+	 */
+	int changed = PuzzleScan_Poll(&g->puzzleScan, list);
+	bool scanning = PuzzleScan_Running(&g->puzzleScan);
+	if (!scanning) {
+		int updates = PuzzleWatch_Poll(&g->puzzleWatch, list);
+		if (updates < 0) g->puzzleListInitialized = false;
+		changed += updates > 0 ? updates : 0;
+	}
+	if (changed > 0) PuzzleFileList_Filter(list, g->puzzleFilter);
+
+	UI_DrawCenteredText("load puzzle", LAYOUT_TITLE_Y);
 
-	if (g->puzzleList.count == 0) {
+	if (g->collection.count > 0) {
+		DrawCollectionMenu(g);
+		return;
+	}
+
+	if (list->count == 0 && scanning) {
+		int spinnerY = 250 + FONT_SIZE_TOPBAR / 2;
+		DrawSpinner(WINDOW_W / 2 - 100, spinnerY, colors->accent);
+		DrawText("scanning puzzles...",
+			WINDOW_W / 2 - 80,
+			250,
+			FONT_SIZE_TOPBAR,
+			colors->text);
+		return;
+	}
+	if (list->count == 0) {
 		DrawText("no puzzle files found in the directory",
 			WINDOW_W / 2 - 200,
 			250,
 			FONT_SIZE_TOPBAR,
-			ColorFromUInt(COLOR_TEXT));
+			colors->text);
 		DrawText("create some! example puzzle is distributed with the source",
 			WINDOW_W / 2 - 180,
 			280,
 			FONT_SIZE_SMALL,
-			ColorFromUInt(COLOR_TEXT));
-
-		/* override: esc goes to menu*/
-		if (IsKeyPressed(KEY_ESCAPE)) {
-			g->puzzleListInitialized = false;
-			g->screen = SCREEN_MENU;
-		}
+			colors->text);
 		return;
 	}
 
-	/* menu items from puzzle title field */
-	const char *items[MAX_PUZZLE_FILES];
-	for (int i = 0; i < g->puzzleList.count; i++) {
-		items[i] = g->puzzleList.titles[i];
+	if (UpdateTypedText(g->puzzleFilter, sizeof(g->puzzleFilter), false)) {
+		PuzzleFileList_Filter(list, g->puzzleFilter);
+		g->loadPuzzleSelection = 0;
+		g->loadPuzzleScroll = 0;
 	}
 
-	int hit = UI_Menu(items, g->puzzleList.count, &g->loadPuzzleSelection);
+	int rows = list->filterCount;
+	int hit = BrowserNavigate(rows, &g->loadPuzzleSelection, &g->loadPuzzleScroll);
+	int sel = g->loadPuzzleSelection, scroll = g->loadPuzzleScroll;
+
+	char status[MAX_PUZZLE_TITLE + 48];
+	snprintf(status,
+		sizeof(status),
+		"filter: %s_   (%d of %d)",
+		g->puzzleFilter,
+		rows,
+		list->count);
+	int statusY = l->browserFilterY;
+	DrawText(status, l->browserList.x, statusY, FONT_SIZE_NORMAL, colors->text);
+	if (scanning) {
+		int spinnerX = l->browserList.x + l->browserList.width - 8;
+		DrawSpinner(spinnerX, statusY + FONT_SIZE_NORMAL / 2, colors->accent);
+	}
 
+	for (int i = 0; i < l->browserRows && scroll + i < rows; i++) {
+		int entry = PuzzleFileList_FilteredEntry(list, scroll + i);
+		DrawBrowserRow(i, PuzzleFileList_Title(list, entry), scroll + i == sel);
+	}
+	DrawBrowserScrollbar(rows, scroll);
+
+	/* a file of many one-line puzzles opens as a collection instead */
 	if (hit >= 0) {
-		if (Game_LoadPuzzleFile(g, g->puzzleList.filepaths[hit])) {
-			g->puzzleListInitialized = false;
-		}
+		int entry = PuzzleFileList_FilteredEntry(list, hit);
+		const char *path = PuzzleFileList_Path(list, entry);
+		if (Game_OpenCollection(g, path)) return;
+		/* without a watch the list is only as fresh as the last scan */
+		bool loaded = Game_LoadPuzzleFile(g, path);
+		if (loaded && !g->puzzleWatch.active) g->puzzleListInitialized = false;
+	}
+}
+
+/* mm:ss of a replay time */
+static void FormatReplayTime(char *text, size_t size, double ms) {
+	int seconds = (int) (ms / 1000.0);
+	snprintf(text, size, "%02d:%02d", seconds / 60, seconds % 60);
+}
+
+/* an open replay: the board as the player saw it at the current position,
+ * the transport in the sidebar
+ */
+static void DrawReplayViewer(Game *g) {
+	const Layout *l = &g_layout;
+	const ThemeColors *colors = &l->colors;
+	ReplayPlayer *p = &g->replayPlayer;
+	double duration = g->replayDuration;
+
+	if (IsKeyPressed(KEY_SPACE)) {
+		/* from the start again once it has played out */
+		if (!g->replayPlaying && ReplayPlayer_Done(p)) ReplayPlayer_Seek(p, 0);
+		g->replayPlaying = !g->replayPlaying;
+	}
+	if (IsKeyPressed(KEY_UP)) ReplayPlayer_SetSpeed(p, p->speed * 2.0);
+	if (IsKeyPressed(KEY_DOWN)) ReplayPlayer_SetSpeed(p, p->speed / 2.0);
+
+	bool seek = false;
+	double target = p->position;
+	if (KeyPressedOrRepeat(KEY_LEFT)) {
+		target -= REPLAY_SEEK_STEP_MS;
+		seek = true;
+	}
+	if (KeyPressedOrRepeat(KEY_RIGHT)) {
+		target += REPLAY_SEEK_STEP_MS;
+		seek = true;
+	}
+	if (IsKeyPressed(KEY_HOME)) {
+		target = 0.0;
+		seek = true;
+	}
+	if (IsKeyPressed(KEY_END)) {
+		target = duration;
+		seek = true;
+	}
+	Rectangle bar = l->replayBar;
+	Vector2 mouse = GetMousePosition();
+	if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(mouse, bar)) {
+		target = (mouse.x - bar.x) / bar.width * duration;
+		seek = true;
+	}
+	if (seek) {
+		if (target < 0.0) target = 0.0;
+		if (target > duration) target = duration;
+		if (!ReplayPlayer_Seek(p, (uint32_t) target)) g->replayPlaying = false;
 	}
 
-	if (IsKeyPressed(KEY_ESCAPE)) {
-		g->puzzleListInitialized = false;
-		g->screen = SCREEN_MENU;
+	if (g->replayPlaying) {
+		/* a stalled frame should not skip half the game */
+		double dt = GetFrameTime();
+		ReplayPlayer_Advance(p, dt < 0.25 ? dt : 0.25);
+		if (ReplayPlayer_Done(p)) g->replayPlaying = false;
 	}
+	Game_SyncReplay(g);
+
+	const ReplayState *state = &p->state;
+	BoardView view = { .board = &state->board,
+		.selRow = state->selRow,
+		.selCol = state->selCol,
+		.paused = state->paused,
+		.highlightConflicts = true,
+		.conflicts = &g->replayConflicts,
+		.noteConflicts = g->replayNoteConflicts,
+		.version = g->replayVersion,
+		.theme = &g->theme };
+	DrawBoardView(&view);
+
+	int x = l->sidebarX;
+	DrawText("replay:", x, l->controlsHeadingY, FONT_SIZE_LARGE, colors->text);
+	const char *controls[] = {
+		g->replayPlaying ? "space: pause" : "space: play",
+		"up / down: speed",
+		"left / right: 5 s back/on",
+		"home / end: start/end",
+		"click the bar: seek",
+		"esc: replays",
+	};
+	for (int i = 0; i < (int) (sizeof(controls) / sizeof(controls[0])); i++) {
+		int y = l->controlLineY[i];
+		DrawText(controls[i], x, y, FONT_SIZE_NORMAL, colors->text);
+	}
+
+	double position = p->position < duration ? p->position : duration;
+	char now[16], total[16], status[64];
+	FormatReplayTime(now, sizeof(now), position);
+	FormatReplayTime(total, sizeof(total), duration);
+	snprintf(status, sizeof(status), "%s / %s   %gx", now, total, p->speed);
+	DrawText(status, x, l->paletteHeadingY, FONT_SIZE_LARGE, colors->text);
+
+	DrawRectangleRec(bar, colors->menuSelBg);
+	float done = duration > 0.0 ? (float) (position / duration) : 1.0f;
+	Rectangle played = { bar.x, bar.y, bar.width * done, bar.height };
+	DrawRectangleRec(played, colors->accent);
+	DrawRectangleLinesEx(bar, 1, colors->grid);
+
+	DrawText(g->replayShown.title, x, l->numbersY, FONT_SIZE_NORMAL, colors->text);
+	if (Board_IsComplete(&state->board)) {
+		DrawText("solved!", x, l->solvedY, FONT_SIZE_HEADING, colors->accent);
+	}
+}
+
+void UI_DrawReplayMenu(Game *g) {
+	const Layout *l = &g_layout;
+	const ThemeColors *colors = &l->colors;
+
+	if (g->replayOpen) {
+		DrawReplayViewer(g);
+		return;
+	}
+
+	/* listed again each time the screen is entered, replays only come from
+	 * finished games
+	 */
+	if (!g->replayListInitialized) {
+		g->replayCount
+			= Replay_List(REPLAY_DIRECTORY, g->replayNames, REPLAY_LIST_MAX);
+		g->replaySelection = 0;
+		g->replayScroll = 0;
+		g->replayFailed = 0;
+		g->replayListInitialized = true;
+	}
+
+	UI_DrawCenteredText("replays", LAYOUT_TITLE_Y);
+
+	if (g->replayCount == 0) {
+		DrawText("no replays yet, every finished game is kept",
+			WINDOW_W / 2 - 200,
+			250,
+			FONT_SIZE_TOPBAR,
+			colors->text);
+		return;
+	}
+
+	int rows = g->replayCount;
+	int hit = BrowserNavigate(rows, &g->replaySelection, &g->replayScroll);
+	int sel = g->replaySelection, scroll = g->replayScroll;
+
+	for (int i = 0; i < l->browserRows && scroll + i < rows; i++) {
+		const char *name = g->replayNames[scroll + i];
+		char text[REPLAY_NAME_MAX];
+		snprintf(text, sizeof(text), "%.*s", (int) strlen(name) - 4, name);
+		DrawBrowserRow(i, text, scroll + i == sel);
+
+		if (g->replayFailed != scroll + i + 1) continue;
+		const char *badge = "cannot open";
+		int badgeX = l->browserList.x + l->browserList.width - MENU_PADDING_X
+			- MeasureText(badge, FONT_SIZE_NORMAL);
+		DrawText(badge,
+			badgeX,
+			l->browserList.y + i * l->browserRowH + MENU_PADDING_Y,
+			FONT_SIZE_NORMAL,
+			colors->bad);
+	}
+	DrawBrowserScrollbar(rows, scroll);
+
+	if (hit >= 0) g->replayFailed = Game_OpenReplay(g, hit) ? 0 : hit + 1;
 }
 
 typedef struct SettingsItem {
@@ -490,7 +1196,7 @@ typedef struct SettingsItem {
 } SettingsItem;
 
 void UI_DrawSettingsMenu(Game *g) {
-	ThemeColors colors = CacheThemeColors(&g->theme);
+	const ThemeColors *colors = &g_layout.colors;
 
 	UI_DrawCenteredText("settings", 80);
 
@@ -540,9 +1246,9 @@ void UI_DrawSettingsMenu(Game *g) {
 		int y = startY + i * lineHeight;
 		bool isSelected = (g->settingsSelection == i);
 
-		Color labelColor = isSelected ? colors.accent : colors.text;
+		Color labelColor = isSelected ? colors->accent : colors->text;
 		/* keep value visible with high contrast - use digitUser for unselected, text for selected */
-		Color valueColor = isSelected ? colors.text : colors.digitUser;
+		Color valueColor = isSelected ? colors->text : colors->digitUser;
 
 		/* draw label on the left */
 		char label[128];
@@ -551,13 +1257,14 @@ void UI_DrawSettingsMenu(Game *g) {
 
 		/* draw arrows on either side of the value if selected */
 		if (isSelected) {
-			DrawText("<", WINDOW_W / 2 + 30, y, FONT_SIZE_NORMAL, colors.accent);
-			DrawText(">", WINDOW_W / 2 + 150, y, FONT_SIZE_NORMAL, colors.accent);
+			int arrowX = WINDOW_W / 2;
+			DrawText("<", arrowX + 30, y, FONT_SIZE_NORMAL, colors->accent);
+			DrawText(">", arrowX + 150, y, FONT_SIZE_NORMAL, colors->accent);
 		}
 
 		char value[32];
 		snprintf(value, sizeof(value), "%d", *items[i].value);
-		int valueWidth = MeasureText(value, FONT_SIZE_NORMAL);
+		int valueWidth = Layout_TextWidth(value, FONT_SIZE_NORMAL);
 		int valueX = WINDOW_W / 2 + 90 - valueWidth / 2; /* center between arrows */
 		DrawText(value, valueX, y, FONT_SIZE_NORMAL, valueColor);
 	}
@@ -567,37 +1274,34 @@ void UI_DrawSettingsMenu(Game *g) {
 
 	/* save button */
 	bool saveSelected = (g->settingsSelection == itemCount);
-	int saveTextWidth = MeasureText("save & apply", FONT_SIZE_MENU);
+	int saveTextWidth = Layout_TextWidth("save & apply", FONT_SIZE_MENU);
 	int saveX = WINDOW_W / 2 - saveTextWidth / 2;
 
-	Color saveTextColor = saveSelected ? ColorFromUInt(COLOR_MENU_SEL)
-					   : ColorFromUInt(COLOR_MENU_TEXT);
+	Color saveTextColor = saveSelected ? colors->menuSel : colors->menuText;
 
 	if (saveSelected) {
 		DrawRectangle(saveX - MENU_PADDING_X,
 			buttonY - MENU_PADDING_Y,
 			saveTextWidth + 2 * MENU_PADDING_X,
 			FONT_SIZE_MENU + 2 * MENU_PADDING_Y,
-			ColorFromUInt(COLOR_MENU_SEL_BG));
+			colors->menuSelBg);
 	}
 
 	DrawText("save & apply", saveX, buttonY, FONT_SIZE_MENU, saveTextColor);
 
 	buttonY += 48;
 	bool cancelSelected = (g->settingsSelection == itemCount + 1);
-	/* TODO: do this more efficiently */
-	int cancelTextWidth = MeasureText("cancel", FONT_SIZE_MENU);
+	int cancelTextWidth = Layout_TextWidth("cancel", FONT_SIZE_MENU);
 	int cancelX = WINDOW_W / 2 - cancelTextWidth / 2;
 
-	Color cancelTextColor = cancelSelected ? ColorFromUInt(COLOR_MENU_SEL)
-					       : ColorFromUInt(COLOR_MENU_TEXT);
+	Color cancelTextColor = cancelSelected ? colors->menuSel : colors->menuText;
 
 	if (cancelSelected) {
 		DrawRectangle(cancelX - MENU_PADDING_X,
 			buttonY - MENU_PADDING_Y,
 			cancelTextWidth + 2 * MENU_PADDING_X,
 			FONT_SIZE_MENU + 2 * MENU_PADDING_Y,
-			ColorFromUInt(COLOR_MENU_SEL_BG));
+			colors->menuSelBg);
 	}
 
 	DrawText("cancel", cancelX, buttonY, FONT_SIZE_MENU, cancelTextColor);
@@ -607,12 +1311,12 @@ void UI_DrawSettingsMenu(Game *g) {
 		WINDOW_W / 2 - 150,
 		WINDOW_H - 80,
 		FONT_SIZE_SMALL,
-		ColorAlpha(colors.text, 0.7f));
+		ColorAlpha(colors->text, 0.7f));
 	DrawText("press enter to select",
 		WINDOW_W / 2 - 100,
 		WINDOW_H - 60,
 		FONT_SIZE_SMALL,
-		ColorAlpha(colors.text, 0.7f));
+		ColorAlpha(colors->text, 0.7f));
 
 	if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
 		if (g->settingsSelection == itemCount) {